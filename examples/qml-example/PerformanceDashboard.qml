@@ -9,6 +9,7 @@ GroupBox {
     Layout.fillHeight: true
 
     property var perfReport: ({})
+    property var latency: []
 
     // Auto-refresh timer
     Timer {
@@ -18,11 +19,13 @@ GroupBox {
         repeat: true
         onTriggered: {
             perfReport = FastIconStats.getPerformanceReport()
+            latency = FastIconStats.getLatencyHistograms()
         }
     }
 
     Component.onCompleted: {
         perfReport = FastIconStats.getPerformanceReport()
+        latency = FastIconStats.getLatencyHistograms()
     }
 
     ColumnLayout {
@@ -180,6 +183,11 @@ GroupBox {
                         text: "Cached Items: " + (perfReport.l2Cache?.cachedItems || 0)
                         font.pointSize: 10
                     }
+                    Label {
+                        text: "Coalesced Loads: " + (perfReport.l2Cache?.coalescedCount || 0) +
+                              " (" + (perfReport.l2Cache?.coalescingRate || 0).toFixed(1) + "%)"
+                        font.pointSize: 10
+                    }
 
                     Item { Layout.fillHeight: true }
 
@@ -224,6 +232,16 @@ GroupBox {
                         to: 100
                         value: perfReport.l3DiskCache?.usagePercent || 0
                     }
+                    Label {
+                        text: "Write Queue: " + (perfReport.l3DiskCache?.queueDepth || 0) +
+                              " (" + (perfReport.l3DiskCache?.droppedSaves || 0) + " dropped)"
+                        font.pointSize: 10
+                    }
+                    Label {
+                        text: "Warm Start: " + (perfReport.warmStart?.icons || 0) + " icons, " +
+                              (perfReport.warmStart?.savedRequests || 0) + " first requests saved"
+                        font.pointSize: 10
+                    }
 
                     Item { Layout.fillHeight: true }
 
@@ -267,6 +285,12 @@ GroupBox {
                         text: "Total Accesses: " + (perfReport.usageTracking?.totalAccesses || 0)
                         font.pointSize: 10
                     }
+                    Label {
+                        text: "Prediction Accuracy: " + (perfReport.predictor?.accuracy || 0).toFixed(1) + "%" +
+                              " (coverage " + (perfReport.predictor?.coverage || 0).toFixed(1) + "%, " +
+                              (perfReport.predictor?.triggerCount || 0) + " sequences)"
+                        font.pointSize: 10
+                    }
 
                     Label {
                         text: "Top 5 Most Used Icons:"
@@ -376,6 +400,112 @@ GroupBox {
             }
         }
 
+        // Pipeline latency per stage
+        GroupBox {
+            title: "Pipeline Latency (µs)"
+            Layout.fillWidth: true
+
+            ColumnLayout {
+                anchors.fill: parent
+                spacing: 6
+
+                Repeater {
+                    model: latency
+                    delegate: RowLayout {
+                        Layout.fillWidth: true
+                        spacing: 10
+
+                        // Bars are scaled against the slowest p99 of all stages
+                        property real maxP99: Math.max(1, ...latency.map(s => s.p99Us))
+
+                        Label {
+                            text: modelData.stage
+                            font.pointSize: 9
+                            Layout.preferredWidth: 80
+                        }
+                        Label {
+                            text: modelData.count + " samples"
+                            font.pointSize: 9
+                            color: "#666"
+                            Layout.preferredWidth: 90
+                        }
+                        Item {
+                            Layout.fillWidth: true
+                            Layout.preferredHeight: 14
+
+                            Rectangle {
+                                height: parent.height
+                                width: parent.width * modelData.p99Us / maxP99
+                                color: "#FFCDD2"
+                            }
+                            Rectangle {
+                                height: parent.height
+                                width: parent.width * modelData.p95Us / maxP99
+                                color: "#FFB74D"
+                            }
+                            Rectangle {
+                                height: parent.height
+                                width: parent.width * modelData.p50Us / maxP99
+                                color: "#4CAF50"
+                            }
+                        }
+                        Label {
+                            text: "p50 " + modelData.p50Us.toFixed(0) +
+                                  "  p95 " + modelData.p95Us.toFixed(0) +
+                                  "  p99 " + modelData.p99Us.toFixed(0)
+                            font.pointSize: 9
+                            Layout.preferredWidth: 200
+                        }
+                    }
+                }
+
+                Button {
+                    text: "Reset Latency"
+                    onClicked: {
+                        FastIconStats.resetLatencyHistograms()
+                        latency = FastIconStats.getLatencyHistograms()
+                    }
+                }
+            }
+        }
+
+        // Adaptive loader stages
+        GroupBox {
+            id: schedulerBox
+            title: "Loader Threads"
+            Layout.fillWidth: true
+
+            property var scheduler: perfReport.scheduler || ({})
+
+            ColumnLayout {
+                anchors.fill: parent
+                spacing: 4
+
+                Repeater {
+                    model: [
+                        { name: "I/O", stage: schedulerBox.scheduler.io || ({}) },
+                        { name: "CPU", stage: schedulerBox.scheduler.cpu || ({}) }
+                    ]
+                    delegate: Label {
+                        text: modelData.name + ": " + (modelData.stage.threads || 0) +
+                              " threads (" + (modelData.stage.minThreads || 0) + "-" +
+                              (modelData.stage.maxThreads || 0) + "), queued " +
+                              (modelData.stage.queued || 0) + ", wait " +
+                              (modelData.stage.meanWaitUs || 0).toFixed(0) + " µs, service " +
+                              (modelData.stage.meanServiceUs || 0).toFixed(0) + " µs"
+                        font.pointSize: 9
+                    }
+                }
+
+                Label {
+                    text: "Last decision: " + ((schedulerBox.scheduler.decisions || []).slice(-1)[0] || "none") +
+                          (schedulerBox.scheduler.adaptive === false ? " (pinned)" : "")
+                    font.pointSize: 9
+                    color: "#666"
+                }
+            }
+        }
+
         // Control buttons
         RowLayout {
             Layout.fillWidth: true
@@ -399,6 +529,7 @@ GroupBox {
                 onClicked: {
                     FastIconStats.resetStats()
                     FastIconStats.resetGpuStats()
+                    FastIconStats.resetLatencyHistograms()
                     perfReport = FastIconStats.getPerformanceReport()
                 }
             }
@@ -26,6 +26,7 @@
  * END_COMMON_COPYRIGHT_HEADER */
 
 #include "xdgicon.h"
+#include "xdgicon_p.h"
 
 #include <QLatin1StringView>
 #include <QString>
@@ -34,9 +35,17 @@
 #include <QStringList>
 #include <QFileInfo>
 #include <QCache>
+#include <QHash>
+#include <QMutex>
+#include <QPromise>
+#include <QThread>
+#include <QThreadPool>
 #include "../xdgiconloader/xdgiconloader_p.h"
 #include <QCoreApplication>
 
+#include <memory>
+#include <vector>
+
 using namespace Qt::Literals::StringLiterals;
 
 static constexpr QLatin1StringView DEFAULT_APP_ICON("application-x-executable");
@@ -60,6 +69,144 @@ static void qt_cleanup_icon_cache()
     qtIconCache()->clear();
 }
 
+namespace {
+/************************************************
+ Pending XdgIcon::requestAsync() render. All callers asking for the same
+ icon while it is queued or rendering wait on the same entry.
+ ************************************************/
+struct PendingIconRequest
+{
+    QString iconName;
+    QSize size;
+    qreal scale = 1.0;
+    QIcon::Mode mode = QIcon::Normal;
+    std::vector<QPromise<QImage>> waiters;
+};
+
+class IconRequestQueue
+{
+public:
+    IconRequestQueue()
+    {
+        m_pool.setMaxThreadCount(qBound(1, QThread::idealThreadCount() / 2, 4));
+    }
+
+    ~IconRequestQueue()
+    {
+        // Running renders still use m_mutex and m_pending, which go first
+        m_pool.waitForDone();
+    }
+
+    QFuture<QImage> request(const QString &iconName, const QSize &size,
+                            qreal scale, QIcon::Mode mode, int priority);
+    QThreadPool *pool() { return &m_pool; }
+
+private:
+    void run(const QString &key);
+    static QImage render(const PendingIconRequest &request);
+
+    QThreadPool m_pool;
+    QMutex m_mutex;
+    QHash<QString, std::shared_ptr<PendingIconRequest>> m_pending;
+};
+}
+Q_GLOBAL_STATIC(IconRequestQueue, iconRequestQueue)
+
+QFuture<QImage> IconRequestQueue::request(const QString &iconName, const QSize &size,
+                                          qreal scale, QIcon::Mode mode, int priority)
+{
+    QPromise<QImage> promise;
+    QFuture<QImage> future = promise.future();
+    promise.start();
+
+    const QString key = iconName + u'@' + QString::number(size.width()) + u'x'
+                      + QString::number(size.height()) + u'@' + QString::number(scale)
+                      + u'm' + QString::number(int(mode));
+
+    QMutexLocker locker(&m_mutex);
+    std::shared_ptr<PendingIconRequest> &pending = m_pending[key];
+    if (pending) {
+        // Same icon already queued or rendering, just wait for it
+        pending->waiters.push_back(std::move(promise));
+        return future;
+    }
+
+    pending = std::make_shared<PendingIconRequest>();
+    pending->iconName = iconName;
+    pending->size = size;
+    pending->scale = scale;
+    pending->mode = mode;
+    pending->waiters.push_back(std::move(promise));
+    locker.unlock();
+
+    m_pool.start([this, key] { run(key); }, priority);
+    return future;
+}
+
+void IconRequestQueue::run(const QString &key)
+{
+    std::shared_ptr<PendingIconRequest> pending;
+    bool wanted = false;
+    {
+        QMutexLocker locker(&m_mutex);
+        pending = m_pending.value(key);
+        if (!pending)
+            return;
+        for (const auto &waiter : pending->waiters)
+            wanted = wanted || !waiter.isCanceled();
+    }
+
+    // Nobody is interested any more, skip the work (late joiners are handled below)
+    QImage image;
+    bool rendered = false;
+    if (wanted) {
+        image = render(*pending);
+        rendered = true;
+    }
+
+    std::vector<QPromise<QImage>> waiters;
+    {
+        QMutexLocker locker(&m_mutex);
+        waiters = std::move(pending->waiters);
+        m_pending.remove(key);
+    }
+
+    for (auto &waiter : waiters) {
+        if (!waiter.isCanceled()) {
+            if (!rendered) {
+                image = render(*pending);
+                rendered = true;
+            }
+            if (!image.isNull())
+                waiter.addResult(image);
+        }
+        waiter.finish();
+    }
+}
+
+QImage IconRequestQueue::render(const PendingIconRequest &request)
+{
+    const QString &iconName = request.iconName;
+    QIcon icon;
+    if (iconName.startsWith(u'/')) {
+        icon = QIcon(iconName);
+    } else {
+        QString name = QFileInfo(iconName).fileName();
+        if (name.endsWith(".png"_L1, Qt::CaseInsensitive) ||
+            name.endsWith(".svg"_L1, Qt::CaseInsensitive) ||
+            name.endsWith(".xpm"_L1, Qt::CaseInsensitive))
+        {
+            name.truncate(name.length() - 4);
+        }
+        // A private engine keeps worker threads away from the (unguarded) icon cache
+        icon = QIcon(new XdgIconLoaderEngine(name));
+    }
+
+    if (icon.isNull())
+        return QImage();
+    return icon.pixmap(request.size, request.scale, request.mode).toImage();
+}
+
 
 XdgIcon::XdgIcon() = default;
 
@@ -72,6 +219,17 @@ XdgIcon::~XdgIcon() = default;
  is found in the current theme fallback is return instead.
  ************************************************/
 QIcon XdgIcon::fromTheme(const QString& iconName, const QIcon& fallback)
+{
+    return fromNamedTheme(iconName, QString(), fallback);
+}
+
+
+/************************************************
+ Returns the QIcon corresponding to name in the theme themeName. An empty
+ themeName means the current icon theme. Icons of different themes are cached
+ separately, so a preview theme never replaces the current theme's entries.
+ ************************************************/
+QIcon XdgIcon::fromNamedTheme(const QString& iconName, const QString& themeName, const QIcon& fallback)
 {
     if (iconName.isEmpty())
         return fallback;
@@ -86,19 +244,22 @@ QIcon XdgIcon::fromTheme(const QString& iconName, const QIcon& fallback)
         name.truncate(name.length() - 4);
     }
 
+    // Icon names never contain '/', so "name/theme" can't clash with a plain name
+    const QString cacheKey = isAbsolute ? iconName
+                                        : themeName.isEmpty() ? name : name + u'/' + themeName;
+
     QIcon icon;
 
-    if (!isAbsolute ? qtIconCache()->contains(name) : qtIconCache()->contains(iconName)) {
-        icon = *qtIconCache()->object(!isAbsolute ? name : iconName);
+    if (qtIconCache()->contains(cacheKey)) {
+        icon = *qtIconCache()->object(cacheKey);
     } else {
         QIcon *cachedIcon;
         if (!isAbsolute) {
-            cachedIcon = new QIcon(new XdgIconLoaderEngine(name));
-            qtIconCache()->insert(name, cachedIcon);
+            cachedIcon = new QIcon(new XdgIconLoaderEngine(name, themeName));
         } else {
             cachedIcon = new QIcon(iconName);
-            qtIconCache()->insert(iconName, cachedIcon);
         }
+        qtIconCache()->insert(cacheKey, cachedIcon);
         icon = *cachedIcon;
     }
 
@@ -145,6 +306,24 @@ QIcon XdgIcon::fromTheme(const QString &iconName,
     return fromTheme(icons);
 }
 
+QFuture<QImage> XdgIcon::requestAsync(const QString& iconName, const QSize& size,
+                                      qreal scale, QIcon::Mode mode, int priority)
+{
+    if (iconName.isEmpty() || size.isEmpty()) {
+        QPromise<QImage> promise;
+        promise.start();
+        promise.finish();
+        return promise.future();
+    }
+    return iconRequestQueue()->request(iconName, size, scale, mode, priority);
+}
+
+QThreadPool *iconRequestPool()
+{
+    return iconRequestQueue()->pool();
+}
+
+
 bool XdgIcon::followColorScheme()
 {
     return XdgIconLoader::instance()->followColorScheme();
@@ -157,6 +336,22 @@ void XdgIcon::setFollowColorScheme(bool enable)
 }
 
 
+uint XdgIcon::themeGeneration()
+{
+    return XdgIconLoader::instance()->themeKey();
+}
+
+
+QString XdgIcon::fileName(const QIcon &icon, const QSize &size, qreal scale)
+{
+    // The engine is shared with the icon, data_ptr() doesn't detach
+    QIcon shared(icon);
+    const QIconPrivate *d = shared.data_ptr();
+    XdgIconLoaderEngine *engine = d ? dynamic_cast<XdgIconLoaderEngine *>(d->engine) : nullptr;
+    return engine ? engine->fileName(size, scale) : QString();
+}
+
+
 QIcon XdgIcon::defaultApplicationIcon()
 {
     return fromTheme(DEFAULT_APP_ICON);
@@ -29,7 +29,9 @@
 #define QTXDG_XDGICON_H
 
 #include "xdgmacros.h"
+#include <QtCore/QFuture>
 #include <QtGui/QIcon>
+#include <QtGui/QImage>
 #include <QString>
 #include <QStringList>
 
@@ -44,6 +46,35 @@ public:
                            const QString &fallbackIcon4 = QString());
     static QIcon fromTheme(const QStringList& iconNames, const QIcon& fallback = QIcon());
 
+    /*!
+     * Returns the icon \a iconName resolved against the explicitly named
+     * \a themeName (and its parents) instead of the current theme. This does
+     * not touch QIcon::themeName(), so it can be used for theme previews or
+     * per-application theme overrides without a global icon invalidation.
+     * An empty \a themeName behaves like fromTheme().
+     */
+    static QIcon fromNamedTheme(const QString& iconName, const QString& themeName,
+                                const QIcon& fallback = QIcon());
+
+    /*!
+     * Resolves and renders \a iconName from the current theme on a worker
+     * thread and returns a future for the rendered image, \a size being in
+     * device independent pixels and \a scale the device pixel ratio. Safe to
+     * call from the GUI thread of widget code; nothing blocks on it.
+     *
+     * Identical requests (name, size, scale and mode) that are still pending
+     * are coalesced into one render. Each caller gets its own future, so
+     * QFuture::cancel() only drops that caller; the render itself is skipped
+     * when every caller cancelled before it started. Among queued requests
+     * a higher \a priority runs first.
+     *
+     * The future finishes without a result if the icon can't be found.
+     */
+    static QFuture<QImage> requestAsync(const QString& iconName, const QSize& size,
+                                        qreal scale = 1.0,
+                                        QIcon::Mode mode = QIcon::Normal,
+                                        int priority = 0);
+
     /*!
      * Flag if the "FollowsColorScheme" hint (the KDE extension to XDG
      * themes) should be honored. If enabled and the icon theme supports
@@ -54,6 +85,25 @@ public:
      */
     static bool followColorScheme();
     static void setFollowColorScheme(bool enable);
+
+    /*!
+     * Generation of the icon theme state (QIconLoader::themeKey()). It
+     * changes whenever icons have to be looked up again: the theme or the
+     * search paths were changed, or the theme was invalidated after its
+     * files changed. Caches of rendered icons compare it to drop stale
+     * entries.
+     */
+    static uint themeGeneration();
+
+    /*!
+     * File \a icon renders from at \a size and \a scale, or an empty string
+     * if it is not an icon of the theme (fromTheme(), fromNamedTheme()) or
+     * its name doesn't resolve. Uses what rendering the icon resolved,
+     * nothing is looked up again. Lets caches of rendered icons notice when
+     * the file changes.
+     */
+    static QString fileName(const QIcon &icon, const QSize &size, qreal scale);
+
     /* TODO: deprecate & remove all QIcon wrappers */
     static QString themeName() { return QIcon::themeName(); }
     static void setThemeName(const QString& themeName) { QIcon::setThemeName(themeName); }
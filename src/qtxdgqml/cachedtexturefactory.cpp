@@ -26,13 +26,15 @@
  * END_COMMON_COPYRIGHT_HEADER */
 
 #include "cachedtexturefactory.h"
+#include "icontrace.h"
 #include <QSGTexture>
 #include <QQuickWindow>
+#include <rhi/qrhi.h>
 #include <QMutexLocker>
 #include <QDebug>
 
 // Static member initialization
-QHash<QQuickWindow*, QHash<QString, CachedTextureFactory::TextureEntry>>
+QHash<QQuickWindow*, QHash<IconCacheKey, CachedTextureFactory::TextureEntry>>
     CachedTextureFactory::s_perWindowCache;
 
 QMutex CachedTextureFactory::s_cacheMutex;
@@ -40,7 +42,7 @@ int CachedTextureFactory::s_textureCreateCount = 0;
 int CachedTextureFactory::s_textureReuseCount = 0;
 
 CachedTextureFactory::CachedTextureFactory(const QImage &image,
-                                           const QString &cacheKey,
+                                           const IconCacheKey &cacheKey,
                                            bool enableAtlas)
     : m_image(image)
     , m_cacheKey(cacheKey)
@@ -48,6 +50,14 @@ CachedTextureFactory::CachedTextureFactory(const QImage &image,
 {
 }
 
+QImage CachedTextureFactory::toUploadFormat(const QImage &image)
+{
+    if (image.isNull() || image.format() == UploadFormat) {
+        return image;
+    }
+    return image.convertToFormat(UploadFormat);
+}
+
 CachedTextureFactory::~CachedTextureFactory()
 {
     // TextureFactory 不负责删除 QSGTexture
@@ -64,7 +74,7 @@ QSGTexture* CachedTextureFactory::createTexture(QQuickWindow *window) const
     QMutexLocker locker(&s_cacheMutex);
 
     // 获取此窗口的缓存
-    QHash<QString, TextureEntry> &windowCache = s_perWindowCache[window];
+    QHash<IconCacheKey, TextureEntry> &windowCache = s_perWindowCache[window];
 
     // 检查缓存是否命中
     auto it = windowCache.find(m_cacheKey);
@@ -108,6 +118,7 @@ QSGTexture* CachedTextureFactory::createTexture(QQuickWindow *window) const
     }
 
     // 创建纹理
+    IconTraceSpan span("upload", m_cacheKey);
     QQuickWindow::CreateTextureOptions options = QQuickWindow::TextureHasAlphaChannel;
 
     // 小纹理启用 Atlas（如果允许）
@@ -130,7 +141,9 @@ QSGTexture* CachedTextureFactory::createTexture(QQuickWindow *window) const
     entry.lastUsed = QDateTime::currentDateTime();
     entry.reuseCount = 0;
 
-    windowCache[m_cacheKey] = entry;
+    if (m_cacheKey.isValid()) {
+        windowCache[m_cacheKey] = entry;
+    }
     s_textureCreateCount++;
 
     qDebug() << "GPU texture created:" << m_cacheKey
@@ -141,6 +154,45 @@ QSGTexture* CachedTextureFactory::createTexture(QQuickWindow *window) const
     return newTexture;
 }
 
+int CachedTextureFactory::precreateTextures(QQuickWindow *window,
+                                            const QList<std::pair<IconCacheKey, QImage>> &images,
+                                            QRhiResourceUpdateBatch *resourceUpdates)
+{
+    if (!window) {
+        return 0;
+    }
+
+    int created = 0;
+    for (const auto &[key, image] : images) {
+        if (!key.isValid() || image.isNull()) {
+            continue;
+        }
+
+        {
+            QMutexLocker locker(&s_cacheMutex);
+            const auto windowIt = s_perWindowCache.constFind(window);
+            if (windowIt != s_perWindowCache.constEnd()) {
+                const auto it = windowIt->constFind(key);
+                if (it != windowIt->constEnd() && it->texture) {
+                    continue;
+                }
+            }
+        }
+
+        // Goes through the regular path so the texture lands in the cache
+        const CachedTextureFactory factory(image, key, true);
+        QSGTexture *texture = factory.createTexture(window);
+        if (!texture) {
+            continue;
+        }
+        if (resourceUpdates) {
+            texture->commitTextureOperations(window->rhi(), resourceUpdates);
+        }
+        created++;
+    }
+    return created;
+}
+
 QSize CachedTextureFactory::textureSize() const
 {
     return m_image.size();
@@ -219,16 +271,16 @@ void CachedTextureFactory::evictLRU(QQuickWindow *window, qint64 bytesToFree)
 {
     // 假设 s_cacheMutex 已加锁
 
-    QHash<QString, TextureEntry> &windowCache = s_perWindowCache[window];
+    QHash<IconCacheKey, TextureEntry> &windowCache = s_perWindowCache[window];
 
     // 收集所有条目并按 lastUsed 排序
-    QList<QString> keys;
+    QList<IconCacheKey> keys;
     for (auto it = windowCache.begin(); it != windowCache.end(); ++it) {
         keys.append(it.key());
     }
 
     // 按最后使用时间排序（最旧的在前）
-    std::sort(keys.begin(), keys.end(), [&windowCache](const QString &a, const QString &b) {
+    std::sort(keys.begin(), keys.end(), [&windowCache](const IconCacheKey &a, const IconCacheKey &b) {
         return windowCache[a].lastUsed < windowCache[b].lastUsed;
     });
 
@@ -236,7 +288,7 @@ void CachedTextureFactory::evictLRU(QQuickWindow *window, qint64 bytesToFree)
     qint64 freedBytes = 0;
     int evictedCount = 0;
 
-    for (const QString &key : keys) {
+    for (const IconCacheKey &key : keys) {
         if (freedBytes >= bytesToFree) {
             break;
         }
@@ -28,6 +28,8 @@
 #ifndef CACHEDTEXTUREFACTORY_H
 #define CACHEDTEXTUREFACTORY_H
 
+#include "iconcachekey.h"
+
 #include <QQuickTextureFactory>
 #include <QImage>
 #include <QHash>
@@ -37,6 +39,7 @@
 
 class QSGTexture;
 class QQuickWindow;
+class QRhiResourceUpdateBatch;
 
 /*!
  * \brief L1 GPU texture cache factory for FastIconProvider
@@ -65,14 +68,29 @@ class QQuickWindow;
 class CachedTextureFactory : public QQuickTextureFactory
 {
 public:
+    /*!
+     * \brief Pixel format the icon pipeline hands to the scene graph
+     *
+     * Premultiplied ARGB32 is what QPainter renders to and what the scene
+     * graph uploads as BGRA without a conversion. The L3 cache stores it
+     * and every stage keeps it, see IconTraceSpan.
+     */
+    static constexpr QImage::Format UploadFormat = QImage::Format_ARGB32_Premultiplied;
+
+    /*!
+     * \brief \a image in UploadFormat, shared (not copied) if it already is
+     */
+    static QImage toUploadFormat(const QImage &image);
+
     /*!
      * \brief Construct a cached texture factory
      * \param image The source image to create texture from
-     * \param cacheKey Unique cache key for this texture
+     * \param cacheKey Unique cache key for this texture, textures of invalid
+     *        keys are created but not cached
      * \param enableAtlas Enable Qt automatic atlas packing for small textures
      */
     explicit CachedTextureFactory(const QImage &image,
-                                   const QString &cacheKey,
+                                   const IconCacheKey &cacheKey,
                                    bool enableAtlas = true);
 
     ~CachedTextureFactory() override;
@@ -103,6 +121,20 @@ public:
      */
     int textureByteCount() const override;
 
+    /*!
+     * \brief Create cached textures for \a images in \a window ahead of use
+     *
+     * Must run on the render thread of \a window. Keys already cached for
+     * the window are skipped. If \a resourceUpdates is given, the uploads
+     * of the new textures are recorded into it, otherwise they happen on
+     * first use.
+     *
+     * \return Number of textures created
+     */
+    static int precreateTextures(QQuickWindow *window,
+                                 const QList<std::pair<IconCacheKey, QImage>> &images,
+                                 QRhiResourceUpdateBatch *resourceUpdates);
+
     // Static cache management
     /*!
      * \brief Clear all cached textures for a specific window
@@ -143,7 +175,7 @@ private:
     };
 
     // Per-window cache (GL context isolation)
-    static QHash<QQuickWindow*, QHash<QString, TextureEntry>> s_perWindowCache;
+    static QHash<QQuickWindow*, QHash<IconCacheKey, TextureEntry>> s_perWindowCache;
     static QMutex s_cacheMutex;
 
     // Cache limits
@@ -170,7 +202,7 @@ private:
 
     // Member variables
     QImage m_image;
-    QString m_cacheKey;
+    IconCacheKey m_cacheKey;
     bool m_enableAtlas;
 };
 
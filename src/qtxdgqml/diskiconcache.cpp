@@ -26,17 +26,21 @@
  * END_COMMON_COPYRIGHT_HEADER */
 
 #include "diskiconcache.h"
+#include "cachedtexturefactory.h"
+#include "icontrace.h"
+#include "packediconstore.h"
+#include <QCoreApplication>
+#include <QEvent>
+#include <QGuiApplication>
+#include <QPalette>
 #include <QStandardPaths>
+#include <QTimer>
 #include <QDir>
 #include <QFile>
 #include <QFileInfo>
 #include <QMutexLocker>
 #include <QDebug>
-#include <QCryptographicHash>
-#include <QDirIterator>
-#include <QJsonDocument>
-#include <QJsonObject>
-#include <QJsonArray>
+#include <QtConcurrent>
 
 // Default maximum cache size: 512MB
 static const qint64 DEFAULT_MAX_CACHE_SIZE = 512 * 1024 * 1024;
@@ -59,26 +63,91 @@ DiskIconCache* DiskIconCache::instance()
 DiskIconCache::DiskIconCache(QObject *parent)
     : QObject(parent)
     , m_maxCacheSize(DEFAULT_MAX_CACHE_SIZE)
-    , m_enabled(true)
+    , m_shared(qEnvironmentVariableIntValue("QTXDG_SHARED_ICON_CACHE") > 0)
 {
-    initializeCacheDir();
-    loadCacheIndex();
+    if (initializeCacheDir() && openStore()) {
+        m_enabled.storeRelaxed(1);
+    }
 
     qDebug() << "DiskIconCache initialized:"
              << "dir=" << m_cacheDir
              << "max_size=" << (m_maxCacheSize / 1024 / 1024) << "MB"
-             << "items=" << m_cacheIndex.size();
+             << "items=" << (m_store ? m_store->count() : 0)
+             << "shared=" << m_shared;
+
+    // Entries are namespaced by theme generation and palette, switching
+    // either only flips the namespace
+    if (m_store) {
+        m_themeGeneration = m_store->generation();
+    }
+    if (qobject_cast<QGuiApplication *>(QCoreApplication::instance())) {
+        m_paletteHash = paletteHash(QGuiApplication::palette());
+
+        // Watch palette changes from the GUI thread, instance() may have
+        // been called on a loader thread first. Installing the filter here
+        // would race with the GUI thread's event dispatch, so queue it.
+        moveToThread(QCoreApplication::instance()->thread());
+        QMetaObject::invokeMethod(this, [this]() {
+            QCoreApplication::instance()->installEventFilter(this);
+        }, Qt::QueuedConnection);
+    }
+    updateNamespace();
+
+    // Queued saves are written on a thread of our own, the first caller of
+    // instance() may be a loader thread without an event loop
+    QTimer *idleTimer = new QTimer;
+    idleTimer->setSingleShot(true);
+    idleTimer->setInterval(SaveIdleMs);
+    idleTimer->moveToThread(&m_writerThread);
+    connect(idleTimer, &QTimer::timeout, idleTimer, [this]() { flushPendingSaves(); });
+    connect(&m_writerThread, &QThread::finished, idleTimer, &QObject::deleteLater);
+    m_writer = idleTimer;
+    m_writerThread.setObjectName(QStringLiteral("DiskIconCache"));
+    m_writerThread.start(QThread::LowPriority);
+
+    // The singleton is never deleted, write what is queued and a snapshot
+    // so the next start doesn't have to replay the journal
+    if (QCoreApplication *app = QCoreApplication::instance()) {
+        connect(app, &QCoreApplication::aboutToQuit, this, [this]() {
+            {
+                QMutexLocker locker(&m_queueMutex);
+                m_writer = nullptr;
+            }
+            m_writerThread.quit();
+            m_writerThread.wait();
+            flushPendingSaves();
+
+            // Other processes reload after a checkpoint of the shared cache,
+            // it checkpoints once its journal is long instead
+            QMutexLocker locker(&m_mutex);
+            if (m_store && m_store->isShared()) {
+                m_store->flush();
+            } else if (m_store) {
+                m_store->checkpoint();
+            }
+        }, Qt::DirectConnection);
+    }
 }
 
 DiskIconCache::~DiskIconCache()
 {
-    saveCacheIndex();
+    {
+        QMutexLocker locker(&m_queueMutex);
+        m_writer = nullptr;
+    }
+    m_writerThread.quit();
+    m_writerThread.wait();
+    flushPendingSaves();
+
+    QMutexLocker locker(&m_mutex);
+    m_store.reset();
 }
 
-void DiskIconCache::initializeCacheDir()
+bool DiskIconCache::initializeCacheDir()
 {
-    // Use XDG cache directory
-    QString cacheRoot = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    // Use XDG cache directory, the application's own unless shared
+    QString cacheRoot = QStandardPaths::writableLocation(
+        m_shared ? QStandardPaths::GenericCacheLocation : QStandardPaths::CacheLocation);
     if (cacheRoot.isEmpty()) {
         cacheRoot = QDir::homePath() + QLatin1String("/.cache");
     }
@@ -92,147 +161,510 @@ void DiskIconCache::initializeCacheDir()
             qDebug() << "Created disk cache directory:" << m_cacheDir;
         } else {
             qWarning() << "Failed to create disk cache directory:" << m_cacheDir;
-            m_enabled = false;
+            return false;
         }
     }
+    return true;
 }
 
-QString DiskIconCache::getFilePath(const QString &cacheKey) const
+bool DiskIconCache::openStore()
 {
-    // Use MD5 hash as filename to avoid invalid characters
-    QByteArray hash = QCryptographicHash::hash(
-        cacheKey.toUtf8(),
-        QCryptographicHash::Md5
-    );
-    QString filename = QString::fromLatin1(hash.toHex()) + QLatin1String(".png");
-
-    return m_cacheDir + QLatin1String("/") + filename;
+    removeLegacyFiles();
+    m_store = std::make_unique<PackedIconStore>(m_cacheDir, m_shared);
+    if (!m_store->open()) {
+        qWarning() << "Failed to open disk cache store:" << m_cacheDir;
+        return false;
+    }
+    return true;
 }
 
-QImage DiskIconCache::loadFromDisk(const QString &cacheKey)
+void DiskIconCache::setSharedCacheEnabled(bool shared)
 {
-    if (!m_enabled) {
-        return QImage();
+    QMutexLocker locker(&m_mutex);
+    if (m_shared == shared) {
+        return;
     }
 
+    // Writes reserved in the old store are ignored by the new one
+    const bool wasEnabled = m_enabled.loadRelaxed() != 0;
+    m_store.reset();
+    m_shared = shared;
+    const bool opened = initializeCacheDir() && openStore();
+    m_enabled.storeRelaxed(opened && wasEnabled ? 1 : 0);
+
+    if (m_store) {
+        m_themeGeneration = m_store->generation();
+    }
+    updateNamespace();
+
+    qDebug() << "Disk cache" << (m_shared ? "shared:" : "per application:") << m_cacheDir
+             << "items=" << (m_store ? m_store->count() : 0);
+}
+
+bool DiskIconCache::isSharedCacheEnabled() const
+{
     QMutexLocker locker(&m_mutex);
+    return m_shared;
+}
+
+void DiskIconCache::removeLegacyFiles()
+{
+    // Older versions kept one PNG or .pixels file per icon plus a JSON index
+    const QString legacyIndex = m_cacheDir + QLatin1String("/cache-index.json");
+    if (!QFile::exists(legacyIndex)) {
+        return;
+    }
 
-    // Check if in index
-    auto it = m_cacheIndex.find(cacheKey);
-    if (it == m_cacheIndex.end()) {
-        return QImage();  // Not in cache
+    QDir dir(m_cacheDir);
+    const QStringList files = dir.entryList(
+        QStringList() << QStringLiteral("*.pixels") << QStringLiteral("*.png"), QDir::Files);
+    for (const QString &fileName : files) {
+        dir.remove(fileName);
     }
+    QFile::remove(legacyIndex);
 
-    CacheEntry &entry = it.value();
-    QString filePath = entry.filePath;
+    qDebug() << "Removed legacy disk cache files:" << files.size();
+}
 
-    // Check if file exists
-    if (!QFile::exists(filePath)) {
-        qDebug() << "Disk cache file missing:" << cacheKey;
-        m_cacheIndex.erase(it);
+QImage DiskIconCache::loadFromDisk(const IconCacheKey &cacheKey)
+{
+    if (!m_enabled.loadRelaxed() || !cacheKey.isValid()) {
         return QImage();
     }
 
-    // Load image
-    QImage image(filePath);
+    IconTraceSpan span("l3.read", cacheKey);
+    const quint64 id = storeId(cacheKey, m_namespace.loadAcquire());
+
+    // Not written yet, but already rendered
+    {
+        QMutexLocker locker(&m_queueMutex);
+        const auto pending = m_pendingSaves.constFind(id);
+        if (pending != m_pendingSaves.cend()) {
+            return CachedTextureFactory::toUploadFormat(pending->image);
+        }
+    }
+
+    // Only the index lookup is serialized, page faults happen unlocked
+    PackedIconStore::Location location;
+    {
+        QMutexLocker locker(&m_mutex);
+        if (!m_store || !m_store->locate(id, &location)) {
+            return QImage();  // Not in cache
+        }
+    }
+
+    // Served from the mapping, already in the upload format
+    QImage image = PackedIconStore::imageAt(location);
     if (image.isNull()) {
-        qWarning() << "Failed to load disk cache image:" << filePath;
-        // Remove corrupted entry
-        QFile::remove(filePath);
-        m_cacheIndex.erase(it);
+        QMutexLocker locker(&m_mutex);
+        if (m_store && m_store->discard(location)) {
+            qWarning() << "Dropping corrupt disk cache entry:" << cacheKey;
+        }
         return QImage();
     }
 
-    // Update access time
-    entry.lastAccessed = QDateTime::currentDateTime();
+    // Rendered from a theme directory modified since, e.g. by a package upgrade
+    const PackedIconStore::Source source = PackedIconStore::sourceAt(location);
+    if (!isSourceCurrent(source.directory, source.modified)) {
+        {
+            QMutexLocker locker(&m_mutex);
+            if (m_store) {
+                m_store->discard(location);
+            }
+        }
+        QMutexLocker locker(&m_sourceMutex);
+        m_staleEntries++;
+        qDebug() << "Disk cache STALE:" << cacheKey;
+        return QImage();
+    }
 
     qDebug() << "Disk cache HIT:" << cacheKey;
     return image;
 }
 
-bool DiskIconCache::saveToDisk(const QString &cacheKey, const QImage &image)
+QList<std::pair<IconCacheKey, QImage>> DiskIconCache::loadBatch(const QList<IconCacheKey> &cacheKeys,
+                                                                qint64 byteBudget,
+                                                                qint64 *bytesRead)
 {
-    if (!m_enabled || image.isNull()) {
-        return false;
+    QList<std::pair<IconCacheKey, QImage>> loaded;
+    if (bytesRead) {
+        *bytesRead = 0;
+    }
+    if (!m_enabled.loadRelaxed() || byteBudget <= 0) {
+        return loaded;
     }
 
-    QMutexLocker locker(&m_mutex);
+    IconTraceSpan span("l3.batch_read", IconCacheKey());
+    const quint64 ns = m_namespace.loadAcquire();
+
+    // One lock hold for all lookups, the budget keeps the most important keys
+    QList<PackedIconStore::Location> locations;
+    QHash<quint64, IconCacheKey> keys;
+    qint64 budgeted = 0;
+    {
+        QMutexLocker locker(&m_mutex);
+        if (!m_store) {
+            return loaded;
+        }
+        for (const IconCacheKey &cacheKey : cacheKeys) {
+            const quint64 id = storeId(cacheKey, ns);
+            if (!cacheKey.isValid() || keys.contains(id)) {
+                continue;
+            }
+            PackedIconStore::Location location;
+            // A warm start is no use, don't let it keep entries alive
+            if (!m_store->locate(id, &location, false)) {
+                continue;
+            }
+            if (budgeted + location.length > byteBudget) {
+                break;
+            }
+            budgeted += location.length;
+            keys.insert(id, cacheKey);
+            locations.append(location);
+        }
+    }
 
-    QString filePath = getFilePath(cacheKey);
+    // Read ahead in one batch, then map in disk order
+    PackedIconStore::prefetch(&locations);
 
-    // Save as PNG (compressed)
-    if (!image.save(filePath, "PNG")) {
-        qWarning() << "Failed to save disk cache image:" << filePath;
+    QList<PackedIconStore::Location> unusable;
+    for (const PackedIconStore::Location &location : std::as_const(locations)) {
+        const QImage image = PackedIconStore::imageAt(location);
+        const PackedIconStore::Source source = PackedIconStore::sourceAt(location);
+        if (image.isNull() || !isSourceCurrent(source.directory, source.modified)) {
+            unusable.append(location);
+            continue;
+        }
+        loaded.append({keys.value(location.id), image});
+        if (bytesRead) {
+            *bytesRead += location.length;
+        }
+    }
+
+    // Corrupt or stale, the next loadFromDisk() would drop them as well
+    if (!unusable.isEmpty()) {
+        QMutexLocker locker(&m_mutex);
+        for (const PackedIconStore::Location &location : std::as_const(unusable)) {
+            if (m_store) {
+                m_store->discard(location);
+            }
+        }
+    }
+
+    qDebug() << "Disk cache batch read:" << loaded.size() << "of" << cacheKeys.size()
+             << "entries," << budgeted << "bytes";
+    return loaded;
+}
+
+bool DiskIconCache::saveToDisk(const IconCacheKey &cacheKey, const QImage &image,
+                               const QString &sourceFile)
+{
+    if (!m_enabled.loadRelaxed() || image.isNull() || !cacheKey.isValid()) {
         return false;
     }
 
-    // Get file size
-    QFileInfo fileInfo(filePath);
-    qint64 fileSize = fileInfo.size();
+    IconTraceSpan span("l3.write", cacheKey);
 
-    // Add to index
-    CacheEntry entry;
-    entry.filePath = filePath;
-    entry.fileSize = fileSize;
-    entry.lastAccessed = QDateTime::currentDateTime();
+    // Conversion and copy into the record don't need the lock
+    PackedIconStore::PendingWrite write;
+    const PackedIconStore::Codec codec = m_compressionEnabled.loadRelaxed()
+        ? PackedIconStore::CodecLz4 : PackedIconStore::CodecRaw;
+    const quint64 ns = m_namespace.loadAcquire();
+    PackedIconStore::Source source;
+    source.directory = sourceDirectory(sourceFile, &source.modified);
+    if (!PackedIconStore::prepare(storeId(cacheKey, ns), image, &write, codec, source)) {
+        return false;
+    }
+    write.ns = namespaceTag(ns);
 
-    m_cacheIndex[cacheKey] = entry;
+    {
+        QMutexLocker locker(&m_mutex);
+        if (!m_store || !m_store->reserve(&write)) {
+            qWarning() << "Failed to save disk cache image:" << cacheKey;
+            return false;
+        }
+    }
+
+    // Writers fill disjoint ranges of the segment concurrently, readers only
+    // see the record once it is committed
+    const bool written = PackedIconStore::writeRecord(write);
+
+    QMutexLocker locker(&m_mutex);
+    if (!m_store || !m_store->commit(write, written)) {
+        qWarning() << "Failed to save disk cache image:" << cacheKey;
+        return false;
+    }
 
-    qDebug() << "Disk cache SAVE:" << cacheKey
-             << "size=" << (fileSize / 1024) << "KB";
+    qDebug() << "Disk cache SAVE:" << cacheKey;
 
     // Check if eviction needed
     checkAndEvict();
+    scheduleMaintenance();
 
     return true;
 }
 
-void DiskIconCache::clearCache()
+void DiskIconCache::saveLater(const IconCacheKey &cacheKey, const QImage &image,
+                              const QString &sourceFile)
 {
+    if (!m_enabled.loadRelaxed() || image.isNull() || !cacheKey.isValid()) {
+        return;
+    }
+
+    const quint64 ns = m_namespace.loadAcquire();
+    const quint64 id = storeId(cacheKey, ns);
+
+    QMutexLocker locker(&m_queueMutex);
+    if (!m_writer) {
+        // Writer thread gone at exit, save right away
+        locker.unlock();
+        saveToDisk(cacheKey, image, sourceFile);
+        return;
+    }
+
+    auto it = m_pendingSaves.find(id);
+    if (it != m_pendingSaves.end()) {
+        // Coalesce, the newer image wins and keeps the older one's place
+        m_pendingBytes += image.sizeInBytes() - it->image.sizeInBytes();
+        it->image = image;
+        it->sourceFile = sourceFile;
+    } else {
+        m_pendingSaves.insert(id, PendingSave{cacheKey, id, namespaceTag(ns), image, sourceFile});
+        m_pendingOrder.append(id);
+        m_pendingBytes += image.sizeInBytes();
+    }
+
+    // Bounded memory, it is only a cache
+    while (m_pendingBytes > MaxPendingSaveBytes && m_pendingOrder.size() > 1) {
+        const PendingSave dropped = m_pendingSaves.take(m_pendingOrder.takeFirst());
+        m_pendingBytes -= dropped.image.sizeInBytes();
+        m_droppedSaves++;
+    }
+
+    if (m_pendingSaves.size() >= SaveBatchSize) {
+        if (!m_flushRequested) {
+            m_flushRequested = true;
+            QMetaObject::invokeMethod(m_writer, [this]() { flushPendingSaves(); }, Qt::QueuedConnection);
+        }
+    } else {
+        // Restart the idle timer
+        QMetaObject::invokeMethod(m_writer, qOverload<>(&QTimer::start), Qt::QueuedConnection);
+    }
+}
+
+void DiskIconCache::flushPendingSaves()
+{
+    QList<PendingSave> saves;
+    {
+        QMutexLocker locker(&m_queueMutex);
+        m_flushRequested = false;
+        saves.reserve(m_pendingOrder.size());
+        for (quint64 id : std::as_const(m_pendingOrder)) {
+            saves.append(m_pendingSaves.value(id));
+        }
+    }
+
+    if (!saves.isEmpty()) {
+        writeBatch(saves);
+    }
+
+    // Dequeue after writing, so loads find the images until they are stored.
+    // Entries queued again meanwhile hold a newer image and stay.
+    QMutexLocker locker(&m_queueMutex);
+    for (const PendingSave &save : std::as_const(saves)) {
+        const quint64 id = save.id;
+        auto it = m_pendingSaves.find(id);
+        if (it != m_pendingSaves.end() && it->image.cacheKey() == save.image.cacheKey()) {
+            m_pendingBytes -= it->image.sizeInBytes();
+            m_pendingSaves.erase(it);
+            m_pendingOrder.removeOne(id);
+        }
+    }
+}
+
+void DiskIconCache::writeBatch(const QList<PendingSave> &saves)
+{
+    const PackedIconStore::Codec codec = m_compressionEnabled.loadRelaxed()
+        ? PackedIconStore::CodecLz4 : PackedIconStore::CodecRaw;
+
+    // Encode without any lock
+    QList<PackedIconStore::PendingWrite> writes;
+    writes.reserve(saves.size());
+    for (const PendingSave &save : saves) {
+        PackedIconStore::PendingWrite write;
+        PackedIconStore::Source source;
+        source.directory = sourceDirectory(save.sourceFile, &source.modified);
+        if (PackedIconStore::prepare(save.id, save.image, &write, codec, source)) {
+            write.ns = save.ns;
+            writes.append(std::move(write));
+        }
+    }
+
+    // One lock hold reserves the whole batch, mostly back to back in one segment
+    QList<PackedIconStore::PendingWrite> reserved;
+    reserved.reserve(writes.size());
+    {
+        QMutexLocker locker(&m_mutex);
+        if (!m_store) {
+            return;
+        }
+        for (PackedIconStore::PendingWrite &write : writes) {
+            if (m_store->reserve(&write)) {
+                reserved.append(std::move(write));
+            }
+        }
+    }
+
+    QList<bool> written;
+    written.reserve(reserved.size());
+    for (const PackedIconStore::PendingWrite &write : std::as_const(reserved)) {
+        written.append(PackedIconStore::writeRecord(write));
+    }
+
+    int saved = 0;
     QMutexLocker locker(&m_mutex);
+    if (!m_store) {
+        return;
+    }
+    for (qsizetype i = 0; i < reserved.size(); ++i) {
+        saved += m_store->commit(reserved.at(i), written.at(i)) ? 1 : 0;
+    }
 
-    qDebug() << "Clearing disk cache...";
+    qDebug() << "Disk cache SAVE batch:" << saved << "of" << saves.size();
+
+    checkAndEvict();
+    scheduleMaintenance();
+}
+
+int DiskIconCache::pendingSaveCount() const
+{
+    QMutexLocker locker(&m_queueMutex);
+    return m_pendingSaves.size();
+}
+
+qint64 DiskIconCache::droppedSaveCount() const
+{
+    QMutexLocker locker(&m_queueMutex);
+    return m_droppedSaves;
+}
+
+qint64 DiskIconCache::staleEntryCount() const
+{
+    QMutexLocker locker(&m_sourceMutex);
+    return m_staleEntries;
+}
+
+int DiskIconCache::checkedDirectoryCount() const
+{
+    QMutexLocker locker(&m_sourceMutex);
+    return m_sourceDirectories.size();
+}
 
-    // Remove all files
-    for (const CacheEntry &entry : m_cacheIndex) {
-        QFile::remove(entry.filePath);
+QByteArray DiskIconCache::sourceDirectory(const QString &sourceFile, qint64 *modified)
+{
+    if (sourceFile.isEmpty()) {
+        return QByteArray();
     }
 
-    m_cacheIndex.clear();
-    saveCacheIndex();
+    // A package upgrade replaces files by renaming, which modifies the directory
+    const QByteArray directory = QFile::encodeName(QFileInfo(sourceFile).path());
+    *modified = directoryModified(directory);
+    return directory;
+}
 
-    qDebug() << "Disk cache cleared";
+qint64 DiskIconCache::directoryModified(const QByteArray &directory)
+{
+    {
+        QMutexLocker locker(&m_sourceMutex);
+        const auto it = m_sourceDirectories.constFind(directory);
+        if (it != m_sourceDirectories.cend()) {
+            return it.value();
+        }
+    }
+
+    // Once per directory and session, whatever number of icons it holds
+    const QFileInfo info(QFile::decodeName(directory));
+    const qint64 modified = info.exists() ? info.lastModified().toMSecsSinceEpoch() : -1;
+
+    // A deep copy, the directory may point into a segment mapping
+    QMutexLocker locker(&m_sourceMutex);
+    m_sourceDirectories.insert(QByteArray(directory.constData(), directory.size()), modified);
+    return modified;
 }
 
-qint64 DiskIconCache::getCacheSize() const
+bool DiskIconCache::isSourceCurrent(const QByteArray &directory, qint64 modified)
 {
+    // Entries without a source (unresolved icons) can't be checked
+    return directory.isEmpty() || directoryModified(directory) == modified;
+}
+
+void DiskIconCache::clearCache()
+{
+    {
+        QMutexLocker locker(&m_queueMutex);
+        m_pendingSaves.clear();
+        m_pendingOrder.clear();
+        m_pendingBytes = 0;
+    }
+
     QMutexLocker locker(&m_mutex);
 
-    qint64 totalSize = 0;
-    for (const CacheEntry &entry : m_cacheIndex) {
-        totalSize += entry.fileSize;
+    qDebug() << "Clearing disk cache...";
+
+    if (m_store) {
+        m_store->clear();
     }
 
-    return totalSize;
+    qDebug() << "Disk cache cleared";
+}
+
+qint64 DiskIconCache::getCacheSize() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_store ? m_store->liveBytes() : 0;
 }
 
 int DiskIconCache::getCacheCount() const
 {
     QMutexLocker locker(&m_mutex);
-    return m_cacheIndex.size();
+    return m_store ? m_store->count() : 0;
+}
+
+qint64 DiskIconCache::getWastedBytes() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_store ? m_store->deadBytes() : 0;
 }
 
 void DiskIconCache::setEnabled(bool enabled)
 {
     QMutexLocker locker(&m_mutex);
-    m_enabled = enabled;
-    qDebug() << "Disk cache" << (enabled ? "enabled" : "disabled");
+    const bool usable = enabled && m_store && m_store->isOpen();
+    m_enabled.storeRelaxed(usable ? 1 : 0);
+    qDebug() << "Disk cache" << (usable ? "enabled" : "disabled");
 }
 
 bool DiskIconCache::isEnabled() const
 {
-    QMutexLocker locker(&m_mutex);
-    return m_enabled;
+    return m_enabled.loadRelaxed() != 0;
+}
+
+void DiskIconCache::setCompressionEnabled(bool enabled)
+{
+    const bool compress = enabled && isCompressionAvailable();
+    m_compressionEnabled.storeRelaxed(compress ? 1 : 0);
+    qDebug() << "Disk cache compression" << (compress ? "enabled" : "disabled");
+}
+
+bool DiskIconCache::isCompressionEnabled() const
+{
+    return m_compressionEnabled.loadRelaxed() != 0;
+}
+
+bool DiskIconCache::isCompressionAvailable()
+{
+    return PackedIconStore::isCodecAvailable(PackedIconStore::CodecLz4);
 }
 
 void DiskIconCache::setMaxCacheSize(qint64 bytes)
@@ -240,7 +672,10 @@ void DiskIconCache::setMaxCacheSize(qint64 bytes)
     QMutexLocker locker(&m_mutex);
     m_maxCacheSize = bytes;
     qDebug() << "Disk cache max size set to" << (bytes / 1024 / 1024) << "MB";
-    checkAndEvict();
+    if (m_store) {
+        checkAndEvict();
+        scheduleMaintenance();
+    }
 }
 
 qint64 DiskIconCache::maxCacheSize() const
@@ -251,11 +686,8 @@ qint64 DiskIconCache::maxCacheSize() const
 
 void DiskIconCache::checkAndEvict()
 {
-    // Calculate current size
-    qint64 currentSize = 0;
-    for (const CacheEntry &entry : m_cacheIndex) {
-        currentSize += entry.fileSize;
-    }
+    // Running total of the store, no per-entry sum
+    const qint64 currentSize = m_store->liveBytes();
 
     if (currentSize > m_maxCacheSize) {
         qint64 bytesToFree = currentSize - m_maxCacheSize;
@@ -267,140 +699,150 @@ void DiskIconCache::checkAndEvict()
 
 void DiskIconCache::evictLRU(qint64 bytesToFree)
 {
-    // Collect all entries
-    QList<QString> keys;
-    for (auto it = m_cacheIndex.begin(); it != m_cacheIndex.end(); ++it) {
-        keys.append(it.key());
-    }
-
-    // Sort by last accessed time (oldest first)
-    std::sort(keys.begin(), keys.end(), [this](const QString &a, const QString &b) {
-        return m_cacheIndex[a].lastAccessed < m_cacheIndex[b].lastAccessed;
-    });
-
-    // Evict oldest entries
-    qint64 freedBytes = 0;
+    // Clock sweep, evicted records become dead bytes for compaction
     int evictedCount = 0;
-
-    for (const QString &key : keys) {
-        if (freedBytes >= bytesToFree) {
-            break;
-        }
-
-        const CacheEntry &entry = m_cacheIndex[key];
-        freedBytes += entry.fileSize;
-        evictedCount++;
-
-        // Remove file
-        QFile::remove(entry.filePath);
-
-        qDebug() << "Evicted disk cache entry:" << key
-                 << "freed=" << (entry.fileSize / 1024) << "KB";
-
-        m_cacheIndex.remove(key);
-    }
+    const qint64 freedBytes = m_store->evict(bytesToFree, &evictedCount);
 
     qDebug() << "Disk cache LRU eviction complete:"
              << "evicted=" << evictedCount
-             << "freed=" << (freedBytes / 1024 / 1024) << "MB";
+             << "freed=" << (freedBytes / 1024) << "KB";
 }
 
-void DiskIconCache::loadCacheIndex()
+void DiskIconCache::scheduleMaintenance()
 {
-    QString indexFile = m_cacheDir + QLatin1String("/cache-index.json");
-
-    QFile file(indexFile);
-    if (!file.open(QIODevice::ReadOnly)) {
-        qDebug() << "No disk cache index found, scanning directory...";
-        updateCacheIndex();
+    if (m_compacting || (!m_store->needsReclaim() && !m_store->needsCompaction())) {
         return;
     }
 
-    QByteArray data = file.readAll();
-    file.close();
+    m_compacting = true;
+    QtConcurrent::run([this]() { runMaintenance(); });
+}
 
-    QJsonDocument doc = QJsonDocument::fromJson(data);
-    if (!doc.isObject()) {
-        qWarning() << "Invalid disk cache index format";
-        updateCacheIndex();
-        return;
+void DiskIconCache::runMaintenance()
+{
+    // Reclaim dropped namespaces first, their records feed the compaction.
+    // One step per lock, loads and saves interleave with the work.
+    bool more = true;
+    while (more) {
+        QMutexLocker locker(&m_mutex);
+        if (!m_store) {
+            more = false;
+        } else if (m_store->needsReclaim()) {
+            m_store->reclaimStep();
+        } else {
+            PackedIconStore::CompactionBatch batch;
+            more = m_store->prepareCompaction(&batch);
+            if (more) {
+                // Copy the records without the lock, like saves
+                locker.unlock();
+                QList<bool> written;
+                written.reserve(batch.moves.size());
+                for (const PackedIconStore::PendingWrite &write : std::as_const(batch.moves)) {
+                    written.append(PackedIconStore::writeRecord(write));
+                }
+                locker.relock();
+                more = m_store && m_store->commitCompaction(batch, written);
+            }
+        }
+        if (!more) {
+            m_compacting = false;
+        }
     }
+}
 
-    QJsonObject root = doc.object();
-    QJsonArray entries = root[QStringLiteral("entries")].toArray();
-
-    for (const QJsonValue &value : entries) {
-        QJsonObject entryObj = value.toObject();
+quint64 DiskIconCache::storeId(const IconCacheKey &cacheKey, quint64 ns)
+{
+    // A bijection per namespace, the same icon gets unrelated ids in two
+    return cacheKey.persistentId() ^ ns;
+}
 
-        QString key = entryObj[QStringLiteral("key")].toString();
-        QString filePath = entryObj[QStringLiteral("filePath")].toString();
-        qint64 fileSize = entryObj[QStringLiteral("fileSize")].toVariant().toLongLong();
-        QDateTime lastAccessed = QDateTime::fromString(
-            entryObj[QStringLiteral("lastAccessed")].toString(),
-            Qt::ISODate
-        );
+quint16 DiskIconCache::namespaceTag(quint64 ns)
+{
+    const quint16 tag = quint16(ns ^ (ns >> 16) ^ (ns >> 32) ^ (ns >> 48));
+    return tag ? tag : 1;
+}
 
-        // Verify file exists
-        if (QFile::exists(filePath)) {
-            CacheEntry entry;
-            entry.filePath = filePath;
-            entry.fileSize = fileSize;
-            entry.lastAccessed = lastAccessed;
-            m_cacheIndex[key] = entry;
+quint64 DiskIconCache::paletteHash(const QPalette &palette)
+{
+    // The colors XdgIconLoader substitutes into symbolic SVG icons
+    static const QPalette::ColorRole roles[] = {
+        QPalette::WindowText, QPalette::Window, QPalette::Highlight, QPalette::HighlightedText
+    };
+
+    quint64 hash = 0xcbf29ce484222325ull;
+    for (QPalette::ColorGroup group : {QPalette::Active, QPalette::Disabled}) {
+        for (QPalette::ColorRole role : roles) {
+            hash = (hash ^ palette.color(group, role).rgba()) * 0x100000001b3ull;
         }
     }
-
-    qDebug() << "Loaded disk cache index:" << m_cacheIndex.size() << "entries";
+    return hash;
 }
 
-void DiskIconCache::saveCacheIndex()
+void DiskIconCache::updateNamespace()
 {
-    QString indexFile = m_cacheDir + QLatin1String("/cache-index.json");
-
-    QJsonArray entries;
-    for (auto it = m_cacheIndex.begin(); it != m_cacheIndex.end(); ++it) {
-        const CacheEntry &entry = it.value();
+    // FNV style mix of generation and palette, stable across runs
+    quint64 ns = 0xcbf29ce484222325ull;
+    ns = (ns ^ m_themeGeneration) * 0x100000001b3ull;
+    ns = (ns ^ m_paletteHash) * 0x100000001b3ull;
+    ns ^= ns >> 29;
+
+    m_namespace.storeRelease(ns);
+    if (m_store) {
+        m_store->activateNamespace(namespaceTag(ns));
+        m_store->setGeneration(m_themeGeneration);
+        scheduleMaintenance();
+    }
 
-        QJsonObject entryObj;
-        entryObj[QStringLiteral("key")] = it.key();
-        entryObj[QStringLiteral("filePath")] = entry.filePath;
-        entryObj[QStringLiteral("fileSize")] = QJsonValue::fromVariant(entry.fileSize);
-        entryObj[QStringLiteral("lastAccessed")] = entry.lastAccessed.toString(Qt::ISODate);
+    qDebug() << "Disk cache namespace:" << Qt::hex << namespaceTag(ns)
+             << "generation=" << Qt::dec << m_themeGeneration;
+}
 
-        entries.append(entryObj);
+void DiskIconCache::setPaletteHash(quint64 hash)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_paletteHash == hash) {
+        return;
     }
+    m_paletteHash = hash;
+    updateNamespace();
+}
 
-    QJsonObject root;
-    root[QStringLiteral("entries")] = entries;
-    root[QStringLiteral("version")] = 1;
-
-    QJsonDocument doc(root);
+quint64 DiskIconCache::currentPaletteHash() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_paletteHash;
+}
 
-    QFile file(indexFile);
-    if (!file.open(QIODevice::WriteOnly)) {
-        qWarning() << "Failed to save disk cache index:" << indexFile;
-        return;
+void DiskIconCache::invalidateTheme()
+{
+    {
+        QMutexLocker locker(&m_queueMutex);
+        m_pendingSaves.clear();
+        m_pendingOrder.clear();
+        m_pendingBytes = 0;
     }
 
-    file.write(doc.toJson());
-    file.close();
+    // Look at the source directories again
+    {
+        QMutexLocker locker(&m_sourceMutex);
+        m_sourceDirectories.clear();
+    }
 
-    qDebug() << "Saved disk cache index:" << m_cacheIndex.size() << "entries";
+    QMutexLocker locker(&m_mutex);
+    m_themeGeneration++;
+    updateNamespace();
 }
 
-void DiskIconCache::updateCacheIndex()
+quint32 DiskIconCache::themeGeneration() const
 {
-    m_cacheIndex.clear();
-
-    QDirIterator it(m_cacheDir, QStringList() << QStringLiteral("*.png"), QDir::Files);
-    while (it.hasNext()) {
-        QString filePath = it.next();
-        QFileInfo fileInfo(filePath);
+    QMutexLocker locker(&m_mutex);
+    return m_themeGeneration;
+}
 
-        // We don't have the original cache key, so skip these orphaned files
-        // They will be naturally replaced as cache is used
-        qDebug() << "Found orphaned cache file (will be replaced):" << filePath;
+bool DiskIconCache::eventFilter(QObject *watched, QEvent *event)
+{
+    if (event->type() == QEvent::ApplicationPaletteChange && watched == QCoreApplication::instance()) {
+        setPaletteHash(paletteHash(QGuiApplication::palette()));
     }
-
-    saveCacheIndex();
+    return QObject::eventFilter(watched, event);
 }
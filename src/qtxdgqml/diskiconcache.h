@@ -28,11 +28,21 @@
 #ifndef DISKICONCACHE_H
 #define DISKICONCACHE_H
 
+#include "iconcachekey.h"
+
 #include <QObject>
+#include <QAtomicInteger>
 #include <QImage>
-#include <QMutex>
 #include <QHash>
-#include <QDateTime>
+#include <QList>
+#include <QMutex>
+#include <QThread>
+
+#include <memory>
+
+class PackedIconStore;
+class QPalette;
+class QTimer;
 
 /*!
  * \brief Disk-based persistent icon cache (L3 cache)
@@ -41,14 +51,32 @@
  * surviving application restarts and significantly reducing cold start latency.
  *
  * Features:
- * - Persistent storage in ~/.cache/libqtxdg/icon-cache/
- * - PNG compression for efficient storage
- * - LRU eviction (max 512MB disk space)
- * - Automatic cache validation (checksum verification)
- * - Thread-safe operations
+ * - Persistent storage per application in the application's cache
+ *   location, or opt-in shared by all processes of the user in
+ *   $XDG_CACHE_HOME/libqtxdg/icon-cache/ (setSharedCacheEnabled()).
+ *   A second running instance of the application gets no per
+ *   application cache, only the first one holds its lock.
+ * - Upload-ready pixels served from mmap'd segments, a hit costs no
+ *   open(), read(), decode or copy
+ * - Optional LZ4 compressed entries (setCompressionEnabled())
+ * - Write-behind saves (saveLater()), batched on a background thread
+ * - Clock (second chance) eviction approximating LRU, amortized O(1)
+ *   per entry (max 512MB disk space)
+ * - Background compaction of segments holding mostly dead records
+ * - Hits are checked against the directory of the theme file they were
+ *   rendered from, so a theme package upgrade doesn't need a cache clear.
+ *   Each directory is stat'ed once per session, not once per icon.
+ * - Thread-safe operations, file reads and writes run outside the index lock
  *
- * Cache Key Format: iconName@widthxheights_state
- * File Format: PNG with metadata
+ * Cache Key: IconCacheKey::persistentId() (icon, theme, size, state, DPR)
+ * within a namespace of theme generation and palette, stable across runs.
+ * A palette change or invalidateTheme() switches the namespace in O(1),
+ * the last PackedIconStore::MaxNamespaces namespaces stay warm (e.g. for
+ * light/dark toggling), older ones are reclaimed in the background.
+ * Storage: a PackedIconStore, a few large segment files plus an mmap'd
+ * hash index instead of one file per icon. Pixels are stored in
+ * CachedTextureFactory::UploadFormat in native byte order, the cache
+ * directory is per user and machine, so it is not portable.
  */
 class DiskIconCache : public QObject
 {
@@ -62,18 +90,78 @@ public:
 
     /*!
      * \brief Load image from disk cache
-     * \param cacheKey Cache key (format: iconName@widthxheights_state)
-     * \return Cached image, or null image if not found/invalid
+     * \param cacheKey Cache key of the request
+     * \return Cached image in CachedTextureFactory::UploadFormat, or null
+     *         image if not found/invalid
      */
-    QImage loadFromDisk(const QString &cacheKey);
+    QImage loadFromDisk(const IconCacheKey &cacheKey);
+
+    /*!
+     * \brief Load the entries of \a cacheKeys, most important first, in one batch
+     *
+     * Meant for warming the memory cache on start. All entries are looked
+     * up with one lock hold, without counting as hits for eviction, and
+     * read ahead with PackedIconStore::prefetch() before they are mapped
+     * in segment order. Keys not cached are skipped. Stops once the
+     * entries loaded so far take \a byteBudget bytes on disk.
+     * \param bytesRead Set to the disk bytes of the loaded entries, optional
+     * \return The loaded entries, validated like loadFromDisk() hits
+     */
+    QList<std::pair<IconCacheKey, QImage>> loadBatch(const QList<IconCacheKey> &cacheKeys,
+                                                     qint64 byteBudget,
+                                                     qint64 *bytesRead = nullptr);
 
     /*!
      * \brief Save image to disk cache
      * \param cacheKey Cache key
-     * \param image Image to save
+     * \param image Image to save, converted to the upload format if needed
+     * \param sourceFile Icon file \a image was rendered from, if known. A
+     *        hit is dropped once the file's directory was modified.
      * \return true if saved successfully
      */
-    bool saveToDisk(const QString &cacheKey, const QImage &image);
+    bool saveToDisk(const IconCacheKey &cacheKey, const QImage &image,
+                    const QString &sourceFile = QString());
+
+    /*!
+     * \brief Queue \a image for saving and return immediately
+     *
+     * Queued saves are written in batches on the cache's writer thread,
+     * once SaveBatchSize are queued or after SaveIdleMs without a new one,
+     * and on application exit. A key queued again replaces its pending
+     * image. Beyond MaxPendingSaveBytes the oldest pending saves are
+     * dropped. loadFromDisk() finds queued images.
+     */
+    void saveLater(const IconCacheKey &cacheKey, const QImage &image,
+                   const QString &sourceFile = QString());
+
+    /*!
+     * \brief Write all queued saves on the calling thread
+     */
+    void flushPendingSaves();
+
+    /*!
+     * \brief Number of queued saves (queue depth)
+     */
+    int pendingSaveCount() const;
+
+    /*!
+     * \brief Saves dropped because the queue was full
+     */
+    qint64 droppedSaveCount() const;
+
+    /*!
+     * \brief Hits dropped because their source directory was modified
+     */
+    qint64 staleEntryCount() const;
+
+    /*!
+     * \brief Source directories stat'ed this session
+     */
+    int checkedDirectoryCount() const;
+
+    static constexpr int SaveBatchSize = 32;
+    static constexpr int SaveIdleMs = 250;
+    static constexpr qint64 MaxPendingSaveBytes = 8 * 1024 * 1024;
 
     /*!
      * \brief Clear all disk cache
@@ -90,6 +178,11 @@ public:
      */
     int getCacheCount() const;
 
+    /*!
+     * \brief Bytes of replaced and evicted records not yet compacted away
+     */
+    qint64 getWastedBytes() const;
+
     /*!
      * \brief Enable or disable disk cache
      * \param enabled true to enable, false to disable
@@ -101,6 +194,55 @@ public:
      */
     bool isEnabled() const;
 
+    /*!
+     * \brief Use the cache shared by all processes of the user
+     *
+     * The per application cache is the default, the environment variable
+     * QTXDG_SHARED_ICON_CACHE=1 switches to the shared one on start. In
+     * the shared cache an icon rendered by one process (panel, launcher,
+     * settings, ...) is a hit for all. Writers are serialized with a file
+     * lock, see PackedIconStore. Queued saves go to the newly opened cache.
+     */
+    void setSharedCacheEnabled(bool shared);
+    bool isSharedCacheEnabled() const;
+
+    /*!
+     * \brief Store new entries LZ4 compressed
+     *
+     * Saves disk space, but a hit then decompresses into a new image
+     * instead of being served from the mapping. Ignored without LZ4
+     * support in the build. Off by default.
+     */
+    void setCompressionEnabled(bool enabled);
+    bool isCompressionEnabled() const;
+
+    /*!
+     * \brief Whether the build supports compressed entries
+     */
+    static bool isCompressionAvailable();
+
+    /*!
+     * \brief Switch to the namespace of palette \a hash
+     *
+     * Called automatically on application palette changes.
+     */
+    void setPaletteHash(quint64 hash);
+    quint64 currentPaletteHash() const;
+
+    /*!
+     * \brief Hash of the palette colors symbolic icons are rendered with
+     */
+    static quint64 paletteHash(const QPalette &palette);
+
+    /*!
+     * \brief Start a new theme generation, e.g. after theme files changed
+     *
+     * Entries cached so far are no longer served and get reclaimed in
+     * the background, unlike clearCache() this returns immediately.
+     */
+    void invalidateTheme();
+    quint32 themeGeneration() const;
+
     /*!
      * \brief Set maximum disk cache size in bytes
      * \param bytes Maximum size (default: 512MB)
@@ -113,61 +255,122 @@ public:
     qint64 maxCacheSize() const;
 
 private:
+    friend class tst_diskiconcache;
+
     explicit DiskIconCache(QObject *parent = nullptr);
     ~DiskIconCache() override;
 
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
     // Disable copy
     DiskIconCache(const DiskIconCache&) = delete;
     DiskIconCache& operator=(const DiskIconCache&) = delete;
 
+    struct PendingSave {
+        IconCacheKey key;
+        quint64 id = 0;     // Store id in the namespace it was queued in
+        quint16 ns = 0;     // Namespace tag
+        QImage image;
+        QString sourceFile;
+    };
+
+    static quint64 storeId(const IconCacheKey &cacheKey, quint64 ns);
+    static quint16 namespaceTag(quint64 ns);
+
     /*!
-     * \brief Initialize cache directory
+     * \brief Directory of \a sourceFile to record with an entry, and its mtime
      */
-    void initializeCacheDir();
+    QByteArray sourceDirectory(const QString &sourceFile, qint64 *modified);
 
     /*!
-     * \brief Get file path for cache key
+     * \brief Modification time of \a directory, stat'ed on first use only
+     * \return -1 if it doesn't exist
      */
-    QString getFilePath(const QString &cacheKey) const;
+    qint64 directoryModified(const QByteArray &directory);
 
     /*!
-     * \brief Check if cache needs eviction and evict if necessary
+     * \brief Whether an entry rendered from \a directory at \a modified is current
      */
-    void checkAndEvict();
+    bool isSourceCurrent(const QByteArray &directory, qint64 modified);
 
     /*!
-     * \brief Evict LRU items to free specified bytes
-     * \param bytesToFree Bytes to free
+     * \brief Recompute and activate the namespace, m_mutex held
      */
-    void evictLRU(qint64 bytesToFree);
+    void updateNamespace();
 
     /*!
-     * \brief Update cache index (file metadata)
+     * \brief Write \a saves with one lock hold for all reservations and
+     *        one for all commits
      */
-    void updateCacheIndex();
+    void writeBatch(const QList<PendingSave> &saves);
 
     /*!
-     * \brief Load cache index from disk
+     * \brief Initialize cache directory, shared or per application
+     * \return false if it can't be created
      */
-    void loadCacheIndex();
+    bool initializeCacheDir();
 
     /*!
-     * \brief Save cache index to disk
+     * \brief Open the store in m_cacheDir, m_mutex held
+     * \return false if it can't be opened
      */
-    void saveCacheIndex();
+    bool openStore();
 
-    // Cache entry metadata
-    struct CacheEntry {
-        QString filePath;
-        qint64 fileSize;
-        QDateTime lastAccessed;
-    };
+    /*!
+     * \brief Remove the one file per icon layout of older versions
+     */
+    void removeLegacyFiles();
+
+    /*!
+     * \brief Check if cache needs eviction and evict if necessary
+     */
+    void checkAndEvict();
+
+    /*!
+     * \brief Evict least recently hit items to free specified bytes
+     * \param bytesToFree Bytes to free
+     */
+    void evictLRU(qint64 bytesToFree);
+
+    /*!
+     * \brief Start background reclaim and compaction if there is work
+     */
+    void scheduleMaintenance();
+
+    /*!
+     * \brief Reclaim and compact step by step, releasing the lock in between
+     */
+    void runMaintenance();
 
     QString m_cacheDir;  // Cache directory path
     qint64 m_maxCacheSize;  // Maximum cache size (default: 512MB)
-    bool m_enabled;  // Cache enabled flag
+    // Read without a lock on the loader and writer threads
+    QAtomicInt m_enabled{0};  // Cache enabled flag
+    QAtomicInt m_compressionEnabled{0};  // Write LZ4 records
+    bool m_shared = false;  // In $XDG_CACHE_HOME, used by all processes
+
+    std::unique_ptr<PackedIconStore> m_store;  // Segments and index, guarded by m_mutex
+    bool m_compacting = false;  // A reclaim/compaction task is running
+
+    quint32 m_themeGeneration = 0;  // Persisted in the store
+    quint64 m_paletteHash = 0;
+    QAtomicInteger<quint64> m_namespace = 0;  // Salt of store ids, read without m_mutex
+
+    // Write-behind queue, guarded by m_queueMutex, never held with m_mutex
+    QHash<quint64, PendingSave> m_pendingSaves;  // By persistent id
+    QList<quint64> m_pendingOrder;  // Oldest first
+    qint64 m_pendingBytes = 0;
+    qint64 m_droppedSaves = 0;
+    bool m_flushRequested = false;
+    QTimer *m_writer = nullptr;  // Idle timer living on m_writerThread, null after exit
+    QThread m_writerThread;
+    mutable QMutex m_queueMutex;
+
+    // Source directory mtimes, guarded by m_sourceMutex, never held with another lock
+    QHash<QByteArray, qint64> m_sourceDirectories;
+    qint64 m_staleEntries = 0;
+    mutable QMutex m_sourceMutex;
 
-    QHash<QString, CacheEntry> m_cacheIndex;  // In-memory index
     mutable QMutex m_mutex;  // Thread safety
 
     static DiskIconCache *s_instance;
@@ -29,30 +29,63 @@
 #include "fasticonresponse.h"
 #include "cachedtexturefactory.h"
 #include "iconusagetracker.h"
+#include "diskiconcache.h"
+#include "icontrace.h"
+#include <XdgIcon>
+#include <QGuiApplication>
+#include <QQuickWindow>
+#include <QRunnable>
+#include <rhi/qrhi.h>
 #include <QMutexLocker>
 #include <QDebug>
 #include <QTimer>
 #include <QtConcurrent>
-#include "xdgicon.h"
 
 // Default cache size: 128MB
 static const int DEFAULT_CACHE_SIZE_MB = 128;
 
+// How long a preload that yielded to interactive loads waits before it resumes
+static const int PRELOAD_YIELD_MS = 5;
+
+// Renders at this ratio are reused for requests below it
+static const qreal DOWNSAMPLE_SOURCE_DPR = 2.0;
+
+static qreal applicationDevicePixelRatio()
+{
+    return qGuiApp ? qGuiApp->devicePixelRatio() : 1.0;
+}
+
+static QSize parseSize(const QString &value)
+{
+    const int x = value.indexOf(QLatin1Char('x'));
+    if (x == -1) {
+        return QSize();
+    }
+    bool okWidth = false;
+    bool okHeight = false;
+    const QSize size(value.left(x).toInt(&okWidth), value.mid(x + 1).toInt(&okHeight));
+    return okWidth && okHeight && !size.isEmpty() ? size : QSize();
+}
+
 FastIconProvider::FastIconProvider()
     : QQuickAsyncImageProvider()
 {
     // Set default cache size (128MB)
     setCacheSize(DEFAULT_CACHE_SIZE_MB);
+    m_themeGeneration.storeRelaxed(XdgIcon::themeGeneration());
 
-    // Configure thread pool for async loading
-    // Use half of available CPU cores, minimum 2, maximum 4
-    int cores = QThread::idealThreadCount();
-    int threadCount = qBound(2, cores / 2, 4);
-    m_loaderPool.setMaxThreadCount(threadCount);
-
+    // Loader stages size themselves, see IconLoadScheduler
     qDebug() << "FastIconProvider initialized:"
              << "cache=" << DEFAULT_CACHE_SIZE_MB << "MB"
-             << "threads=" << threadCount;
+             << "threads=" << m_scheduler.cpuThreadLimit();
+
+    // Serve the first frame from memory, before QML starts requesting
+    if (qEnvironmentVariableIsSet("QTXDG_ICON_WARM_START_KB")) {
+        m_warmStartBudget.storeRelaxed(qint64(qEnvironmentVariableIntValue("QTXDG_ICON_WARM_START_KB")) * 1024);
+    }
+    if (m_warmStartBudget.loadRelaxed() > 0) {
+        warmStartFromDisk();
+    }
 
     // Trigger auto-preload if enabled (Stage 4.1.5)
     if (m_autoPreloadEnabled) {
@@ -64,12 +97,14 @@ FastIconProvider::FastIconProvider()
 FastIconProvider::~FastIconProvider()
 {
     // Wait for all loading tasks to complete
-    m_loaderPool.waitForDone();
+    m_scheduler.waitForDone();
 
+    const CacheStats stats = cacheStats();
     qDebug() << "FastIconProvider destroyed. Final stats:"
-             << "hits=" << m_stats.hitCount
-             << "misses=" << m_stats.missCount
-             << "hit_rate=" << QString::number(m_stats.hitRate() * 100, 'f', 1) << "%";
+             << "hits=" << stats.hitCount
+             << "misses=" << stats.missCount
+             << "hit_rate=" << QString::number(stats.hitRate() * 100, 'f', 1) << "%"
+             << "coalesced=" << stats.coalescedCount;
 }
 
 QQuickImageResponse* FastIconProvider::requestImageResponse(
@@ -77,9 +112,12 @@ QQuickImageResponse* FastIconProvider::requestImageResponse(
     const QSize &requestedSize)
 {
     // Parse URL parameters from id
-    // Expected format: iconName?size=24x24&fallback=default&state=0
+    // Expected format: iconName?size=24x24&fallback=default&state=0&theme=Papirus
     QString iconName = id;
     QString fallback;
+    QString themeName;
+    QSize size;
+    qreal dpr = 0.0;
     FastIconResponse::IconState state = FastIconResponse::Normal;
 
     // Split by '?' to separate icon name and parameters
@@ -106,31 +144,66 @@ QQuickImageResponse* FastIconProvider::requestImageResponse(
                 if (ok && stateInt >= 0 && stateInt <= 3) {
                     state = static_cast<FastIconResponse::IconState>(stateInt);
                 }
+            } else if (key == QLatin1String("theme")) {
+                themeName = value;
+            } else if (key == QLatin1String("size")) {
+                size = parseSize(value);
+            } else if (key == QLatin1String("dpr")) {
+                bool ok;
+                qreal dprValue = value.toDouble(&ok);
+                if (ok && dprValue > 0.0) {
+                    dpr = dprValue;
+                }
             }
-            // Note: size parameter is ignored, we use requestedSize from QML
         }
     }
 
-    // Determine final size (use default 32x32 if not specified)
-    QSize finalSize = requestedSize;
-    if (finalSize.isEmpty() || finalSize.width() <= 0 || finalSize.height() <= 0) {
-        finalSize = QSize(32, 32);
+    // requestedSize is in device pixels (sourceSize * window dpr)
+    const bool hasRequestedSize = requestedSize.width() > 0 && requestedSize.height() > 0;
+    if (hasRequestedSize && size.isValid()) {
+        dpr = qreal(requestedSize.width()) / size.width();
+    } else if (dpr <= 0.0) {
+        dpr = applicationDevicePixelRatio();
+    }
+
+    if (!size.isValid()) {
+        size = hasRequestedSize ? (QSizeF(requestedSize) / dpr).toSize().expandedTo(QSize(1, 1))
+                                : QSize(32, 32);
+    }
+
+    checkThemeGeneration();
+
+    // Learn the request stream, and get ahead of it when a known sequence starts
+    const QList<IconSequencePredictor::IconRequest> predicted =
+        IconSequencePredictor::instance()->observe(iconName, size, static_cast<int>(state));
+    if (!predicted.isEmpty()) {
+        preloadPredicted(predicted, dpr, themeName);
     }
 
     // Create async response
-    return new FastIconResponse(iconName, finalSize, fallback, state, this);
+    return new FastIconResponse(iconName, size, dpr, fallback, state, themeName, this);
+}
+
+void FastIconProvider::checkThemeGeneration()
+{
+    // Cache keys hold the theme name, not its generation
+    const uint generation = XdgIcon::themeGeneration();
+    if (m_themeGeneration.fetchAndStoreRelaxed(generation) == generation) {
+        return;
+    }
+    m_imageCache.clear();
+    CachedTextureFactory::clearGpuCache();
+    qDebug() << "FastIconProvider: theme generation changed, L1 and L2 cleared";
 }
 
 void FastIconProvider::clearCache()
 {
-    QMutexLocker locker(&m_cacheMutex);
     m_imageCache.clear();
     qDebug() << "FastIconProvider cache cleared";
 }
 
 void FastIconProvider::setCacheSize(int megabytes)
 {
-    QMutexLocker locker(&m_cacheMutex);
     // Convert MB to bytes
     qint64 bytes = static_cast<qint64>(megabytes) * 1024 * 1024;
     m_imageCache.setMaxCost(bytes);
@@ -138,14 +211,25 @@ void FastIconProvider::setCacheSize(int megabytes)
 
 int FastIconProvider::cacheSize() const
 {
-    QMutexLocker locker(&m_cacheMutex);
-    return m_imageCache.maxCost() / (1024 * 1024);
+    // Shards round the budget down, round back up to whole megabytes
+    const qint64 megabyte = 1024 * 1024;
+    return (m_imageCache.maxCost() + megabyte - 1) / megabyte;
 }
 
 FastIconProvider::CacheStats FastIconProvider::cacheStats() const
 {
-    QMutexLocker locker(&m_statsMutex);
-    CacheStats stats = m_stats;
+    CacheStats stats;
+    stats.hitCount = m_hitCount.loadRelaxed();
+    stats.missCount = m_missCount.loadRelaxed();
+    stats.totalCount = stats.hitCount + stats.missCount;
+    stats.loadCount = m_loadCount.loadRelaxed();
+    stats.coalescedCount = m_coalescedCount.loadRelaxed();
+    stats.droppedCount = m_droppedCount.loadRelaxed();
+    stats.downsampledCount = m_downsampledCount.loadRelaxed();
+    stats.predictedPreloadCount = m_predictedPreloadCount.loadRelaxed();
+    stats.warmStartedCount = m_warmStartedCount.loadRelaxed();
+    stats.warmStartBytes = m_warmStartBytes.loadRelaxed();
+    stats.warmStartHitCount = m_warmStartHitCount.loadRelaxed();
     stats.cachedItems = m_imageCache.count();
     stats.cacheBytes = m_imageCache.totalCost();
     return stats;
@@ -153,67 +237,220 @@ FastIconProvider::CacheStats FastIconProvider::cacheStats() const
 
 void FastIconProvider::resetStats()
 {
-    QMutexLocker locker(&m_statsMutex);
-    m_stats = CacheStats();
+    m_hitCount.storeRelaxed(0);
+    m_missCount.storeRelaxed(0);
+    m_loadCount.storeRelaxed(0);
+    m_coalescedCount.storeRelaxed(0);
+    m_droppedCount.storeRelaxed(0);
+    m_downsampledCount.storeRelaxed(0);
+    m_predictedPreloadCount.storeRelaxed(0);
+    m_warmStartHitCount.storeRelaxed(0);
 }
 
 void FastIconProvider::setMaxThreadCount(int count)
 {
-    m_loaderPool.setMaxThreadCount(qBound(1, count, 8));
+    m_scheduler.setCpuThreadLimit(count);
 }
 
 int FastIconProvider::maxThreadCount() const
 {
-    return m_loaderPool.maxThreadCount();
+    return m_scheduler.cpuThreadLimit();
 }
 
-QString FastIconProvider::cacheKey(const QString &iconName, const QSize &size, int state) const
+IconCacheKey FastIconProvider::cacheKey(const QString &iconName, const QSize &size, int state,
+                                        qreal devicePixelRatio,
+                                        const QString &themeName) const
 {
-    return QStringLiteral("%1@%2x%3s%4")
-        .arg(iconName)
-        .arg(size.width())
-        .arg(size.height())
-        .arg(state);
+    return IconCacheKey(iconName, size, state, devicePixelRatio, themeName);
 }
 
-QImage* FastIconProvider::getCachedImage(const QString &key)
+QImage FastIconProvider::findDownsampleSource(const IconCacheKey &key, bool checkDisk)
 {
-    QMutexLocker locker(&m_cacheMutex);
-    QImage *cached = m_imageCache.object(key);
+    if (!key.isValid() || key.scale() >= DOWNSAMPLE_SOURCE_DPR) {
+        return QImage();
+    }
+
+    const IconCacheKey sourceKey = key.withScale(DOWNSAMPLE_SOURCE_DPR);
+    QImage source = m_imageCache.find(sourceKey);
+    if (source.isNull() && checkDisk) {
+        source = DiskIconCache::instance()->loadFromDisk(sourceKey);
+    }
+    if (source.isNull()) {
+        return QImage();
+    }
+
+    // Keep the aspect ratio of what was actually rendered
+    const QSize targetSize = (QSizeF(source.size()) * key.scale() / DOWNSAMPLE_SOURCE_DPR).toSize();
+    QImage image = source.scaled(targetSize.expandedTo(QSize(1, 1)),
+                                 Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    image.setDevicePixelRatio(key.scale());
+    m_downsampledCount.fetchAndAddRelaxed(1);
+    return CachedTextureFactory::toUploadFormat(image);
+}
 
-    if (cached) {
+QImage FastIconProvider::getCachedImage(const IconCacheKey &key)
+{
+    // Implicitly shared copy, the pixel data stays with the cache entry
+    QImage cached = m_imageCache.find(key);
+
+    if (!cached.isNull()) {
         recordCacheHit();
-        return new QImage(*cached);  // Return copy
+        // A request the warm start saved a load for, count only the first
+        if (m_warmStartPending.loadRelaxed() > 0) {
+            QMutexLocker locker(&m_warmStartMutex);
+            if (m_warmStarted.remove(key)) {
+                m_warmStartPending.storeRelaxed(m_warmStarted.size());
+                m_warmStartHitCount.fetchAndAddRelaxed(1);
+            }
+        }
     } else {
         recordCacheMiss();
-        return nullptr;
     }
+    return cached;
+}
+
+void FastIconProvider::putCachedImage(const IconCacheKey &key, const QImage &image)
+{
+    // Cost is the image byte size (width * height * bytes_per_pixel)
+    m_imageCache.insert(key, image);
+}
+
+std::shared_ptr<FastIconProvider::InFlightLoad> FastIconProvider::loadShared(
+    const IconCacheKey &key,
+    const std::function<QImage()> &ioLoader,
+    const std::function<QImage()> &cpuLoader,
+    int priority)
+{
+    QMutexLocker locker(&m_inFlightMutex);
+
+    // Someone is already loading this key, attach to its future
+    const auto it = key.isValid() ? m_inFlight.constFind(key) : m_inFlight.constEnd();
+    if (it != m_inFlight.constEnd()) {
+        recordLoadCoalesced();
+        it.value()->waiters++;
+        return it.value();
+    }
+
+    auto load = std::make_shared<InFlightLoad>();
+    load->waiters = 1;
+
+    // The previous load may have finished between the L2 lookup and here
+    const QImage cached = m_imageCache.find(key);
+    if (!cached.isNull()) {
+        recordLoadCoalesced();
+        load->future = QtFuture::makeReadyValueFuture(cached);
+        return load;
+    }
+
+    recordLoadStarted();
+    const bool interactive = priority >= InteractivePriority;
+    if (interactive) {
+        m_interactivePending.ref();
+    }
+
+    // Publish to L2 before leaving the in-flight table so that later
+    // requests find either the running load or the cached image
+    // The stages deliver the upload format already, this only guards
+    // against a loader that doesn't
+    const auto finish = [this, key, load, interactive](const QImage &loaded) {
+        const QImage image = CachedTextureFactory::toUploadFormat(loaded);
+        if (!image.isNull()) {
+            IconTraceSpan span("l2.publish", key);
+            putCachedImage(key, image);
+        }
+
+        {
+            QMutexLocker locker(&m_inFlightMutex);
+            // A cancelled load may already have been replaced by a new one
+            const auto it = m_inFlight.constFind(key);
+            if (it != m_inFlight.constEnd() && it.value() == load) {
+                m_inFlight.erase(it);
+            }
+        }
+        if (interactive) {
+            m_interactivePending.deref();
+        }
+        return image;
+    };
+
+    // Every response went away while this was queued
+    const auto dropped = [this, load]() {
+        if (load->cancelled.loadRelaxed()) {
+            m_droppedCount.fetchAndAddRelaxed(1);
+            return true;
+        }
+        return false;
+    };
+
+    // The loader pools keep their queues ordered by priority, so requests
+    // run ahead of preloading. Cache hits never occupy a rasterizing thread.
+    load->future = m_scheduler.spawn(IconLoadScheduler::IoStage, priority,
+        [this, ioLoader, cpuLoader, finish, dropped, priority]() -> QFuture<QImage> {
+            if (dropped()) {
+                return QtFuture::makeReadyValueFuture(finish(QImage()));
+            }
+
+            const QImage image = ioLoader();
+            if (!image.isNull()) {
+                return QtFuture::makeReadyValueFuture(finish(image));
+            }
+
+            return m_scheduler.spawn(IconLoadScheduler::CpuStage, priority,
+                [cpuLoader, finish, dropped]() {
+                    return finish(dropped() ? QImage() : cpuLoader());
+                });
+        })
+        .unwrap();
+
+    // The task blocks on m_inFlightMutex before removing, so this insert
+    // always happens first. Keys that can't be cached are not shared either.
+    if (key.isValid()) {
+        m_inFlight.insert(key, load);
+    }
+    return load;
 }
 
-void FastIconProvider::putCachedImage(const QString &key, const QImage &image)
+void FastIconProvider::releaseShared(const IconCacheKey &key, const std::shared_ptr<InFlightLoad> &load)
 {
-    QMutexLocker locker(&m_cacheMutex);
+    QMutexLocker locker(&m_inFlightMutex);
+    if (--load->waiters > 0) {
+        return;
+    }
 
-    // Calculate image byte size (width * height * bytes_per_pixel)
-    int cost = image.sizeInBytes();
+    load->cancelled.storeRelaxed(1);
 
-    // Insert into cache (QCache takes ownership)
-    QImage *cached = new QImage(image);
-    m_imageCache.insert(key, cached, cost);
+    // New requests for this key must not attach to a load nobody waits for
+    const auto it = m_inFlight.constFind(key);
+    if (it != m_inFlight.constEnd() && it.value() == load) {
+        m_inFlight.erase(it);
+    }
+}
+
+void FastIconProvider::saveToDiskLater(const IconCacheKey &key, const QImage &image,
+                                       const QString &sourceFile)
+{
+    // Write-behind, batched on the disk cache's own thread
+    DiskIconCache::instance()->saveLater(key, image, sourceFile);
 }
 
 void FastIconProvider::recordCacheHit()
 {
-    QMutexLocker locker(&m_statsMutex);
-    m_stats.hitCount++;
-    m_stats.totalCount++;
+    m_hitCount.fetchAndAddRelaxed(1);
 }
 
 void FastIconProvider::recordCacheMiss()
 {
-    QMutexLocker locker(&m_statsMutex);
-    m_stats.missCount++;
-    m_stats.totalCount++;
+    m_missCount.fetchAndAddRelaxed(1);
+}
+
+void FastIconProvider::recordLoadStarted()
+{
+    m_loadCount.fetchAndAddRelaxed(1);
+}
+
+void FastIconProvider::recordLoadCoalesced()
+{
+    m_coalescedCount.fetchAndAddRelaxed(1);
 }
 
 // GPU cache statistics (Stage 3)
@@ -243,87 +480,276 @@ QFuture<int> FastIconProvider::preloadIcons(const QStringList &iconNames,
                                             const QSize &size,
                                             int state)
 {
-    QMutexLocker locker(&m_preloadMutex);
+    QList<PreloadItem> items;
+    items.reserve(iconNames.size());
+    for (const QString &iconName : iconNames) {
+        items.append(PreloadItem{iconName, size, state, 0.0});
+    }
+    return preloadIcons(items);
+}
+
+QFuture<int> FastIconProvider::preloadIcons(const QList<PreloadItem> &items,
+                                            QQuickWindow *window,
+                                            const QString &themeName)
+{
+    {
+        QMutexLocker locker(&m_preloadMutex);
+
+        if (m_isPreloading) {
+            qWarning() << "Preload already in progress, ignoring request";
+            return QFuture<int>();
+        }
 
-    if (m_isPreloading) {
-        qWarning() << "Preload already in progress, ignoring request";
-        return QFuture<int>();
+        m_isPreloading = true;
+        m_preloadCancelled.storeRelaxed(0);
     }
 
-    m_isPreloading = true;
-    m_preloadCancelled.storeRelaxed(0);
+    // Preloaded entries must match what QML will request on this display
+    const qreal defaultScale = applicationDevicePixelRatio();
+
+    auto batch = std::make_shared<PreloadBatch>();
+    batch->total = items.size();
+    // The keys are built on the loader threads, QIcon::themeName() is read here
+    batch->themeName = themeName.isEmpty() ? QIcon::themeName() : themeName;
+    batch->window = window;
+    batch->promise.start();
+    QFuture<int> future = batch->promise.future();
 
     qDebug() << "Starting icon preload:"
-             << "count=" << iconNames.size()
-             << "size=" << size
-             << "state=" << state;
-
-    // Use QtConcurrent::run to execute in thread pool
-    return QtConcurrent::run(&m_loaderPool, [this, iconNames, size, state]() {
-        int successCount = 0;
-        int failedCount = 0;
-        int total = iconNames.size();
-
-        for (int i = 0; i < iconNames.size(); ++i) {
-            // Check cancel flag
-            if (m_preloadCancelled.loadRelaxed() != 0) {
-                qDebug() << "Preload cancelled at" << i << "/" << total;
-                break;
-            }
+             << "count=" << items.size()
+             << "window=" << window
+             << "theme=" << batch->themeName;
 
-            const QString &iconName = iconNames.at(i);
-            QString key = cacheKey(iconName, size, state);
+    if (items.isEmpty()) {
+        finishPreload(batch);
+        return future;
+    }
 
-            // Check if already cached
-            {
-                QMutexLocker locker(&m_cacheMutex);
-                if (m_imageCache.contains(key)) {
-                    successCount++;
-                    Q_EMIT preloadProgress(i + 1, total);
-                    continue;
-                }
-            }
+    // Fan out over the CPU stage, lowest priority lane so queued
+    // interactive loads are started first
+    batch->remainingChunks.storeRelaxed((items.size() + PreloadChunkSize - 1) / PreloadChunkSize);
+    for (qsizetype first = 0; first < items.size(); first += PreloadChunkSize) {
+        spawnPreload([this, batch, chunk = items.mid(first, PreloadChunkSize), defaultScale]() {
+            runPreloadChunk(batch, chunk, 0, defaultScale);
+        });
+    }
 
-            // Load icon using XdgIcon
-            QIcon icon = XdgIcon::fromTheme(iconName);
-            if (!icon.isNull()) {
-                QPixmap pixmap = icon.pixmap(size);
-                if (!pixmap.isNull()) {
-                    QImage image = pixmap.toImage();
-                    putCachedImage(key, image);
-                    successCount++;
-                } else {
-                    failedCount++;
-                }
-            } else {
-                failedCount++;
-            }
+    return future;
+}
+
+void FastIconProvider::runPreloadChunk(const std::shared_ptr<PreloadBatch> &batch,
+                                       const QList<PreloadItem> &items, qsizetype next,
+                                       qreal defaultScale)
+{
+    for (qsizetype i = next; i < items.size(); ++i) {
+        // Check cancel flag
+        if (m_preloadCancelled.loadRelaxed() != 0) {
+            break;
+        }
+
+        // Yield to requests from QML, they are what the user waits for.
+        // The rest of the chunk is queued again, this thread may be the
+        // one they need.
+        if (m_interactivePending.loadRelaxed() > 0) {
+            deferPreload([this, batch, items, i, defaultScale]() {
+                runPreloadChunk(batch, items, i, defaultScale);
+            });
+            return;
+        }
+
+        const PreloadItem &item = items.at(i);
+        const qreal dpr = item.scale > 0.0 ? item.scale : defaultScale;
+        const IconCacheKey key = cacheKey(item.iconName, item.size, item.state, dpr, batch->themeName);
 
-            // Emit progress
-            Q_EMIT preloadProgress(i + 1, total);
+        // Already cached icons count as loaded
+        const QImage cached = m_imageCache.find(key);
+        if (!cached.isNull() || !key.isValid()) {
+            finishPreloadItem(batch, key, cached);
+            continue;
         }
 
-        // Cleanup preload state
+        // The chunk goes on from wherever the load finishes
+        loadForPreload(key, item.iconName, item.size, item.state, key.scale(), batch->themeName,
+            [this, batch, items, i, defaultScale, key](const QImage &image) {
+                finishPreloadItem(batch, key, image);
+                runPreloadChunk(batch, items, i + 1, defaultScale);
+            });
+        return;
+    }
+
+    // The last chunk to finish completes the batch
+    if (!batch->remainingChunks.deref()) {
+        finishPreload(batch);
+    }
+}
+
+void FastIconProvider::finishPreloadItem(const std::shared_ptr<PreloadBatch> &batch,
+                                         const IconCacheKey &key, const QImage &image)
+{
+    if (!image.isNull()) {
+        batch->succeeded.ref();
+        if (batch->window) {
+            QMutexLocker locker(&batch->texturesMutex);
+            batch->textures.append({key, image});
+        }
+    } else {
+        batch->failed.ref();
+    }
+
+    // Emit progress
+    Q_EMIT preloadProgress(batch->processed.fetchAndAddRelaxed(1) + 1, batch->total);
+}
+
+void FastIconProvider::finishPreload(const std::shared_ptr<PreloadBatch> &batch)
+{
+    const int successCount = batch->succeeded.loadRelaxed();
+    const int failedCount = batch->failed.loadRelaxed();
+
+    // Create the textures on the window's render thread. The job runs while
+    // the next frame is prepared, uploads are recorded into that frame's
+    // command buffer, before any render pass.
+    if (QQuickWindow *window = batch->window) {
+        QList<std::pair<IconCacheKey, QImage>> textures;
         {
-            QMutexLocker locker(&m_preloadMutex);
-            m_isPreloading = false;
+            QMutexLocker locker(&batch->texturesMutex);
+            textures.swap(batch->textures);
         }
 
-        // Emit completion signal
-        Q_EMIT preloadCompleted(successCount, failedCount);
+        if (!textures.isEmpty()) {
+            QMetaObject::invokeMethod(window, [window, textures]() {
+                window->scheduleRenderJob(QRunnable::create([window, textures]() {
+                    QRhi *rhi = window->rhi();
+                    QRhiSwapChain *swapChain = window->swapChain();
+                    QRhiCommandBuffer *commandBuffer = swapChain ? swapChain->currentFrameCommandBuffer() : nullptr;
+
+                    // Without a frame to record into, textures upload on first use
+                    QRhiResourceUpdateBatch *resourceUpdates =
+                        rhi && commandBuffer ? rhi->nextResourceUpdateBatch() : nullptr;
+
+                    const int created = CachedTextureFactory::precreateTextures(window, textures, resourceUpdates);
+                    if (resourceUpdates) {
+                        commandBuffer->resourceUpdate(resourceUpdates);
+                    }
+                    qDebug() << "Preload textures created:" << created << "of" << textures.size();
+                }), QQuickWindow::BeforeRenderingStage);
+                window->update();
+            }, Qt::QueuedConnection);
+        }
+    }
 
-        qDebug() << "Preload completed:"
-                 << "success=" << successCount
-                 << "failed=" << failedCount
-                 << "cancelled=" << (m_preloadCancelled.loadRelaxed() != 0);
+    // Cleanup preload state
+    {
+        QMutexLocker locker(&m_preloadMutex);
+        m_isPreloading = false;
+    }
 
-        return successCount;
-    });
+    // Emit completion signal
+    Q_EMIT preloadCompleted(successCount, failedCount);
+
+    qDebug() << "Preload completed:"
+             << "success=" << successCount
+             << "failed=" << failedCount
+             << "cancelled=" << (m_preloadCancelled.loadRelaxed() != 0);
+
+    batch->promise.addResult(successCount);
+    batch->promise.finish();
+}
+
+void FastIconProvider::loadForPreload(const IconCacheKey &key, const QString &iconName, const QSize &size,
+                                      int state, qreal devicePixelRatio, const QString &themeName,
+                                      const std::function<void(const QImage &)> &done)
+{
+    // Same stages as a request, a request for the same key joins this load
+    // and a preload joins the request's
+    const std::shared_ptr<InFlightLoad> load = loadShared(key,
+        [this, iconName, key]() {
+            return FastIconResponse::loadFromCaches(this, iconName, key);
+        },
+        [this, iconName, size, devicePixelRatio, state, themeName, key]() {
+            return FastIconResponse::renderIcon(this, iconName, size, devicePixelRatio, QString(),
+                                                static_cast<FastIconResponse::IconState>(state),
+                                                themeName, key);
+        },
+        PreloadPriority);
+
+    // Continued on the thread finishing the load, nothing waits for it
+    load->future
+        .then([done](const QImage &image) { done(image); })
+        .onCanceled([done]() { done(QImage()); });
+}
+
+bool FastIconProvider::preloadPredicted(const QList<IconSequencePredictor::IconRequest> &icons,
+                                        qreal devicePixelRatio, const QString &themeName)
+{
+    if (!m_predictivePreloading.testAndSetRelaxed(0, 1)) {
+        return false;
+    }
+    m_predictedCancelled.storeRelaxed(0);
+
+    qDebug() << "Predictive preload:" << icons.size() << "icons"
+             << "first=" << icons.first().iconName << icons.first().size;
+
+    auto preload = std::make_shared<PredictedPreload>();
+    preload->icons = icons;
+    preload->devicePixelRatio = devicePixelRatio;
+    // The keys are built on the loader threads, QIcon::themeName() is read here
+    preload->themeName = themeName.isEmpty() ? QIcon::themeName() : themeName;
+    spawnPreload([this, preload]() { runPredictedPreload(preload); });
+    return true;
+}
+
+void FastIconProvider::runPredictedPreload(const std::shared_ptr<PredictedPreload> &preload)
+{
+    while (preload->next < preload->icons.size() && m_predictedCancelled.loadRelaxed() == 0) {
+        // Yield to requests from QML, a prediction is only a guess
+        if (m_interactivePending.loadRelaxed() > 0) {
+            deferPreload([this, preload]() { runPredictedPreload(preload); });
+            return;
+        }
+
+        const IconSequencePredictor::IconRequest &request = preload->icons.at(preload->next++);
+        const IconCacheKey key = cacheKey(request.iconName, request.size, request.state,
+                                          preload->devicePixelRatio, preload->themeName);
+        if (!key.isValid() || m_imageCache.contains(key)) {
+            continue;
+        }
+
+        // The batch goes on from wherever the load finishes
+        loadForPreload(key, request.iconName, request.size, request.state,
+                       key.scale(), preload->themeName,
+            [this, preload](const QImage &image) {
+                if (!image.isNull()) {
+                    preload->loaded++;
+                }
+                runPredictedPreload(preload);
+            });
+        return;
+    }
+
+    m_predictedPreloadCount.fetchAndAddRelaxed(preload->loaded);
+    m_predictivePreloading.storeRelaxed(0);
+    qDebug() << "Predictive preload completed:" << preload->loaded << "of" << preload->icons.size() << "loaded";
+}
+
+void FastIconProvider::spawnPreload(std::function<void()> task)
+{
+    m_scheduler.spawn(IconLoadScheduler::CpuStage, PreloadPriority, std::move(task));
+}
+
+void FastIconProvider::deferPreload(std::function<void()> task)
+{
+    // Re-queued from the provider's thread, so no pool thread waits meanwhile
+    QMetaObject::invokeMethod(this, [this, task = std::move(task)]() {
+        QTimer::singleShot(PRELOAD_YIELD_MS, this, [this, task]() {
+            spawnPreload(task);
+        });
+    }, Qt::QueuedConnection);
 }
 
 void FastIconProvider::cancelPreload()
 {
     m_preloadCancelled.storeRelaxed(1);
+    m_predictedCancelled.storeRelaxed(1);
     qDebug() << "Preload cancel requested";
 }
 
@@ -378,7 +804,16 @@ void FastIconProvider::triggerAutoPreload()
         return;
     }
 
-    // Get top used icons from IconUsageTracker
+    // What the first views of previous runs asked for, in their sizes and states
+    const QList<IconSequencePredictor::IconRequest> startup =
+        IconSequencePredictor::instance()->predictStartup();
+    if (!startup.isEmpty()) {
+        qDebug() << "Auto-preload triggered from startup sequence:" << startup.size() << "icons";
+        preloadPredicted(startup, applicationDevicePixelRatio(), QString());
+        return;
+    }
+
+    // No sequence learned yet, fall back to the top used icons from IconUsageTracker
     IconUsageTracker *tracker = IconUsageTracker::instance();
     if (!tracker->isEnabled() || tracker->getTotalIconCount() == 0) {
         qDebug() << "Auto-preload skipped: no usage data available";
@@ -400,3 +835,78 @@ void FastIconProvider::triggerAutoPreload()
     // Trigger preload with default size (32px is most common)
     preloadIcons(topIcons, QSize(32, 32), 0);
 }
+
+QFuture<int> FastIconProvider::warmStartFromDisk()
+{
+    const qint64 budget = m_warmStartBudget.loadRelaxed();
+    if (budget <= 0) {
+        return QtFuture::makeReadyValueFuture(0);
+    }
+
+    // Opening the disk cache and the usage statistics reads files, the
+    // caller is the GUI thread. The task gets the GUI state it needs.
+    const qreal dpr = applicationDevicePixelRatio();
+    const QString themeName = QIcon::themeName();
+    return m_scheduler.spawn(IconLoadScheduler::IoStage, InteractivePriority, [this, budget, dpr, themeName]() {
+        DiskIconCache *diskCache = DiskIconCache::instance();
+        IconUsageTracker *tracker = IconUsageTracker::instance();
+        if (!diskCache->isEnabled() || !tracker->isEnabled()) {
+            return 0;
+        }
+
+        // Most used first, the state is only part of the tracker's key "iconName@size_state"
+        const QHash<QString, IconUsageTracker::UsageEntry> stats = tracker->getAllStats();
+        QList<std::pair<int, IconCacheKey>> ranked;
+        ranked.reserve(stats.size());
+        for (auto it = stats.cbegin(); it != stats.cend(); ++it) {
+            const int state = QStringView(it.key()).mid(it.key().lastIndexOf(QLatin1Char('_')) + 1).toInt();
+            const QSize size(it->size, it->size);
+            ranked.append({it->accessCount, cacheKey(it->iconName, size, state, dpr, themeName)});
+        }
+        std::sort(ranked.begin(), ranked.end(), [](const auto &a, const auto &b) {
+            return a.first > b.first;
+        });
+
+        QList<IconCacheKey> keys;
+        keys.reserve(ranked.size());
+        for (const auto &[accessCount, key] : std::as_const(ranked)) {
+            keys.append(key);
+        }
+        if (keys.isEmpty()) {
+            return 0;
+        }
+
+        qint64 bytes = 0;
+        const QList<std::pair<IconCacheKey, QImage>> loaded = diskCache->loadBatch(keys, budget, &bytes);
+
+        int warmed = 0;
+        for (const auto &[key, image] : loaded) {
+            // Requested meanwhile, the request's load already filled L2
+            if (m_imageCache.contains(key)) {
+                continue;
+            }
+            putCachedImage(key, image);
+            {
+                QMutexLocker locker(&m_warmStartMutex);
+                m_warmStarted.insert(key);
+                m_warmStartPending.storeRelaxed(m_warmStarted.size());
+            }
+            warmed++;
+        }
+
+        m_warmStartedCount.fetchAndAddRelaxed(warmed);
+        m_warmStartBytes.fetchAndAddRelaxed(bytes);
+        qDebug() << "Warm start:" << warmed << "icons," << bytes << "bytes from disk cache";
+        return warmed;
+    });
+}
+
+void FastIconProvider::setWarmStartBudget(qint64 bytes)
+{
+    m_warmStartBudget.storeRelaxed(qMax<qint64>(0, bytes));
+}
+
+qint64 FastIconProvider::warmStartBudget() const
+{
+    return m_warmStartBudget.loadRelaxed();
+}
@@ -28,15 +28,25 @@
 #ifndef FASTICONPROVIDER_H
 #define FASTICONPROVIDER_H
 
+#include "shardedimagecache.h"
+#include "iconloadscheduler.h"
+#include "iconsequencepredictor.h"
+
 #include <QQuickAsyncImageProvider>
-#include <QThreadPool>
-#include <QCache>
 #include <QImage>
 #include <QMutex>
 #include <QFuture>
+#include <QPromise>
+#include <QPointer>
 #include <QAtomicInt>
+#include <QHash>
+#include <QSet>
+
+#include <functional>
+#include <memory>
 
 class FastIconResponse;
+class QQuickWindow;
 
 /*!
  * \brief High-performance async icon provider for QML
@@ -46,18 +56,34 @@ class FastIconResponse;
  *
  * Features:
  * - Fully asynchronous icon loading (0ms UI blocking)
- * - L2 CPU memory cache (QCache based)
+ * - L2 CPU memory cache (sharded QCache, see ShardedImageCache)
  * - Thread pool for parallel loading
- * - URL parameter support for size, fallback, state
+ * - Request coalescing: concurrent misses for the same cache key share
+ *   one background load
+ * - Priority lanes: QML requests run before preloads, queued loads whose
+ *   responses were all cancelled are dropped
+ * - URL parameter support for size, device pixel ratio, fallback, state
+ * - Device pixel ratio aware: icons are rendered at size * dpr, a 2x
+ *   render in L2/L3 is downsampled for lower ratio requests
  *
  * URL Format:
- *   image://fasticon/iconName?size=24x24&fallback=default&state=0
+ *   image://fasticon/iconName?size=24x24&dpr=2&fallback=default&state=0&theme=Papirus
  *
  * Where:
  *   - iconName: XDG icon name (e.g., "document-open")
- *   - size: Requested size in format WxH (default: 32x32)
+ *   - size: Icon size in device independent pixels, format WxH
+ *   - dpr: Device pixel ratio to render for (e.g. Screen.devicePixelRatio)
  *   - fallback: Fallback icon name (optional)
  *   - state: Icon state 0=Normal, 1=Disabled, 2=Pressed, 3=Hover (default: 0)
+ *   - theme: Resolve against this icon theme instead of the current one
+ *            (optional, does not change QIcon::themeName())
+ *
+ * The QML engine passes sourceSize multiplied by the window's device pixel
+ * ratio as requestedSize, so requestedSize is taken as device pixels:
+ *   - size and requestedSize given: dpr = requestedSize / size
+ *   - only requestedSize: dpr from the dpr parameter or the application,
+ *     size = requestedSize / dpr
+ *   - neither: 32x32 at the dpr parameter or the application's ratio
  */
 class FastIconProvider : public QQuickAsyncImageProvider
 {
@@ -90,10 +116,23 @@ public:
         int totalCount = 0;
         int cachedItems = 0;
         qint64 cacheBytes = 0;
+        int loadCount = 0;       // Background loads started on a miss or for a preload
+        int coalescedCount = 0;  // Misses that attached to an in-flight load
+        int droppedCount = 0;    // Loads dropped before running, all responses cancelled
+        int downsampledCount = 0; // Loads served by downsampling a 2x render from L2/L3
+        int predictedPreloadCount = 0; // Icons loaded ahead of time on a prediction
+        int warmStartedCount = 0;  // Icons put into L2 from L3 on start, see warmStartFromDisk()
+        qint64 warmStartBytes = 0; // Their size on disk
+        int warmStartHitCount = 0; // First requests for them, served without a load
 
         double hitRate() const {
             return totalCount > 0 ? (double)hitCount / totalCount : 0.0;
         }
+
+        double coalescingRate() const {
+            const int misses = loadCount + coalescedCount;
+            return misses > 0 ? (double)coalescedCount / misses : 0.0;
+        }
     };
 
     CacheStats cacheStats() const;
@@ -111,22 +150,70 @@ public:
     void resetGpuStats();
 
     // Thread pool configuration
+    /*!
+     * \brief Pin the rasterize (CPU) stage to \a count threads
+     *
+     * By default the loader sizes its I/O and CPU stages from queue depth
+     * and latency feedback, see IconLoadScheduler. A count of 0 returns
+     * the CPU stage to adaptive sizing.
+     */
     void setMaxThreadCount(int count);
     int maxThreadCount() const;
 
+    /*!
+     * \brief The two stage loader, for statistics
+     */
+    const IconLoadScheduler *scheduler() const { return &m_scheduler; }
+
     // Preload management (Stage 3.3)
     /*!
-     * \brief Asynchronously preload multiple icons into L2 cache
+     * \brief One icon of a bulk preload
+     */
+    struct PreloadItem {
+        QString iconName;
+        QSize size;          ///< Device independent size, as in the size= URL parameter
+        int state = 0;       ///< FastIconResponse::IconState
+        qreal scale = 0.0;   ///< Device pixel ratio, 0 = applicationDevicePixelRatio()
+    };
+
+    /*!
+     * \brief Asynchronously preload icons into the L2 and L3 caches
+     *
+     * The items are split into chunks of PreloadChunkSize that run in
+     * parallel at the lowest priority, yielding while requests from QML
+     * are loading. Icons go through the same L2/L3 lookup and render
+     * stages as a request and share in-flight loads with requests, new
+     * renders are written to L3.
      *
-     * \param iconNames List of icon names to preload
-     * \param size Icon size
-     * \param state Icon state (default: 0 = Normal)
+     * If \a window is given, textures for all preloaded icons are created
+     * in CachedTextureFactory's cache for that window and uploaded on its
+     * render thread once the batch is done, so the first frame showing
+     * them needs no uploads.
+     *
+     * Only one preload runs at a time, a second call returns an invalid
+     * future.
+     *
+     * \param items Icons with their size, state and scale
+     * \param window Window to create textures for (optional)
+     * \param themeName Icon theme, empty for the one current when this is called
      * \return QFuture<int> Returns number of successfully loaded icons
      */
+    QFuture<int> preloadIcons(const QList<PreloadItem> &items,
+                              QQuickWindow *window = nullptr,
+                              const QString &themeName = QString());
+
+    /*!
+     * \brief Preload \a iconNames at one \a size and \a state
+     *
+     * Convenience overload of preloadIcons(const QList<PreloadItem> &, ...)
+     * at the application device pixel ratio.
+     */
     QFuture<int> preloadIcons(const QStringList &iconNames,
                               const QSize &size,
                               int state = 0);
 
+    static constexpr int PreloadChunkSize = 16;
+
     /*!
      * \brief Cancel current preload task (if running)
      */
@@ -171,6 +258,34 @@ public:
      */
     void triggerAutoPreload();
 
+    // Warm start
+    /*!
+     * \brief Fill L2 with the L3 entries of the most used icons
+     *
+     * Ranks the icons recorded by IconUsageTracker by access count and
+     * reads their disk cache entries in one batch, see
+     * DiskIconCache::loadBatch(), up to warmStartBudget() bytes. All of it,
+     * ranking included, runs in the I/O stage at InteractivePriority: it
+     * is started from the constructor on the GUI thread to beat the first
+     * frame's requests, unlike the auto preload nothing is rendered. Icons
+     * are warmed at the application device pixel ratio in the theme that is
+     * current when this is called, both read on the calling thread.
+     *
+     * \return Number of icons put into L2
+     */
+    QFuture<int> warmStartFromDisk();
+
+    /*!
+     * \brief Disk bytes warmStartFromDisk() reads at most, 0 disables it
+     *
+     * The warm start on construction uses the environment variable
+     * QTXDG_ICON_WARM_START_KB, or DefaultWarmStartBudget if unset.
+     */
+    void setWarmStartBudget(qint64 bytes);
+    qint64 warmStartBudget() const;
+
+    static constexpr qint64 DefaultWarmStartBudget = 8 * 1024 * 1024;
+
 Q_SIGNALS:
     /*!
      * \brief Preload progress signal
@@ -189,34 +304,216 @@ Q_SIGNALS:
 private:
     friend class FastIconResponse;
 
+    /*!
+     * \brief Scheduling lanes of the loader stages, higher runs first
+     */
+    enum LoadPriority {
+        PreloadPriority = 0,
+        InteractivePriority = 10
+    };
+
+    /*!
+     * \brief A background load shared by all responses waiting for its key
+     *
+     * waiters is guarded by m_inFlightMutex.
+     */
+    struct InFlightLoad {
+        QFuture<QImage> future;
+        int waiters = 0;
+        QAtomicInt cancelled{0};
+    };
+
     // L2 CPU memory cache
-    QCache<QString, QImage> m_imageCache;
-    mutable QMutex m_cacheMutex;
+    ShardedImageCache m_imageCache;
+
+    // Cache statistics, updated from the GUI thread and the loader threads
+    QAtomicInt m_hitCount{0};
+    QAtomicInt m_missCount{0};
+    QAtomicInt m_loadCount{0};
+    QAtomicInt m_coalescedCount{0};
 
-    // Cache statistics
-    mutable CacheStats m_stats;
-    mutable QMutex m_statsMutex;
+    // Async loading, an I/O stage (L3 reads, decoding) feeding a CPU stage (rasterizing)
+    IconLoadScheduler m_scheduler;
 
-    // Async loading thread pool
-    QThreadPool m_loaderPool;
+    // Loads currently queued or running in m_scheduler, keyed by cacheKey()
+    QHash<IconCacheKey, std::shared_ptr<InFlightLoad>> m_inFlight;
+    QMutex m_inFlightMutex;
+
+    // Interactive loads not finished yet, preloading waits while non-zero
+    QAtomicInt m_interactivePending{0};
+    QAtomicInt m_droppedCount{0};
+    QAtomicInt m_downsampledCount{0};
+
+    // Predictive preloading, one batch at a time
+    QAtomicInt m_predictivePreloading{0};
+    QAtomicInt m_predictedCancelled{0};
+    QAtomicInt m_predictedPreloadCount{0};
+
+    /*!
+     * \brief State of the running preloadPredicted() batch, only touched by
+     *        the step of it that is running
+     */
+    struct PredictedPreload {
+        QList<IconSequencePredictor::IconRequest> icons;
+        qreal devicePixelRatio = 1.0;
+        QString themeName;
+        qsizetype next = 0;
+        int loaded = 0;
+    };
+
+    void runPredictedPreload(const std::shared_ptr<PredictedPreload> &preload);
+
+    /*!
+     * \brief Queue \a task in the CPU stage at PreloadPriority
+     */
+    void spawnPreload(std::function<void()> task);
+
+    /*!
+     * \brief Queue \a task again after interactive loads had time to start
+     *
+     * Preloads yield through this instead of waiting on their pool thread:
+     * the interactive loads may need that very thread to finish. Resumes
+     * from the provider's thread after PRELOAD_YIELD_MS.
+     */
+    void deferPreload(std::function<void()> task);
+
+    /*!
+     * \brief Shared state of the chunks of one preloadIcons() call
+     */
+    struct PreloadBatch {
+        QPromise<int> promise;
+        int total = 0;
+        QString themeName;
+        QPointer<QQuickWindow> window;
+        QAtomicInt remainingChunks{0};
+        QAtomicInt processed{0};
+        QAtomicInt succeeded{0};
+        QAtomicInt failed{0};
+
+        // Loaded icons to create textures for, only used with a window
+        QMutex texturesMutex;
+        QList<std::pair<IconCacheKey, QImage>> textures;
+    };
+
+    /*!
+     * \brief Load \a items from index \a next on, one icon after the other
+     */
+    void runPreloadChunk(const std::shared_ptr<PreloadBatch> &batch,
+                         const QList<PreloadItem> &items, qsizetype next, qreal defaultScale);
+    void finishPreloadItem(const std::shared_ptr<PreloadBatch> &batch,
+                           const IconCacheKey &key, const QImage &image);
+    void finishPreload(const std::shared_ptr<PreloadBatch> &batch);
+
+    /*!
+     * \brief Load one icon for a preload through loadShared() into L2
+     *
+     * Runs at PreloadPriority and shares the load with requests for the
+     * same key. \a done gets the image, null if it failed, on the thread
+     * that finished the load, or right away if it was already finished.
+     */
+    void loadForPreload(const IconCacheKey &key, const QString &iconName, const QSize &size,
+                        int state, qreal devicePixelRatio, const QString &themeName,
+                        const std::function<void(const QImage &)> &done);
 
     // Preload state (Stage 3.3)
     QAtomicInt m_preloadCancelled{0};  // Cancel flag
     bool m_isPreloading{false};
     mutable QMutex m_preloadMutex;
 
+    // Warm start, keys stay in m_warmStarted until their first request
+    QAtomicInteger<qint64> m_warmStartBudget{DefaultWarmStartBudget};
+    QSet<IconCacheKey> m_warmStarted;
+    QAtomicInt m_warmStartPending{0};  // m_warmStarted.size(), read without the lock
+    QMutex m_warmStartMutex;
+    QAtomicInt m_warmStartedCount{0};
+    QAtomicInteger<qint64> m_warmStartBytes{0};
+    QAtomicInt m_warmStartHitCount{0};
+
     // Auto-preload configuration (Stage 4.1.5)
     bool m_autoPreloadEnabled{true};    // Auto-preload on startup
     int m_autoPreloadCount{30};         // Number of icons to preload
     mutable QMutex m_autoPreloadMutex;
 
+    // Theme generation (XdgIcon::themeGeneration()) the L1 and L2 entries belong to
+    QAtomicInteger<uint> m_themeGeneration{0};
+
+    /*!
+     * \brief Clear L1 and L2 if the icon theme generation changed since the last request
+     */
+    void checkThemeGeneration();
+
     // Helper methods
-    QString cacheKey(const QString &iconName, const QSize &size, int state) const;
-    QImage* getCachedImage(const QString &key);
-    void putCachedImage(const QString &key, const QImage &image);
+    /*!
+     * \brief The key used by all cache levels, compute it once per request
+     */
+    IconCacheKey cacheKey(const QString &iconName, const QSize &size, int state,
+                          qreal devicePixelRatio = 1.0,
+                          const QString &themeName = QString()) const;
+
+    /*!
+     * \brief Serve \a key from a 2x render of the same icon
+     *
+     * Looks for \a key at ratio 2 in L2 and, if \a checkDisk, in L3 and
+     * downsamples it to the ratio of \a key. Returns a null image if \a key
+     * is 2x or more already or no such render is cached. Thread-safe.
+     */
+    QImage findDownsampleSource(const IconCacheKey &key, bool checkDisk);
+    /*!
+     * \brief L2 lookup, returns a null QImage on a miss
+     */
+    QImage getCachedImage(const IconCacheKey &key);
+    void putCachedImage(const IconCacheKey &key, const QImage &image);
+
+    /*!
+     * \brief Load \a key in the loader stages, sharing an in-flight load
+     *
+     * If a load for \a key is already queued or running it is returned and
+     * neither loader is called. Otherwise \a ioLoader (cache reads and
+     * decoding) is queued in the I/O stage at \a priority. Only if it
+     * returns a null image \a cpuLoader (rendering) is queued in the CPU
+     * stage. Loads below InteractivePriority don't make preloads yield. The non-null result is stored in the L2 cache before the key
+     * leaves the in-flight table. The loaders must not reference the
+     * caller, they may outlive it.
+     *
+     * Every call must be balanced by releaseShared() if the caller stops
+     * waiting before the future finishes.
+     */
+    std::shared_ptr<InFlightLoad> loadShared(const IconCacheKey &key,
+                                             const std::function<QImage()> &ioLoader,
+                                             const std::function<QImage()> &cpuLoader,
+                                             int priority = InteractivePriority);
+
+    /*!
+     * \brief Stop waiting for \a load
+     *
+     * When the last waiter leaves, the load leaves the in-flight table and
+     * is dropped if it has not started yet. A running load still completes
+     * and fills the L2 cache.
+     */
+    void releaseShared(const IconCacheKey &key, const std::shared_ptr<InFlightLoad> &load);
+
+    /*!
+     * \brief Load \a icons into L2 in the background, skipping cached ones
+     *
+     * Used for IconSequencePredictor predictions. Loads one icon at a time
+     * at PreloadPriority and yields while requests from QML are loading,
+     * like preloadIcons(). cancelPreload() stops it. Only one batch runs at a
+     * time, a batch arriving meanwhile is ignored. Returns false in that
+     * case.
+     */
+    bool preloadPredicted(const QList<IconSequencePredictor::IconRequest> &icons,
+                          qreal devicePixelRatio, const QString &themeName);
+
+    /*!
+     * \brief Queue \a image for the L3 cache's write-behind batches, off the render path
+     * \param sourceFile Icon file it was rendered from, validates later hits
+     */
+    void saveToDiskLater(const IconCacheKey &key, const QImage &image, const QString &sourceFile);
 
     void recordCacheHit();
     void recordCacheMiss();
+    void recordLoadStarted();
+    void recordLoadCoalesced();
 };
 
 #endif // FASTICONPROVIDER_H
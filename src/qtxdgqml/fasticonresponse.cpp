@@ -30,8 +30,8 @@
 #include "cachedtexturefactory.h"
 #include "diskiconcache.h"
 #include "iconusagetracker.h"
+#include "icontrace.h"
 #include <XdgIcon>
-#include <QtConcurrent>
 #include <QIcon>
 #include <QPixmap>
 #include <QDebug>
@@ -39,24 +39,32 @@
 FastIconResponse::FastIconResponse(
     const QString &iconName,
     const QSize &size,
+    qreal devicePixelRatio,
     const QString &fallback,
     IconState state,
+    const QString &themeName,
     FastIconProvider *provider)
     : QQuickImageResponse()
     , m_iconName(iconName)
     , m_fallbackName(fallback)
+    , m_themeName(themeName)
     , m_requestedSize(size)
+    , m_devicePixelRatio(devicePixelRatio)
     , m_state(state)
     , m_provider(provider)
 {
     // Check L2 cache first (on main thread, should be very fast)
-    QString key = m_provider->cacheKey(m_iconName, m_requestedSize, static_cast<int>(m_state));
-    QImage *cachedImage = m_provider->getCachedImage(key);
+    m_cacheKey = m_provider->cacheKey(m_iconName, m_requestedSize, static_cast<int>(m_state),
+                                      m_devicePixelRatio, m_themeName);
+    if (m_cacheKey.isValid()) {
+        // Render at exactly the ratio the key stands for
+        m_devicePixelRatio = m_cacheKey.scale();
+    }
+    QImage cachedImage = m_provider->getCachedImage(m_cacheKey);
 
-    if (cachedImage) {
+    if (!cachedImage.isNull()) {
         // Cache hit! Use cached image immediately
-        m_result = *cachedImage;
-        delete cachedImage;
+        m_result = cachedImage;
 
         // Emit finished signal asynchronously (Qt requirement)
         QMetaObject::invokeMethod(this, "finished", Qt::QueuedConnection);
@@ -66,9 +74,21 @@ FastIconResponse::FastIconResponse(
         connect(m_watcher, &QFutureWatcher<QImage>::finished,
                 this, &FastIconResponse::onLoadFinished);
 
-        // Launch background loading task
-        m_future = QtConcurrent::run(&m_provider->m_loaderPool,
-                                     [this]() { return loadIconInBackground(); });
+        // Launch background loading task, or join an identical one in flight
+        m_load = m_provider->loadShared(m_cacheKey,
+            [provider = m_provider, iconName = m_iconName, size = m_requestedSize,
+             state = m_state, key = m_cacheKey]() {
+                // Record usage for smart preloading (Stage 4.1.4)
+                IconUsageTracker::instance()->recordAccess(iconName, size.width(), static_cast<int>(state));
+                return loadFromCaches(provider, iconName, key);
+            },
+            [provider = m_provider, iconName = m_iconName, size = m_requestedSize,
+             dpr = m_devicePixelRatio, fallback = m_fallbackName, state = m_state,
+             themeName = m_themeName, key = m_cacheKey]() {
+                return renderIcon(provider, iconName, size, dpr, fallback, state,
+                                  themeName, key);
+            });
+        m_future = m_load->future;
         m_watcher->setFuture(m_future);
     }
 }
@@ -76,32 +96,58 @@ FastIconResponse::FastIconResponse(
 FastIconResponse::~FastIconResponse()
 {
     // Future watcher is deleted by Qt parent system
+
+    // Deleted while still waiting, let the load go if nobody else needs it
+    if (m_load) {
+        m_provider->releaseShared(m_cacheKey, m_load);
+    }
 }
 
-QImage FastIconResponse::loadIconInBackground() const
+QImage FastIconResponse::loadFromCaches(FastIconProvider *provider,
+                                        const QString &iconName,
+                                        const IconCacheKey &cacheKey)
 {
-    // This function runs in background thread
+    // This function runs in the I/O stage
 
-    // Generate cache key for L3 disk cache
-    QString cacheKey = m_provider->cacheKey(m_iconName, m_requestedSize, static_cast<int>(m_state));
-
-    // Record usage for smart preloading (Stage 4.1.4)
-    IconUsageTracker::instance()->recordAccess(m_iconName, m_requestedSize.width(), static_cast<int>(m_state));
+    // 1. A 2x render already in memory only needs downsampling
+    QImage reused = provider->findDownsampleSource(cacheKey, false);
+    if (!reused.isNull()) {
+        return reused;
+    }
 
-    // 1. Check L3 disk cache first (Stage 4.1)
+    // 2. Check L3 disk cache (Stage 4.1), exact ratio first, then 2x
     QImage diskImage = DiskIconCache::instance()->loadFromDisk(cacheKey);
     if (!diskImage.isNull()) {
-        qDebug() << "L3 Disk cache HIT:" << m_iconName;
+        qDebug() << "L3 Disk cache HIT:" << iconName;
         return diskImage;  // Fast path: disk cache hit
     }
 
-    qDebug() << "L3 Disk cache MISS:" << m_iconName << "- loading from XdgIcon";
+    reused = provider->findDownsampleSource(cacheKey, true);
+    if (!reused.isNull()) {
+        return reused;
+    }
+
+    qDebug() << "L3 Disk cache MISS:" << iconName << "- loading from XdgIcon";
+    return QImage();
+}
+
+QImage FastIconResponse::renderIcon(FastIconProvider *provider,
+                                    const QString &iconName,
+                                    const QSize &size,
+                                    qreal devicePixelRatio,
+                                    const QString &fallback,
+                                    IconState state,
+                                    const QString &themeName,
+                                    const IconCacheKey &cacheKey)
+{
+    // This function runs in the CPU stage
+    IconTraceSpan span("render", cacheKey);
 
-    // 2. L3 Miss - Load from XdgIcon (original path)
+    // 3. L3 Miss - Load from XdgIcon (original path)
 
     // Convert icon state to QIcon::Mode
     QIcon::Mode mode = QIcon::Normal;
-    switch (m_state) {
+    switch (state) {
         case Disabled:
             mode = QIcon::Disabled;
             break;
@@ -114,49 +160,76 @@ QImage FastIconResponse::loadIconInBackground() const
             break;
     }
 
-    // Load icon using XdgIcon
-    QIcon icon = XdgIcon::fromTheme(m_iconName);
+    // Load icon using XdgIcon (an empty theme name resolves against the current theme)
+    QString resolvedName = iconName;
+    QIcon icon = XdgIcon::fromNamedTheme(resolvedName, themeName);
 
     // If icon not found and fallback specified, try fallback
-    if (icon.isNull() && !m_fallbackName.isEmpty()) {
-        icon = XdgIcon::fromTheme(m_fallbackName);
+    if (icon.isNull() && !fallback.isEmpty()) {
+        resolvedName = fallback;
+        icon = XdgIcon::fromNamedTheme(resolvedName, themeName);
     }
 
     // If still not found, use default application icon
     if (icon.isNull()) {
-        icon = XdgIcon::fromTheme(XdgIcon::defaultApplicationIconName());
+        resolvedName = XdgIcon::defaultApplicationIconName();
+        icon = XdgIcon::fromNamedTheme(resolvedName, themeName);
     }
 
-    // Convert QIcon to QImage
+    // Convert QIcon to QImage, rendered at the device pixel ratio all the
+    // way down to the icon engine's scaledPixmap(). Raster pixmaps are
+    // premultiplied ARGB32 already, so this normally shares the pixels.
     QImage result;
     if (!icon.isNull()) {
-        QPixmap pixmap = icon.pixmap(m_requestedSize, mode, QIcon::Off);
+        QPixmap pixmap = icon.pixmap(size, devicePixelRatio, mode, QIcon::Off);
         if (!pixmap.isNull()) {
-            result = pixmap.toImage();
+            result = CachedTextureFactory::toUploadFormat(pixmap.toImage());
         }
     }
 
-    // 3. Save to L3 disk cache for next time (Stage 4.1)
+    // 4. Save to L3 disk cache for next time (Stage 4.1), in the I/O stage.
+    // The file it came from lets later hits notice a theme upgrade.
     if (!result.isNull()) {
-        DiskIconCache::instance()->saveToDisk(cacheKey, result);
+        const QString sourceFile = resolvedName.startsWith(u'/')
+            ? resolvedName
+            : XdgIcon::fileName(icon, size, devicePixelRatio);
+        provider->saveToDiskLater(cacheKey, result, sourceFile);
     }
 
     return result;
 }
 
+void FastIconResponse::cancel()
+{
+    if (m_cancelled) {
+        return;
+    }
+    m_cancelled = true;
+
+    // Cache hits and finished loads have nothing left to release
+    if (m_watcher && !m_watcher->isFinished()) {
+        disconnect(m_watcher, nullptr, this, nullptr);
+        m_provider->releaseShared(m_cacheKey, m_load);
+        m_load.reset();
+
+        // The engine still expects finished() to clean up the response
+        m_error = QStringLiteral("Icon request cancelled: %1").arg(m_iconName);
+        QMetaObject::invokeMethod(this, "finished", Qt::QueuedConnection);
+    }
+}
+
 void FastIconResponse::onLoadFinished()
 {
     // This runs on main thread when background loading completes
+    m_load.reset();
 
-    m_result = m_future.result();
+    // A dropped load finishes without a result
+    m_result = m_future.resultCount() > 0 ? m_future.result() : QImage();
 
+    // The shared load already stored a successful result in the L2 cache
     if (m_result.isNull()) {
         m_error = QStringLiteral("Failed to load icon: %1").arg(m_iconName);
         qWarning() << m_error;
-    } else {
-        // Store in L2 cache for future use
-        QString key = m_provider->cacheKey(m_iconName, m_requestedSize, static_cast<int>(m_state));
-        m_provider->putCachedImage(key, m_result);
     }
 
     // Notify QML Image component that loading is complete
@@ -169,17 +242,11 @@ QQuickTextureFactory* FastIconResponse::textureFactory() const
         return nullptr;
     }
 
-    // Generate cache key for GPU texture cache
-    // Format: "iconName@WxH_state"
-    QString cacheKey = QString::fromLatin1("%1@%2x%3_%4")
-        .arg(m_iconName)
-        .arg(m_requestedSize.width())
-        .arg(m_requestedSize.height())
-        .arg(static_cast<int>(m_state));
-
-    // Create CachedTextureFactory for L1 GPU texture caching
-    // This enables texture reuse across multiple Image components
-    return new CachedTextureFactory(m_result, cacheKey, true);
+    // Create CachedTextureFactory for L1 GPU texture caching, keyed by the
+    // same key as L2/L3. This enables texture reuse across multiple Image
+    // components. m_result shares its pixels with the L2 entry and is
+    // already in the upload format, the factory uploads it as is
+    return new CachedTextureFactory(m_result, m_cacheKey, true);
 }
 
 QString FastIconResponse::errorString() const
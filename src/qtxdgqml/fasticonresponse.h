@@ -28,6 +28,8 @@
 #ifndef FASTICONRESPONSE_H
 #define FASTICONRESPONSE_H
 
+#include "fasticonprovider.h"
+
 #include <QQuickImageResponse>
 #include <QFuture>
 #include <QFutureWatcher>
@@ -35,7 +37,7 @@
 #include <QString>
 #include <QSize>
 
-class FastIconProvider;
+#include <memory>
 
 /*!
  * \brief Async response for icon loading requests
@@ -45,10 +47,15 @@ class FastIconProvider;
  *
  * Lifecycle:
  * 1. Created by FastIconProvider::requestImageResponse()
- * 2. Starts background loading immediately in constructor
+ * 2. Starts background loading immediately in constructor, or attaches
+ *    to a load of the same icon that is already running
  * 3. Emits finished() signal when loading completes
  * 4. QML Image component calls textureFactory() to get the result
  * 5. Deleted by Qt's QML engine when no longer needed
+ *
+ * If the engine no longer needs the image (e.g. the delegate scrolled out
+ * of a ListView) it calls cancel(); a load that has not started yet and
+ * no other response waits for is then dropped from the queue.
  */
 class FastIconResponse : public QQuickImageResponse
 {
@@ -69,15 +76,19 @@ public:
      * \brief Construct response and start async loading
      *
      * \param iconName XDG icon name (e.g., "document-open")
-     * \param size Requested icon size
+     * \param size Requested icon size in device independent pixels
+     * \param devicePixelRatio Ratio to render for, the image is size * ratio
      * \param fallback Fallback icon name (optional)
      * \param state Icon state (Normal/Disabled/Pressed/Hover)
+     * \param themeName Icon theme override (empty = current theme)
      * \param provider Parent provider for cache access
      */
     FastIconResponse(const QString &iconName,
                      const QSize &size,
+                     qreal devicePixelRatio,
                      const QString &fallback,
                      IconState state,
+                     const QString &themeName,
                      FastIconProvider *provider);
 
     ~FastIconResponse() override;
@@ -95,6 +106,13 @@ public:
      */
     QString errorString() const override;
 
+    /*!
+     * \brief Stop waiting for the icon
+     *
+     * Releases the shared load and emits finished() without a result.
+     */
+    void cancel() override;
+
 private Q_SLOTS:
     /*!
      * \brief Called when background loading completes
@@ -102,6 +120,9 @@ private Q_SLOTS:
     void onLoadFinished();
 
 private:
+    // Preloading reuses the load stages
+    friend class FastIconProvider;
+
     /*!
      * \brief Parse URL parameters from icon ID
      *
@@ -113,20 +134,43 @@ private:
                            IconState &state);
 
     /*!
-     * \brief Background loading function (runs in thread pool)
+     * \brief Cache lookups of a load (runs in the I/O stage)
+     *
+     * Tries the L2 and L3 caches, returns a null image on a miss.
+     * Static, like renderIcon(), so that a load shared by several responses
+     * does not depend on the lifetime of the response that started it.
+     */
+    static QImage loadFromCaches(FastIconProvider *provider,
+                                 const QString &iconName,
+                                 const IconCacheKey &cacheKey);
+
+    /*!
+     * \brief Theme lookup and rasterizing of a load (runs in the CPU stage)
      */
-    QImage loadIconInBackground() const;
+    static QImage renderIcon(FastIconProvider *provider,
+                             const QString &iconName,
+                             const QSize &size,
+                             qreal devicePixelRatio,
+                             const QString &fallback,
+                             IconState state,
+                             const QString &themeName,
+                             const IconCacheKey &cacheKey);
 
     QString m_iconName;
     QString m_fallbackName;
+    QString m_themeName;
     QSize m_requestedSize;
+    qreal m_devicePixelRatio;
     IconState m_state;
 
     QImage m_result;
     QString m_error;
 
+    IconCacheKey m_cacheKey;
+    std::shared_ptr<FastIconProvider::InFlightLoad> m_load;
     QFuture<QImage> m_future;
-    QFutureWatcher<QImage> *m_watcher;
+    QFutureWatcher<QImage> *m_watcher = nullptr;
+    bool m_cancelled = false;
 
     FastIconProvider *m_provider;
 };
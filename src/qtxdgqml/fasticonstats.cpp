@@ -29,6 +29,8 @@
 #include "fasticonprovider.h"
 #include "diskiconcache.h"
 #include "iconusagetracker.h"
+#include "iconsequencepredictor.h"
+#include <xdgiconmetrics.h>
 #include <QDebug>
 
 // Static provider instance
@@ -80,6 +82,18 @@ double FastIconStats::hitRate() const
     return s_provider->cacheStats().hitRate() * 100.0;  // Return as percentage
 }
 
+int FastIconStats::coalescedCount() const
+{
+    if (!s_provider) return 0;
+    return s_provider->cacheStats().coalescedCount;
+}
+
+double FastIconStats::coalescingRate() const
+{
+    if (!s_provider) return 0.0;
+    return s_provider->cacheStats().coalescingRate() * 100.0;  // Return as percentage
+}
+
 void FastIconStats::clearCache()
 {
     if (s_provider) {
@@ -93,6 +107,7 @@ void FastIconStats::resetStats()
 {
     if (s_provider) {
         s_provider->resetStats();
+        IconSequencePredictor::instance()->resetStats();
         Q_EMIT statsChanged();
         qDebug() << "FastIconProvider stats reset";
     }
@@ -149,6 +164,14 @@ QVariantMap FastIconStats::getStats() const
     map[QStringLiteral("cachedItems")] = stats.cachedItems;
     map[QStringLiteral("cacheBytes")] = QVariant::fromValue(stats.cacheBytes);
     map[QStringLiteral("hitRate")] = stats.hitRate() * 100.0;
+    map[QStringLiteral("loadCount")] = stats.loadCount;
+    map[QStringLiteral("coalescedCount")] = stats.coalescedCount;
+    map[QStringLiteral("coalescingRate")] = stats.coalescingRate() * 100.0;
+    map[QStringLiteral("droppedCount")] = stats.droppedCount;
+    map[QStringLiteral("downsampledCount")] = stats.downsampledCount;
+    map[QStringLiteral("warmStartedCount")] = stats.warmStartedCount;
+    map[QStringLiteral("warmStartBytes")] = QVariant::fromValue(stats.warmStartBytes);
+    map[QStringLiteral("warmStartHitCount")] = stats.warmStartHitCount;
 
     return map;
 }
@@ -218,6 +241,53 @@ void FastIconStats::preloadIcons(const QStringList &iconNames,
     qDebug() << "FastIconStats: preload started for" << iconNames.size() << "icons";
 }
 
+void FastIconStats::preloadIconItems(const QVariantList &items, QQuickWindow *window)
+{
+    if (!s_provider) {
+        qWarning() << "FastIconStats: provider not available";
+        return;
+    }
+
+    QList<FastIconProvider::PreloadItem> preloadItems;
+    preloadItems.reserve(items.size());
+    for (const QVariant &value : items) {
+        const QVariantMap map = value.toMap();
+
+        FastIconProvider::PreloadItem item;
+        item.iconName = map.value(QStringLiteral("name")).toString();
+        const QVariant size = map.value(QStringLiteral("size"), 32);
+        if (size.typeId() == QMetaType::QString) {
+            const QStringList parts = size.toString().split(QLatin1Char('x'));
+            if (parts.size() == 2) {
+                item.size = QSize(parts.at(0).toInt(), parts.at(1).toInt());
+            }
+        } else {
+            item.size = QSize(size.toInt(), size.toInt());
+        }
+        item.state = map.value(QStringLiteral("state"), 0).toInt();
+        item.scale = map.value(QStringLiteral("scale"), 0.0).toReal();
+
+        if (item.iconName.isEmpty() || item.size.isEmpty()) {
+            qWarning() << "FastIconStats: skipping invalid preload item" << map;
+            continue;
+        }
+        preloadItems.append(item);
+    }
+
+    connect(s_provider, &FastIconProvider::preloadProgress,
+            this, &FastIconStats::preloadProgressChanged,
+            Qt::UniqueConnection);
+
+    connect(s_provider, &FastIconProvider::preloadCompleted,
+            this, &FastIconStats::preloadFinished,
+            Qt::UniqueConnection);
+
+    s_provider->preloadIcons(preloadItems, window);
+
+    qDebug() << "FastIconStats: preload started for" << preloadItems.size() << "items"
+             << "window=" << window;
+}
+
 void FastIconStats::cancelPreload()
 {
     if (s_provider) {
@@ -261,6 +331,12 @@ void FastIconStats::clearDiskCache()
     qDebug() << "FastIconStats: Disk cache cleared";
 }
 
+void FastIconStats::invalidateDiskCacheTheme()
+{
+    DiskIconCache::instance()->invalidateTheme();
+    Q_EMIT statsChanged();
+}
+
 void FastIconStats::setDiskCacheEnabled(bool enabled)
 {
     DiskIconCache::instance()->setEnabled(enabled);
@@ -268,6 +344,13 @@ void FastIconStats::setDiskCacheEnabled(bool enabled)
     qDebug() << "FastIconStats: Disk cache" << (enabled ? "enabled" : "disabled");
 }
 
+void FastIconStats::setDiskCacheShared(bool shared)
+{
+    DiskIconCache::instance()->setSharedCacheEnabled(shared);
+    Q_EMIT statsChanged();
+    qDebug() << "FastIconStats: Disk cache" << (shared ? "shared" : "per application");
+}
+
 void FastIconStats::setDiskCacheMaxSize(int megabytes)
 {
     qint64 bytes = static_cast<qint64>(megabytes) * 1024 * 1024;
@@ -305,6 +388,28 @@ int FastIconStats::autoPreloadCount() const
     return s_provider->autoPreloadCount();
 }
 
+void FastIconStats::setWarmStartBudget(int kilobytes)
+{
+    if (s_provider) {
+        s_provider->setWarmStartBudget(qint64(kilobytes) * 1024);
+        qDebug() << "FastIconStats: Warm start budget set to" << kilobytes << "KB";
+    }
+}
+
+int FastIconStats::warmStartBudget() const
+{
+    if (!s_provider) return 0;
+    return int(s_provider->warmStartBudget() / 1024);
+}
+
+void FastIconStats::warmStartFromDisk()
+{
+    if (s_provider) {
+        s_provider->warmStartFromDisk();
+        qDebug() << "FastIconStats: Warm start triggered manually";
+    }
+}
+
 void FastIconStats::triggerAutoPreload()
 {
     if (s_provider) {
@@ -373,6 +478,10 @@ QVariantMap FastIconStats::getPerformanceReport() const
     l2Cache[QStringLiteral("cacheBytes")] = QVariant::fromValue(cacheBytes());
     l2Cache[QStringLiteral("cacheMB")] = cacheBytes() / 1024.0 / 1024.0;
     l2Cache[QStringLiteral("hitRate")] = hitRate() * 100.0;
+    l2Cache[QStringLiteral("coalescedCount")] = coalescedCount();
+    l2Cache[QStringLiteral("coalescingRate")] = coalescingRate();
+    l2Cache[QStringLiteral("droppedLoads")] = s_provider ? s_provider->cacheStats().droppedCount : 0;
+    l2Cache[QStringLiteral("downsampledLoads")] = s_provider ? s_provider->cacheStats().downsampledCount : 0;
     report[QStringLiteral("l2Cache")] = l2Cache;
 
     // L1 GPU Cache Statistics
@@ -389,17 +498,38 @@ QVariantMap FastIconStats::getPerformanceReport() const
     l3DiskCache[QStringLiteral("count")] = diskCacheCount();
     l3DiskCache[QStringLiteral("bytes")] = QVariant::fromValue(diskCacheBytes());
     l3DiskCache[QStringLiteral("sizeMB")] = diskCacheBytes() / 1024.0 / 1024.0;
+    l3DiskCache[QStringLiteral("queueDepth")] = DiskIconCache::instance()->pendingSaveCount();
+    l3DiskCache[QStringLiteral("droppedSaves")] = QVariant::fromValue(DiskIconCache::instance()->droppedSaveCount());
+    l3DiskCache[QStringLiteral("staleEntries")] = QVariant::fromValue(DiskIconCache::instance()->staleEntryCount());
+    l3DiskCache[QStringLiteral("checkedDirectories")] = DiskIconCache::instance()->checkedDirectoryCount();
+    l3DiskCache[QStringLiteral("themeGeneration")] = DiskIconCache::instance()->themeGeneration();
+    l3DiskCache[QStringLiteral("shared")] = DiskIconCache::instance()->isSharedCacheEnabled();
+    l3DiskCache[QStringLiteral("compression")] = DiskIconCache::instance()->isCompressionEnabled();
+    l3DiskCache[QStringLiteral("wastedBytes")] = QVariant::fromValue(DiskIconCache::instance()->getWastedBytes());
     l3DiskCache[QStringLiteral("maxBytes")] = QVariant::fromValue(diskCacheMaxSize());
     l3DiskCache[QStringLiteral("maxSizeMB")] = diskCacheMaxSize() / 1024.0 / 1024.0;
     l3DiskCache[QStringLiteral("usagePercent")] = diskCacheMaxSize() > 0
         ? (diskCacheBytes() * 100.0 / diskCacheMaxSize()) : 0.0;
     report[QStringLiteral("l3DiskCache")] = l3DiskCache;
 
+    // L3 entries put into L2 on start, and the first requests they served
+    QVariantMap warmStart;
+    const FastIconProvider::CacheStats providerStats = s_provider
+        ? s_provider->cacheStats() : FastIconProvider::CacheStats();
+    warmStart[QStringLiteral("budgetKB")] = warmStartBudget();
+    warmStart[QStringLiteral("icons")] = providerStats.warmStartedCount;
+    warmStart[QStringLiteral("bytes")] = QVariant::fromValue(providerStats.warmStartBytes);
+    warmStart[QStringLiteral("savedRequests")] = providerStats.warmStartHitCount;
+    warmStart[QStringLiteral("usefulPercent")] = providerStats.warmStartedCount > 0
+        ? (providerStats.warmStartHitCount * 100.0 / providerStats.warmStartedCount) : 0.0;
+    report[QStringLiteral("warmStart")] = warmStart;
+
     // Usage Tracking Statistics
     QVariantMap usageTracking;
     usageTracking[QStringLiteral("enabled")] = usageTrackingEnabled();
     usageTracking[QStringLiteral("trackedIconCount")] = trackedIconCount();
     usageTracking[QStringLiteral("totalAccesses")] = QVariant::fromValue(totalIconAccesses());
+    usageTracking[QStringLiteral("droppedEvents")] = QVariant::fromValue(IconUsageTracker::instance()->droppedEventCount());
 
     // Top 5 most used icons
     QStringList topIcons = getTopUsedIcons(5);
@@ -414,6 +544,12 @@ QVariantMap FastIconStats::getPerformanceReport() const
     autoPreload[QStringLiteral("isPreloading")] = isPreloading();
     report[QStringLiteral("autoPreload")] = autoPreload;
 
+    // Loader Scheduler
+    report[QStringLiteral("scheduler")] = getSchedulerStats();
+
+    // Predictive Preloading
+    report[QStringLiteral("predictor")] = getPredictorStats();
+
     // Overall Statistics
     QVariantMap overall;
     qint64 totalCacheBytes = cacheBytes() + gpuMemoryBytes() + diskCacheBytes();
@@ -424,3 +560,93 @@ QVariantMap FastIconStats::getPerformanceReport() const
 
     return report;
 }
+
+QVariantList FastIconStats::getLatencyHistograms() const
+{
+    QVariantList stages;
+
+    const QList<XdgIconMetrics::Snapshot> snapshots = XdgIconMetrics::snapshots();
+    for (const XdgIconMetrics::Snapshot &snapshot : snapshots) {
+        QVariantList buckets;
+        for (quint64 bucket : snapshot.buckets)
+            buckets.append(QVariant::fromValue(bucket));
+
+        QVariantMap stage;
+        stage[QStringLiteral("stage")] = XdgIconMetrics::stageName(snapshot.stage);
+        stage[QStringLiteral("count")] = QVariant::fromValue(snapshot.count);
+        stage[QStringLiteral("meanUs")] = snapshot.meanMicroseconds();
+        stage[QStringLiteral("p50Us")] = snapshot.percentile(0.50);
+        stage[QStringLiteral("p95Us")] = snapshot.percentile(0.95);
+        stage[QStringLiteral("p99Us")] = snapshot.percentile(0.99);
+        stage[QStringLiteral("buckets")] = buckets;
+        stages.append(stage);
+    }
+
+    return stages;
+}
+
+void FastIconStats::resetLatencyHistograms()
+{
+    XdgIconMetrics::reset();
+    Q_EMIT statsChanged();
+    qDebug() << "FastIconStats: Latency histograms reset";
+}
+
+QVariantMap FastIconStats::getSchedulerStats() const
+{
+    QVariantMap result;
+    if (!s_provider) return result;
+
+    const IconLoadScheduler *scheduler = s_provider->scheduler();
+    const IconLoadScheduler::Stats stats = scheduler->stats();
+
+    const auto stageMap = [](const IconLoadScheduler::StageStats &stage) {
+        QVariantMap map;
+        map[QStringLiteral("threads")] = stage.threads;
+        map[QStringLiteral("minThreads")] = stage.minThreads;
+        map[QStringLiteral("maxThreads")] = stage.maxThreads;
+        map[QStringLiteral("queued")] = stage.queued;
+        map[QStringLiteral("running")] = stage.running;
+        map[QStringLiteral("completed")] = stage.completed;
+        map[QStringLiteral("meanWaitUs")] = stage.meanWaitUs;
+        map[QStringLiteral("meanServiceUs")] = stage.meanServiceUs;
+        return map;
+    };
+
+    result[QStringLiteral("io")] = stageMap(stats.stages[IconLoadScheduler::IoStage]);
+    result[QStringLiteral("cpu")] = stageMap(stats.stages[IconLoadScheduler::CpuStage]);
+    result[QStringLiteral("adaptive")] = stats.adaptive;
+    result[QStringLiteral("adjustments")] = stats.adjustments;
+    result[QStringLiteral("decisions")] = scheduler->recentDecisions();
+    return result;
+}
+
+QVariantMap FastIconStats::getPredictorStats() const
+{
+    IconSequencePredictor *predictor = IconSequencePredictor::instance();
+    const IconSequencePredictor::Stats stats = predictor->stats();
+
+    QVariantMap result;
+    result[QStringLiteral("enabled")] = predictor->isEnabled();
+    result[QStringLiteral("triggerCount")] = stats.triggerCount;
+    result[QStringLiteral("sequencesObserved")] = QVariant::fromValue(stats.sequencesObserved);
+    result[QStringLiteral("predictionsIssued")] = QVariant::fromValue(stats.predictionsIssued);
+    result[QStringLiteral("predictedIcons")] = QVariant::fromValue(stats.predictedIcons);
+    result[QStringLiteral("predictedHits")] = QVariant::fromValue(stats.predictedHits);
+    result[QStringLiteral("preloadedIcons")] = s_provider ? s_provider->cacheStats().predictedPreloadCount : 0;
+    result[QStringLiteral("accuracy")] = stats.accuracy() * 100.0;
+    result[QStringLiteral("coverage")] = stats.coverage() * 100.0;
+    return result;
+}
+
+void FastIconStats::setPredictionEnabled(bool enabled)
+{
+    IconSequencePredictor::instance()->setEnabled(enabled);
+    Q_EMIT statsChanged();
+}
+
+void FastIconStats::clearPredictionModel()
+{
+    IconSequencePredictor::instance()->clearModel();
+    Q_EMIT statsChanged();
+}
@@ -30,6 +30,7 @@
 
 #include <QObject>
 #include <QQmlEngine>
+#include <QQuickWindow>
 
 class FastIconProvider;
 
@@ -65,6 +66,8 @@ class FastIconStats : public QObject
     Q_PROPERTY(int cachedItems READ cachedItems NOTIFY statsChanged)
     Q_PROPERTY(qint64 cacheBytes READ cacheBytes NOTIFY statsChanged)
     Q_PROPERTY(double hitRate READ hitRate NOTIFY statsChanged)
+    Q_PROPERTY(int coalescedCount READ coalescedCount NOTIFY statsChanged)
+    Q_PROPERTY(double coalescingRate READ coalescingRate NOTIFY statsChanged)
 
     // GPU cache statistics (Stage 3)
     Q_PROPERTY(int gpuTextureCount READ gpuTextureCount NOTIFY statsChanged)
@@ -92,6 +95,8 @@ public:
     int cachedItems() const;
     qint64 cacheBytes() const;
     double hitRate() const;
+    int coalescedCount() const;
+    double coalescingRate() const;
 
     // GPU property getters (Stage 3)
     int gpuTextureCount() const;
@@ -144,6 +149,22 @@ public Q_SLOTS:
                                   int size = 32,
                                   int state = 0);
 
+    /*!
+     * \brief QML callable: Preload icons of mixed sizes, states and scales
+     * \param items JS Array of objects { name, size, state, scale }, size
+     *        is an int or a "WxH" string, state and scale are optional
+     * \param window Create GPU textures for this window (e.g. Window.window),
+     *        so the first frame showing the icons needs no uploads (optional)
+     *
+     * \code
+     * FastIconStats.preloadIconItems([
+     *     { name: "firefox", size: 48 },
+     *     { name: "go-next", size: "16x16", state: 1, scale: 2 }
+     * ], Window.window)
+     * \endcode
+     */
+    Q_INVOKABLE void preloadIconItems(const QVariantList &items, QQuickWindow *window = nullptr);
+
     /*!
      * \brief QML callable: Cancel preload operation
      */
@@ -166,12 +187,27 @@ public Q_SLOTS:
      */
     Q_INVOKABLE void setDiskCacheEnabled(bool enabled);
 
+    /*!
+     * \brief QML callable: Use the disk cache shared by all processes
+     * \param shared Whether to use $XDG_CACHE_HOME/libqtxdg instead of
+     *        the application's own cache
+     */
+    Q_INVOKABLE void setDiskCacheShared(bool shared);
+
     /*!
      * \brief QML callable: Set disk cache max size
      * \param megabytes Maximum cache size in MB (default: 512MB)
      */
     Q_INVOKABLE void setDiskCacheMaxSize(int megabytes);
 
+    /*!
+     * \brief QML callable: Stop serving disk cached icons rendered so far
+     *
+     * Starts a new theme generation, e.g. after the icon theme was updated.
+     * Old entries are reclaimed in the background.
+     */
+    Q_INVOKABLE void invalidateDiskCacheTheme();
+
     // Auto-preload management (Stage 4.1.5)
     /*!
      * \brief QML callable: Enable/disable auto-preload
@@ -195,6 +231,23 @@ public Q_SLOTS:
      */
     Q_INVOKABLE int autoPreloadCount() const;
 
+    // Warm start
+    /*!
+     * \brief QML callable: Set the disk bytes a warm start reads at most
+     * \param kilobytes Budget, 0 disables warm starts
+     */
+    Q_INVOKABLE void setWarmStartBudget(int kilobytes);
+
+    /*!
+     * \brief QML callable: Get the warm start budget in kilobytes
+     */
+    Q_INVOKABLE int warmStartBudget() const;
+
+    /*!
+     * \brief QML callable: Fill the memory cache from the disk cache again
+     */
+    Q_INVOKABLE void warmStartFromDisk();
+
     /*!
      * \brief QML callable: Manually trigger auto-preload
      */
@@ -241,9 +294,62 @@ public Q_SLOTS:
      * - L3 disk cache stats
      * - Usage tracking stats
      * - Auto-preload config
+     * - Loader scheduler state
+     * - Sequence predictor accuracy
      */
     Q_INVOKABLE QVariantMap getPerformanceReport() const;
 
+    // Pipeline latency (XdgIconMetrics)
+    /*!
+     * \brief QML callable: Get latency histograms of the icon pipeline stages
+     * \return QVariantList with one QVariantMap per stage
+     *
+     * Every map contains the stage name, sample count, mean, p50, p95 and
+     * p99 in microseconds and the raw log2 bucket counts.
+     */
+    Q_INVOKABLE QVariantList getLatencyHistograms() const;
+
+    /*!
+     * \brief QML callable: Reset the latency histograms
+     */
+    Q_INVOKABLE void resetLatencyHistograms();
+
+    // Loader scheduling (IconLoadScheduler)
+    /*!
+     * \brief QML callable: Get the state of the adaptive loader stages
+     * \return QVariantMap with "io" and "cpu" stage maps, "adaptive",
+     *         "adjustments" and "decisions"
+     *
+     * Every stage map contains the thread count and its bounds, queued and
+     * running tasks and the mean queue wait and service time of the last
+     * adaptation window in microseconds. "decisions" lists the latest
+     * resizes with their reason, oldest first.
+     */
+    Q_INVOKABLE QVariantMap getSchedulerStats() const;
+
+    // Predictive preloading (IconSequencePredictor)
+    /*!
+     * \brief QML callable: Get accuracy of the sequence predictor
+     * \return QVariantMap with enabled, triggerCount, sequencesObserved,
+     *         predictionsIssued, predictedIcons, predictedHits,
+     *         preloadedIcons, accuracy and coverage (percent)
+     *
+     * accuracy is the share of predicted icons that were requested,
+     * coverage the share of requests in predicted sequences that were
+     * predicted.
+     */
+    Q_INVOKABLE QVariantMap getPredictorStats() const;
+
+    /*!
+     * \brief QML callable: Enable/disable predictive preloading
+     */
+    Q_INVOKABLE void setPredictionEnabled(bool enabled);
+
+    /*!
+     * \brief QML callable: Forget the learned sequences
+     */
+    Q_INVOKABLE void clearPredictionModel();
+
 Q_SIGNALS:
     void statsChanged();
 
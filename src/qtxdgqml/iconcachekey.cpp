@@ -0,0 +1,190 @@
+/* BEGIN_COMMON_COPYRIGHT_HEADER
+ * (c)LGPL2+
+ *
+ * LXQt - a lightweight, Qt based, desktop toolset
+ * https://lxqt.org
+ *
+ * Copyright: 2025 LXQt team
+ * Authors:
+ *   LXQt team
+ *
+ * This program or library is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ *
+ * END_COMMON_COPYRIGHT_HEADER */
+
+#include "iconcachekey.h"
+#include <QDebug>
+#include <QHash>
+#include <QIcon>
+#include <QList>
+#include <QReadWriteLock>
+
+namespace {
+
+// FNV-1a over the UTF-16 code units, stable across processes and Qt versions
+quint64 stableHash(const QString &string)
+{
+    quint64 hash = 14695981039346656037ULL;
+    for (const QChar c : string) {
+        hash ^= c.unicode();
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// splitmix64 finalizer
+quint64 mix(quint64 value)
+{
+    value += 0x9e3779b97f4a7c15ULL;
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+    return value ^ (value >> 31);
+}
+
+/*
+ * Maps strings to dense ids starting at 1, 0 means "table full".
+ * Ids are never reused, the tables only grow.
+ */
+class StringInterner
+{
+public:
+    explicit StringInterner(quint32 maxId) : m_maxId(maxId) {}
+
+    quint32 intern(const QString &string)
+    {
+        {
+            QReadLocker locker(&m_lock);
+            const auto it = m_ids.constFind(string);
+            if (it != m_ids.constEnd())
+                return it.value();
+        }
+
+        QWriteLocker locker(&m_lock);
+        const auto it = m_ids.constFind(string);
+        if (it != m_ids.constEnd())
+            return it.value();
+        if (quint32(m_strings.size()) >= m_maxId) {
+            qWarning() << "IconCacheKey: intern table full, not caching" << string;
+            return 0;
+        }
+        m_strings.append(string);
+        m_hashes.append(stableHash(string));
+        const quint32 id = quint32(m_strings.size());
+        m_ids.insert(string, id);
+        return id;
+    }
+
+    QString string(quint32 id) const
+    {
+        QReadLocker locker(&m_lock);
+        return id > 0 && id <= quint32(m_strings.size()) ? m_strings.at(id - 1) : QString();
+    }
+
+    quint64 hash(quint32 id) const
+    {
+        QReadLocker locker(&m_lock);
+        return id > 0 && id <= quint32(m_hashes.size()) ? m_hashes.at(id - 1) : 0;
+    }
+
+private:
+    mutable QReadWriteLock m_lock;
+    QHash<QString, quint32> m_ids;
+    QList<QString> m_strings;
+    QList<quint64> m_hashes;
+    const quint32 m_maxId;
+};
+
+}
+
+Q_GLOBAL_STATIC(StringInterner, iconNames, (1u << 21) - 1)
+Q_GLOBAL_STATIC(StringInterner, themeNames, (1u << 12) - 1)
+
+IconCacheKey::IconCacheKey(const QString &iconName,
+                           const QSize &size,
+                           int state,
+                           qreal scale,
+                           const QString &themeName)
+{
+    if (iconName.isEmpty() || size.width() < 0 || size.height() < 0
+        || quint64(size.width()) > SizeMask || quint64(size.height()) > SizeMask
+        || state < 0 || quint64(state) > StateMask) {
+        return;
+    }
+
+    const quint64 scaleSteps = quint64(qBound(1, qRound(scale * ScaleSteps), int(ScaleMask)));
+
+    // Entries of the current theme must not survive a theme switch
+    const quint32 nameId = iconNames()->intern(iconName);
+    const quint32 themeId = themeNames()->intern(themeName.isEmpty() ? QIcon::themeName() : themeName);
+    if (nameId == 0 || themeId == 0) {
+        return;
+    }
+
+    m_key = (quint64(nameId) << NameShift)
+          | (quint64(size.width()) << WidthShift)
+          | (quint64(size.height()) << HeightShift)
+          | (quint64(state) << StateShift)
+          | (scaleSteps << ScaleShift)
+          | (quint64(themeId) << ThemeShift);
+}
+
+IconCacheKey IconCacheKey::withScale(qreal scale) const
+{
+    IconCacheKey key;
+    if (isValid()) {
+        const quint64 scaleSteps = quint64(qBound(1, qRound(scale * ScaleSteps), int(ScaleMask)));
+        key.m_key = (m_key & ~(ScaleMask << ScaleShift)) | (scaleSteps << ScaleShift);
+    }
+    return key;
+}
+
+QString IconCacheKey::iconName() const
+{
+    return iconNames()->string(nameId());
+}
+
+QString IconCacheKey::themeName() const
+{
+    return themeNames()->string(themeId());
+}
+
+quint64 IconCacheKey::persistentId() const
+{
+    if (!isValid()) {
+        return 0;
+    }
+
+    // Same layout with the interned ids swapped for the stable name hashes
+    const quint64 fields = m_key & ~(~quint64(0) << NameShift) & ~ThemeMask;
+    quint64 id = mix(iconNames()->hash(nameId()));
+    id = mix(id ^ themeNames()->hash(themeId()));
+    return mix(id ^ fields);
+}
+
+QDebug operator<<(QDebug debug, const IconCacheKey &key)
+{
+    QDebugStateSaver saver(debug);
+    if (!key.isValid()) {
+        debug.nospace() << "IconCacheKey(invalid)";
+        return debug;
+    }
+    debug.nospace() << "IconCacheKey(" << key.iconName() << '@'
+                    << key.width() << 'x' << key.height()
+                    << " s" << key.state()
+                    << " *" << key.scale()
+                    << ' ' << key.themeName() << ')';
+    return debug;
+}
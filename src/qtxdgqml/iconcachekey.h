@@ -0,0 +1,147 @@
+/* BEGIN_COMMON_COPYRIGHT_HEADER
+ * (c)LGPL2+
+ *
+ * LXQt - a lightweight, Qt based, desktop toolset
+ * https://lxqt.org
+ *
+ * Copyright: 2025 LXQt team
+ * Authors:
+ *   LXQt team
+ *
+ * This program or library is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ *
+ * END_COMMON_COPYRIGHT_HEADER */
+
+#ifndef ICONCACHEKEY_H
+#define ICONCACHEKEY_H
+
+#include <QHashFunctions>
+#include <QSize>
+#include <QString>
+
+class QDebug;
+
+/*!
+ * \brief Compact cache key shared by the L1, L2 and L3 icon caches
+ *
+ * Packs one icon request into 64 bits:
+ *
+ *   | name id (21) | width (12) | height (12) | state (2) | scale (5) | theme id (12) |
+ *
+ * Icon and theme names are interned once per process, so building a key
+ * costs one hash lookup per name and comparing or hashing it afterwards is
+ * integer work. The scale is stored in steps of 1/4 (0.25 - 7.75).
+ *
+ * Interned ids are only meaningful inside the current process; use
+ * persistentId() for anything written to disk.
+ *
+ * The theme field identifies the theme by name only, not by generation
+ * (XdgIcon::themeGeneration()). FastIconProvider clears L1 and L2 when the
+ * generation changes, L3 keeps a generation of its own, see
+ * DiskIconCache::invalidateTheme().
+ *
+ * A key is invalid (isValid() == false) if it cannot be represented, e.g.
+ * for sizes above 4095 pixels or when the name table is full. Invalid keys
+ * must not be used for caching.
+ */
+class IconCacheKey
+{
+public:
+    IconCacheKey() = default;
+
+    /*!
+     * \param iconName XDG icon name
+     * \param size Requested size in device independent pixels
+     * \param state FastIconResponse::IconState
+     * \param scale Device pixel ratio the image is rendered for
+     * \param themeName Icon theme, empty = the current QIcon::themeName()
+     */
+    IconCacheKey(const QString &iconName,
+                 const QSize &size,
+                 int state,
+                 qreal scale = 1.0,
+                 const QString &themeName = QString());
+
+    bool isValid() const { return m_key != 0; }
+    quint64 toUInt64() const { return m_key; }
+
+    quint32 nameId() const { return quint32(m_key >> NameShift); }
+    int width() const { return int((m_key >> WidthShift) & SizeMask); }
+    int height() const { return int((m_key >> HeightShift) & SizeMask); }
+    QSize size() const { return QSize(width(), height()); }
+    int state() const { return int((m_key >> StateShift) & StateMask); }
+    qreal scale() const { return qreal((m_key >> ScaleShift) & ScaleMask) / ScaleSteps; }
+    quint32 themeId() const { return quint32(m_key & ThemeMask); }
+
+    /*!
+     * \brief Size of the rendered image in device pixels
+     */
+    QSize pixelSize() const { return (QSizeF(size()) * scale()).toSize(); }
+
+    /*!
+     * \brief The same request at another device pixel ratio
+     *
+     * Does not intern anything, returns an invalid key if this one is.
+     */
+    IconCacheKey withScale(qreal scale) const;
+
+    /*!
+     * \brief The interned names, for logging and persistence
+     */
+    QString iconName() const;
+    QString themeName() const;
+
+    /*!
+     * \brief Process independent 64-bit id of this key
+     *
+     * Derived from hashes of the icon and theme names computed once when
+     * they were interned, stable across runs. Used by the disk cache.
+     */
+    quint64 persistentId() const;
+
+    friend bool operator==(const IconCacheKey &a, const IconCacheKey &b) { return a.m_key == b.m_key; }
+    friend bool operator!=(const IconCacheKey &a, const IconCacheKey &b) { return a.m_key != b.m_key; }
+    friend size_t qHash(const IconCacheKey &key, size_t seed = 0) noexcept { return qHash(key.m_key, seed); }
+
+private:
+    static constexpr int NameBits = 21;
+    static constexpr int SizeBits = 12;
+    static constexpr int StateBits = 2;
+    static constexpr int ScaleBits = 5;
+    static constexpr int ThemeBits = 12;
+    static constexpr int ScaleSteps = 4;
+
+    static constexpr int ThemeShift = 0;
+    static constexpr int ScaleShift = ThemeShift + ThemeBits;
+    static constexpr int StateShift = ScaleShift + ScaleBits;
+    static constexpr int HeightShift = StateShift + StateBits;
+    static constexpr int WidthShift = HeightShift + SizeBits;
+    static constexpr int NameShift = WidthShift + SizeBits;
+    static_assert(NameShift + NameBits == 64, "IconCacheKey fields must fill 64 bits");
+
+    static constexpr quint64 SizeMask = (quint64(1) << SizeBits) - 1;
+    static constexpr quint64 StateMask = (quint64(1) << StateBits) - 1;
+    static constexpr quint64 ScaleMask = (quint64(1) << ScaleBits) - 1;
+    static constexpr quint64 ThemeMask = (quint64(1) << ThemeBits) - 1;
+
+    quint64 m_key = 0;
+};
+
+Q_DECLARE_TYPEINFO(IconCacheKey, Q_PRIMITIVE_TYPE);
+
+QDebug operator<<(QDebug debug, const IconCacheKey &key);
+
+#endif // ICONCACHEKEY_H
@@ -0,0 +1,263 @@
+/* BEGIN_COMMON_COPYRIGHT_HEADER
+ * (c)LGPL2+
+ *
+ * LXQt - a lightweight, Qt based, desktop toolset
+ * https://lxqt.org
+ *
+ * Copyright: 2025 LXQt team
+ * Authors:
+ *   LXQt team
+ *
+ * This program or library is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ *
+ * END_COMMON_COPYRIGHT_HEADER */
+
+#include "iconloadscheduler.h"
+
+#include <QDebug>
+#include <QMutexLocker>
+#include <QThread>
+
+namespace {
+
+// Queue wait above which the I/O stage gets another thread
+constexpr double IO_GROW_WAIT_US = 2000.0;
+
+// Service time increase after growing the CPU stage that counts as contention
+constexpr double CPU_CONTENTION_FACTOR = 1.5;
+
+constexpr int IO_MAX_THREADS = 4;
+
+QString stageLabel(IconLoadScheduler::Stage stage)
+{
+    return stage == IconLoadScheduler::IoStage ? QStringLiteral("io") : QStringLiteral("cpu");
+}
+
+} // namespace
+
+IconLoadScheduler::IconLoadScheduler(QObject *parent)
+    : QObject(parent)
+{
+    const int cores = qMax(1, QThread::idealThreadCount());
+
+    // Leave the GUI and the scene graph render thread their cores
+    StageState &cpu = m_state[CpuStage];
+    cpu.maxThreads = qMax(1, cores - 2);
+    cpu.minThreads = qMin(cpu.maxThreads, qMax(1, cores / 4));
+
+    StageState &io = m_state[IoStage];
+    io.minThreads = 1;
+    io.maxThreads = qMin(IO_MAX_THREADS, qMax(2, cores / 2));
+
+    // Start in the middle and let feedback move from there
+    m_pools[CpuStage].setMaxThreadCount(qBound(cpu.minThreads, cores / 2, cpu.maxThreads));
+    m_pools[IoStage].setMaxThreadCount(qMin(2, io.maxThreads));
+
+    m_adaptTimer.setInterval(AdaptIntervalMs);
+    connect(&m_adaptTimer, &QTimer::timeout, this, &IconLoadScheduler::adapt);
+    m_adaptTimer.start();
+
+    qDebug() << "IconLoadScheduler initialized:"
+             << "io=" << m_pools[IoStage].maxThreadCount() << "/" << io.maxThreads
+             << "cpu=" << m_pools[CpuStage].maxThreadCount() << "/" << cpu.maxThreads;
+}
+
+IconLoadScheduler::~IconLoadScheduler()
+{
+    waitForDone();
+}
+
+void IconLoadScheduler::setCpuThreadLimit(int count)
+{
+    QMutexLocker locker(&m_stateMutex);
+
+    if (count <= 0) {
+        m_adaptive = true;
+        return;
+    }
+
+    m_adaptive = false;
+    const int threads = qBound(1, count, qMax(1, QThread::idealThreadCount()) * 2);
+    m_pools[CpuStage].setMaxThreadCount(threads);
+    m_state[CpuStage].lastWasIncrease = false;
+}
+
+int IconLoadScheduler::cpuThreadLimit() const
+{
+    return m_pools[CpuStage].maxThreadCount();
+}
+
+void IconLoadScheduler::waitForDone()
+{
+    // I/O tasks hand work to the CPU stage and CPU tasks may queue disk
+    // writes, drain until both are quiet
+    m_pools[IoStage].waitForDone();
+    m_pools[CpuStage].waitForDone();
+    m_pools[IoStage].waitForDone();
+}
+
+IconLoadScheduler::Stats IconLoadScheduler::stats() const
+{
+    QMutexLocker locker(&m_stateMutex);
+
+    Stats result;
+    result.adaptive = m_adaptive;
+    result.adjustments = m_adjustments;
+    for (int i = 0; i < StageCount; ++i) {
+        StageStats &stage = result.stages[i];
+        stage = m_state[i].window;
+        stage.threads = m_pools[i].maxThreadCount();
+        stage.minThreads = m_state[i].minThreads;
+        stage.maxThreads = m_state[i].maxThreads;
+        stage.queued = m_counters[i].queued.loadRelaxed();
+        stage.running = m_counters[i].running.loadRelaxed();
+    }
+    return result;
+}
+
+QStringList IconLoadScheduler::recentDecisions() const
+{
+    QMutexLocker locker(&m_stateMutex);
+    return m_recentDecisions;
+}
+
+void IconLoadScheduler::adapt()
+{
+    QMutexLocker locker(&m_stateMutex);
+
+    bool idle = true;
+    for (int i = 0; i < StageCount; ++i) {
+        StageCounters &counters = m_counters[i];
+        StageStats &window = m_state[i].window;
+
+        // Take the window's totals, tasks finishing meanwhile land in the next one
+        const int completed = counters.completed.fetchAndStoreRelaxed(0);
+        const qint64 waitNs = counters.waitNanoseconds.fetchAndStoreRelaxed(0);
+        const qint64 serviceNs = counters.serviceNanoseconds.fetchAndStoreRelaxed(0);
+
+        window.completed = completed;
+        window.queued = counters.queued.loadRelaxed();
+        window.running = counters.running.loadRelaxed();
+        window.meanWaitUs = completed > 0 ? waitNs / 1000.0 / completed : 0.0;
+        window.meanServiceUs = completed > 0 ? serviceNs / 1000.0 / completed : 0.0;
+        idle = idle && completed == 0 && window.queued == 0 && window.running == 0;
+
+        adaptStage(static_cast<Stage>(i));
+    }
+
+    // The idle stages were shrunk above, nothing to do until the next
+    // spawn(), which restarts the timer
+    if (idle) {
+        m_adaptTimerActive.fetchAndStoreOrdered(0);
+
+        // A task spawned meanwhile may have seen the timer still active
+        bool pending = false;
+        for (const StageCounters &counters : m_counters) {
+            pending = pending || counters.queued.loadAcquire() > 0 || counters.running.loadAcquire() > 0;
+        }
+        if (!pending || !m_adaptTimerActive.testAndSetOrdered(0, 1)) {
+            m_adaptTimer.stop();
+        }
+    }
+}
+
+void IconLoadScheduler::resumeAdapting()
+{
+    if (m_adaptTimerActive.testAndSetOrdered(0, 1)) {
+        // spawn() runs on any thread, the timer lives on the scheduler's
+        QMetaObject::invokeMethod(&m_adaptTimer, qOverload<>(&QTimer::start), Qt::QueuedConnection);
+    }
+}
+
+void IconLoadScheduler::adaptStage(Stage stage)
+{
+    StageState &state = m_state[stage];
+    const StageStats &window = state.window;
+    const int threads = m_pools[stage].maxThreadCount();
+    const bool idle = window.completed == 0 && window.queued == 0 && window.running == 0;
+
+    if (stage == CpuStage && !m_adaptive) {
+        return;
+    }
+
+    if (idle) {
+        if (threads > state.minThreads) {
+            resize(stage, state.minThreads, QStringLiteral("idle"));
+        }
+        state.lastWasIncrease = false;
+        return;
+    }
+
+    if (window.completed == 0) {
+        return;
+    }
+
+    if (stage == IoStage) {
+        if (window.queued > threads && window.meanWaitUs > IO_GROW_WAIT_US && threads < state.maxThreads) {
+            resize(stage, threads + 1,
+                   QStringLiteral("queue %1, wait %2 ms")
+                       .arg(window.queued)
+                       .arg(window.meanWaitUs / 1000.0, 0, 'f', 1));
+        }
+        return;
+    }
+
+    // CPU stage: hill climbing on queue wait vs. service time
+    if (state.lastWasIncrease && state.serviceBeforeIncreaseUs > 0.0
+        && window.meanServiceUs > state.serviceBeforeIncreaseUs * CPU_CONTENTION_FACTOR
+        && threads > state.minThreads) {
+        resize(stage, threads - 1,
+               QStringLiteral("contention, service %1 ms > %2 ms")
+                   .arg(window.meanServiceUs / 1000.0, 0, 'f', 1)
+                   .arg(state.serviceBeforeIncreaseUs / 1000.0, 0, 'f', 1));
+        state.lastWasIncrease = false;
+        return;
+    }
+
+    state.lastWasIncrease = false;
+    if (window.queued > 0 && window.meanWaitUs > window.meanServiceUs && threads < state.maxThreads) {
+        state.serviceBeforeIncreaseUs = window.meanServiceUs;
+        state.lastWasIncrease = true;
+        resize(stage, threads + 1,
+               QStringLiteral("queue %1, wait %2 ms > service %3 ms")
+                   .arg(window.queued)
+                   .arg(window.meanWaitUs / 1000.0, 0, 'f', 1)
+                   .arg(window.meanServiceUs / 1000.0, 0, 'f', 1));
+    }
+}
+
+void IconLoadScheduler::resize(Stage stage, int threads, const QString &reason)
+{
+    const int previous = m_pools[stage].maxThreadCount();
+    if (threads == previous) {
+        return;
+    }
+
+    m_pools[stage].setMaxThreadCount(threads);
+    ++m_adjustments;
+
+    const QString decision = QStringLiteral("%1 %2→%3: %4")
+                                 .arg(stageLabel(stage))
+                                 .arg(previous)
+                                 .arg(threads)
+                                 .arg(reason);
+    m_recentDecisions.append(decision);
+    while (m_recentDecisions.size() > MaxRecentDecisions) {
+        m_recentDecisions.removeFirst();
+    }
+
+    qDebug() << "IconLoadScheduler:" << decision;
+}
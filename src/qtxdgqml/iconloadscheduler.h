@@ -0,0 +1,203 @@
+/* BEGIN_COMMON_COPYRIGHT_HEADER
+ * (c)LGPL2+
+ *
+ * LXQt - a lightweight, Qt based, desktop toolset
+ * https://lxqt.org
+ *
+ * Copyright: 2025 LXQt team
+ * Authors:
+ *   LXQt team
+ *
+ * This program or library is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ *
+ * END_COMMON_COPYRIGHT_HEADER */
+
+#ifndef ICONLOADSCHEDULER_H
+#define ICONLOADSCHEDULER_H
+
+#include <QObject>
+#include <QThreadPool>
+#include <QTimer>
+#include <QAtomicInt>
+#include <QAtomicInteger>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QStringList>
+#include <QtConcurrent>
+
+#include <array>
+#include <type_traits>
+
+/*!
+ * \brief Two stage, self-sizing thread pools for FastIconProvider
+ *
+ * Icon loads have an I/O bound part (disk cache reads and PNG decoding)
+ * and a CPU bound part (theme lookup and SVG rasterization). They run in
+ * separate pools so that slow disk reads don't hold threads rasterizing
+ * needs and vice versa:
+ *
+ * - IoStage: small pool, grows while tasks queue up waiting for a thread
+ *   and shrinks back to one thread when idle.
+ * - CpuStage: sized to the free cores (ideal thread count minus the GUI
+ *   and scene graph render threads). Grows while tasks wait longer than
+ *   they run; backs off when the last increase made tasks slower
+ *   (contention), shrinks when idle.
+ *
+ * Every task spawned through spawn() reports its queue wait and service
+ * time. adapt() runs every AdaptIntervalMs on the scheduler's thread,
+ * compares the last window against the previous one and resizes the
+ * pools. Its decisions are kept in recentDecisions() for FastIconStats.
+ * The timer stops while both stages are idle, the next spawn() restarts
+ * it.
+ */
+class IconLoadScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Stage {
+        IoStage = 0,
+        CpuStage,
+        StageCount
+    };
+
+    static constexpr int AdaptIntervalMs = 500;
+    static constexpr int MaxRecentDecisions = 16;
+
+    explicit IconLoadScheduler(QObject *parent = nullptr);
+    ~IconLoadScheduler() override;
+
+    QThreadPool *pool(Stage stage) { return &m_pools[stage]; }
+
+    /*!
+     * \brief Run \a function in the pool of \a stage at \a priority
+     *
+     * Same as QtConcurrent::task(function).onThreadPool(...).withPriority(...)
+     * .spawn(), plus the timing that adapt() feeds on.
+     */
+    template<typename Function>
+    auto spawn(Stage stage, int priority, Function &&function)
+    {
+        StageCounters &counters = m_counters[stage];
+        counters.queued.ref();
+        if (!m_adaptTimerActive.loadAcquire()) {
+            resumeAdapting();
+        }
+        QElapsedTimer queuedTimer;
+        queuedTimer.start();
+
+        return QtConcurrent::task([&counters, queuedTimer, function = std::forward<Function>(function)]() mutable {
+            counters.queued.deref();
+            counters.running.ref();
+            counters.waitNanoseconds.fetchAndAddRelaxed(queuedTimer.nsecsElapsed());
+
+            QElapsedTimer serviceTimer;
+            serviceTimer.start();
+            const auto finish = [&counters, &serviceTimer] {
+                counters.serviceNanoseconds.fetchAndAddRelaxed(serviceTimer.nsecsElapsed());
+                counters.completed.ref();
+                counters.running.deref();
+            };
+            if constexpr (std::is_void_v<std::invoke_result_t<std::decay_t<Function> &>>) {
+                function();
+                finish();
+            } else {
+                auto result = function();
+                finish();
+                return result;
+            }
+        })
+        .onThreadPool(m_pools[stage])
+        .withPriority(priority)
+        .spawn();
+    }
+
+    /*!
+     * \brief Pin the CPU stage to \a count threads, 0 re-enables adaptation
+     */
+    void setCpuThreadLimit(int count);
+    int cpuThreadLimit() const;
+
+    /*!
+     * \brief Wait until both stages are idle
+     */
+    void waitForDone();
+
+    struct StageStats {
+        int threads = 0;
+        int minThreads = 0;
+        int maxThreads = 0;
+        int queued = 0;
+        int running = 0;
+        double meanWaitUs = 0.0;     // Queue wait of the last window
+        double meanServiceUs = 0.0;  // Run time of the last window
+        int completed = 0;           // Tasks finished in the last window
+    };
+
+    struct Stats {
+        std::array<StageStats, StageCount> stages;
+        bool adaptive = true;
+        int adjustments = 0;
+    };
+
+    Stats stats() const;
+    QStringList recentDecisions() const;
+
+public Q_SLOTS:
+    /*!
+     * \brief Evaluate the last window and resize the pools
+     */
+    void adapt();
+
+private:
+    struct StageCounters {
+        QAtomicInt queued{0};
+        QAtomicInt running{0};
+        QAtomicInt completed{0};
+        QAtomicInteger<qint64> waitNanoseconds{0};
+        QAtomicInteger<qint64> serviceNanoseconds{0};
+    };
+
+    // Decision state of one stage, only touched by adapt() and stats()
+    struct StageState {
+        int minThreads = 1;
+        int maxThreads = 1;
+        StageStats window;
+        double serviceBeforeIncreaseUs = 0.0;
+        bool lastWasIncrease = false;
+    };
+
+    void adaptStage(Stage stage);
+    void resize(Stage stage, int threads, const QString &reason);
+
+    /*!
+     * \brief Restart the adapt() timer stopped while idle, from any thread
+     */
+    void resumeAdapting();
+
+    std::array<QThreadPool, StageCount> m_pools;
+    std::array<StageCounters, StageCount> m_counters;
+    std::array<StageState, StageCount> m_state;
+
+    QTimer m_adaptTimer;
+    QAtomicInt m_adaptTimerActive{1};  // Cleared by adapt() when it stops the timer
+    bool m_adaptive = true;
+    int m_adjustments = 0;
+    QStringList m_recentDecisions;
+    mutable QMutex m_stateMutex;
+};
+
+#endif // ICONLOADSCHEDULER_H
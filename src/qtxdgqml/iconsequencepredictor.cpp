@@ -0,0 +1,424 @@
+/* BEGIN_COMMON_COPYRIGHT_HEADER
+ * (c)LGPL2+
+ *
+ * LXQt - a lightweight, Qt based, desktop toolset
+ * https://lxqt.org
+ *
+ * Copyright: 2025 LXQt team
+ * Authors:
+ *   LXQt team
+ *
+ * This program or library is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ *
+ * END_COMMON_COPYRIGHT_HEADER */
+
+#include "iconsequencepredictor.h"
+#include <QStandardPaths>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QMutexLocker>
+#include <QtConcurrent>
+#include <QtMath>
+#include <QDebug>
+#include <algorithm>
+
+// Model file format version
+static const int MODEL_VERSION = 1;
+
+// Write the model after every N learned sequences
+static const int AUTO_SAVE_SEQUENCES = 20;
+
+// Pseudo trigger the first sequence of every run is learned under
+static const QLatin1String STARTUP_TRIGGER("@startup");
+
+// Static members
+IconSequencePredictor *IconSequencePredictor::s_instance = nullptr;
+QMutex IconSequencePredictor::s_instanceMutex;
+
+IconSequencePredictor *IconSequencePredictor::instance()
+{
+    if (!s_instance) {
+        QMutexLocker locker(&s_instanceMutex);
+        if (!s_instance) {
+            s_instance = new IconSequencePredictor();
+        }
+    }
+    return s_instance;
+}
+
+IconSequencePredictor::IconSequencePredictor(QObject *parent)
+    : QObject(parent)
+{
+    // Next to IconUsageTracker's icon-usage.json
+    QString cacheRoot = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    if (cacheRoot.isEmpty()) {
+        cacheRoot = QDir::homePath() + QLatin1String("/.cache");
+    }
+    const QString cacheDir = cacheRoot + QLatin1String("/libqtxdg");
+    m_modelFilePath = cacheDir + QLatin1String("/icon-sequences.json");
+    QDir().mkpath(cacheDir);
+
+    loadModel();
+
+    // The singleton is never deleted, keep what this run learned
+    if (QCoreApplication *app = QCoreApplication::instance()) {
+        connect(app, &QCoreApplication::aboutToQuit, this, [this]() {
+            {
+                QMutexLocker locker(&m_mutex);
+                finishSequence();
+            }
+            saveModel();
+        }, Qt::DirectConnection);
+    }
+
+    qDebug() << "IconSequencePredictor initialized:"
+             << "model_file=" << m_modelFilePath
+             << "triggers=" << m_model.size();
+}
+
+IconSequencePredictor::~IconSequencePredictor()
+{
+    saveModel();
+}
+
+QString IconSequencePredictor::requestKey(const QString &iconName, const QSize &size, int state)
+{
+    // Same shape as IconUsageTracker's keys: "iconName@WxH_state"
+    return QString::fromLatin1("%1@%2x%3_%4")
+        .arg(iconName)
+        .arg(size.width())
+        .arg(size.height())
+        .arg(state);
+}
+
+QList<IconSequencePredictor::IconRequest> IconSequencePredictor::observe(const QString &iconName,
+                                                                         const QSize &size,
+                                                                         int state)
+{
+    QMutexLocker locker(&m_mutex);
+    if (!m_enabled || iconName.isEmpty()) {
+        return {};
+    }
+
+    const QString key = requestKey(iconName, size, state);
+    const bool newSequence = !m_lastRequest.isValid() || m_lastRequest.elapsed() > SequenceGapMs;
+    m_lastRequest.start();
+
+    if (newSequence) {
+        finishSequence();
+    }
+
+    if (m_predicted.remove(key)) {
+        m_stats.predictedHits++;
+    }
+
+    if (newSequence) {
+        m_triggerKey = key;
+        m_triggerRequest = IconRequest{iconName, size, state};
+        return predict(key);
+    }
+
+    if (key != m_triggerKey && m_sequence.size() < MaxSequenceLength && !m_sequenceKeys.contains(key)) {
+        m_sequenceKeys.insert(key);
+        m_sequence.append(IconRequest{iconName, size, state});
+    }
+    return {};
+}
+
+QList<IconSequencePredictor::IconRequest> IconSequencePredictor::predictStartup()
+{
+    QMutexLocker locker(&m_mutex);
+    if (!m_enabled || !m_startupSequence) {
+        return {};
+    }
+    return predict(STARTUP_TRIGGER);
+}
+
+void IconSequencePredictor::finishSequence()
+{
+    if (m_triggerKey.isEmpty()) {
+        return;
+    }
+
+    // A lone request teaches nothing about what follows it
+    if (!m_sequence.isEmpty()) {
+        learn(m_triggerKey, m_sequence);
+        m_stats.sequencesObserved++;
+    }
+
+    if (m_startupSequence) {
+        QList<IconRequest> startup;
+        startup.reserve(m_sequence.size() + 1);
+        startup.append(m_triggerRequest);
+        startup.append(m_sequence);
+        learn(STARTUP_TRIGGER, startup);
+        m_startupSequence = false;
+    }
+
+    if (m_sequencePredicted) {
+        m_stats.requestsInPredictedSequences += m_sequence.size() + 1;
+    }
+
+    m_triggerKey.clear();
+    m_sequence.clear();
+    m_sequenceKeys.clear();
+    m_predicted.clear();
+    m_sequencePredicted = false;
+
+    if (++m_sequencesSinceSave >= AUTO_SAVE_SEQUENCES) {
+        m_sequencesSinceSave = 0;
+        saveModelLater();
+    }
+}
+
+void IconSequencePredictor::learn(const QString &triggerKey, const QList<IconRequest> &requests)
+{
+    Trigger &trigger = m_model[triggerKey];
+    trigger.sequences++;
+    trigger.lastSeen = QDateTime::currentMSecsSinceEpoch();
+
+    for (const IconRequest &request : requests) {
+        Follower &follower = trigger.followers[requestKey(request.iconName, request.size, request.state)];
+        follower.request = request;
+        follower.count++;
+    }
+
+    // Keep the followers that recur, one-off icons are noise
+    if (trigger.followers.size() > 2 * MaxSequenceLength) {
+        QList<std::pair<int, QString>> ranked;
+        ranked.reserve(trigger.followers.size());
+        for (auto it = trigger.followers.cbegin(); it != trigger.followers.cend(); ++it) {
+            ranked.append({it->count, it.key()});
+        }
+        std::partial_sort(ranked.begin(), ranked.begin() + MaxSequenceLength, ranked.end(),
+                          [](const auto &a, const auto &b) { return a.first > b.first; });
+
+        QHash<QString, Follower> kept;
+        kept.reserve(MaxSequenceLength);
+        for (int i = 0; i < MaxSequenceLength; ++i) {
+            kept.insert(ranked.at(i).second, trigger.followers.value(ranked.at(i).second));
+        }
+        trigger.followers = kept;
+    }
+
+    // Drop the trigger seen longest ago, the startup trigger stays
+    if (m_model.size() > MaxTriggers) {
+        auto oldest = m_model.end();
+        for (auto it = m_model.begin(); it != m_model.end(); ++it) {
+            if (it.key() != STARTUP_TRIGGER && (oldest == m_model.end() || it->lastSeen < oldest->lastSeen)) {
+                oldest = it;
+            }
+        }
+        if (oldest != m_model.end()) {
+            m_model.erase(oldest);
+        }
+    }
+}
+
+QList<IconSequencePredictor::IconRequest> IconSequencePredictor::predict(const QString &triggerKey)
+{
+    const auto it = m_model.constFind(triggerKey);
+    if (it == m_model.constEnd() || it->sequences < MinObservations) {
+        return {};
+    }
+
+    const int minCount = qMax(1, qCeil(it->sequences * MinConfidence));
+    QList<const Follower *> likely;
+    for (const Follower &follower : it->followers) {
+        if (follower.count >= minCount) {
+            likely.append(&follower);
+        }
+    }
+    if (likely.isEmpty()) {
+        return {};
+    }
+
+    std::sort(likely.begin(), likely.end(), [](const Follower *a, const Follower *b) {
+        return a->count > b->count;
+    });
+    if (likely.size() > MaxSequenceLength) {
+        likely.resize(MaxSequenceLength);
+    }
+
+    QList<IconRequest> predictions;
+    predictions.reserve(likely.size());
+    for (const Follower *follower : std::as_const(likely)) {
+        const IconRequest &request = follower->request;
+        m_predicted.insert(requestKey(request.iconName, request.size, request.state));
+        predictions.append(request);
+    }
+
+    m_sequencePredicted = true;
+    m_stats.predictionsIssued++;
+    m_stats.predictedIcons += predictions.size();
+    return predictions;
+}
+
+IconSequencePredictor::Stats IconSequencePredictor::stats() const
+{
+    QMutexLocker locker(&m_mutex);
+    Stats stats = m_stats;
+    stats.triggerCount = m_model.size();
+    return stats;
+}
+
+void IconSequencePredictor::resetStats()
+{
+    QMutexLocker locker(&m_mutex);
+    m_stats = Stats();
+}
+
+void IconSequencePredictor::clearModel()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_model.clear();
+        m_predicted.clear();
+        m_stats = Stats();
+    }
+
+    QMutexLocker saveLocker(&m_saveMutex);
+    QFile::remove(m_modelFilePath);
+    qDebug() << "IconSequencePredictor: Model cleared";
+}
+
+void IconSequencePredictor::setEnabled(bool enabled)
+{
+    QMutexLocker locker(&m_mutex);
+    m_enabled = enabled;
+    qDebug() << "IconSequencePredictor" << (enabled ? "enabled" : "disabled");
+}
+
+bool IconSequencePredictor::isEnabled() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_enabled;
+}
+
+void IconSequencePredictor::saveModel()
+{
+    QHash<QString, Trigger> model;
+    {
+        QMutexLocker locker(&m_mutex);
+        model = m_model;
+    }
+    writeModel(model);
+}
+
+void IconSequencePredictor::saveModelLater()
+{
+    // Called with m_mutex held, the copy is cheap (implicitly shared)
+    const QHash<QString, Trigger> model = m_model;
+    QtConcurrent::run([this, model]() {
+        writeModel(model);
+    });
+}
+
+void IconSequencePredictor::writeModel(const QHash<QString, Trigger> &model)
+{
+    QJsonArray triggers;
+    for (auto it = model.begin(); it != model.end(); ++it) {
+        QJsonArray followers;
+        for (const Follower &follower : it->followers) {
+            QJsonObject followerObj;
+            followerObj[QStringLiteral("iconName")] = follower.request.iconName;
+            followerObj[QStringLiteral("width")] = follower.request.size.width();
+            followerObj[QStringLiteral("height")] = follower.request.size.height();
+            followerObj[QStringLiteral("state")] = follower.request.state;
+            followerObj[QStringLiteral("count")] = follower.count;
+            followers.append(followerObj);
+        }
+
+        QJsonObject triggerObj;
+        triggerObj[QStringLiteral("key")] = it.key();
+        triggerObj[QStringLiteral("sequences")] = it->sequences;
+        triggerObj[QStringLiteral("lastSeen")] = QJsonValue::fromVariant(it->lastSeen);
+        triggerObj[QStringLiteral("followers")] = followers;
+        triggers.append(triggerObj);
+    }
+
+    QJsonObject root;
+    root[QStringLiteral("triggers")] = triggers;
+    root[QStringLiteral("version")] = MODEL_VERSION;
+
+    QMutexLocker saveLocker(&m_saveMutex);
+
+    QFile file(m_modelFilePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "IconSequencePredictor: Failed to save model to" << m_modelFilePath;
+        return;
+    }
+    file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+    file.close();
+
+    qDebug() << "IconSequencePredictor: Saved" << model.size() << "triggers to disk";
+}
+
+void IconSequencePredictor::loadModel()
+{
+    QFile file(m_modelFilePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qDebug() << "IconSequencePredictor: No existing model, starting fresh";
+        return;
+    }
+
+    const QJsonDocument doc = QJsonDocument::fromJson(file.readAll());
+    file.close();
+
+    const QJsonObject root = doc.object();
+    if (!doc.isObject() || root[QStringLiteral("version")].toInt() != MODEL_VERSION) {
+        qWarning() << "IconSequencePredictor: Invalid or outdated model file, starting fresh";
+        return;
+    }
+
+    const QJsonArray triggers = root[QStringLiteral("triggers")].toArray();
+    for (const QJsonValue &value : triggers) {
+        const QJsonObject triggerObj = value.toObject();
+
+        Trigger trigger;
+        trigger.sequences = triggerObj[QStringLiteral("sequences")].toInt();
+        trigger.lastSeen = triggerObj[QStringLiteral("lastSeen")].toVariant().toLongLong();
+
+        const QJsonArray followers = triggerObj[QStringLiteral("followers")].toArray();
+        for (const QJsonValue &followerValue : followers) {
+            const QJsonObject followerObj = followerValue.toObject();
+
+            Follower follower;
+            follower.request.iconName = followerObj[QStringLiteral("iconName")].toString();
+            follower.request.size = QSize(followerObj[QStringLiteral("width")].toInt(),
+                                          followerObj[QStringLiteral("height")].toInt());
+            follower.request.state = followerObj[QStringLiteral("state")].toInt();
+            follower.count = followerObj[QStringLiteral("count")].toInt();
+            if (follower.request.iconName.isEmpty() || follower.count <= 0) {
+                continue;
+            }
+            trigger.followers.insert(requestKey(follower.request.iconName, follower.request.size,
+                                                follower.request.state), follower);
+        }
+
+        const QString key = triggerObj[QStringLiteral("key")].toString();
+        if (!key.isEmpty() && trigger.sequences > 0) {
+            m_model.insert(key, trigger);
+        }
+    }
+
+    qDebug() << "IconSequencePredictor: Loaded" << m_model.size() << "triggers from disk";
+}
@@ -0,0 +1,200 @@
+/* BEGIN_COMMON_COPYRIGHT_HEADER
+ * (c)LGPL2+
+ *
+ * LXQt - a lightweight, Qt based, desktop toolset
+ * https://lxqt.org
+ *
+ * Copyright: 2025 LXQt team
+ * Authors:
+ *   LXQt team
+ *
+ * This program or library is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ *
+ * END_COMMON_COPYRIGHT_HEADER */
+
+#ifndef ICONSEQUENCEPREDICTOR_H
+#define ICONSEQUENCEPREDICTOR_H
+
+#include <QObject>
+#include <QString>
+#include <QSize>
+#include <QHash>
+#include <QSet>
+#include <QList>
+#include <QMutex>
+#include <QElapsedTimer>
+
+/*!
+ * \brief Learns which icons follow each other and predicts them
+ *
+ * Views request their icons in bursts: opening an applications grid asks
+ * for the same 120 icons at 48px every time. The predictor splits the
+ * request stream into sequences at pauses longer than SequenceGapMs. The
+ * first request of a sequence is its trigger, the model counts for every
+ * trigger how often each (icon, size, state) followed it.
+ *
+ * When a new sequence starts with a known trigger, observe() returns the
+ * icons that followed it in at least MinConfidence of its sequences, most
+ * frequent first, for FastIconProvider to preload. The first sequence of
+ * a process is also learned under a startup trigger, see predictStartup().
+ *
+ * The model is persisted as icon-sequences.json next to IconUsageTracker's
+ * statistics. Accuracy (predicted icons that were requested) and coverage
+ * (requests that were predicted) are reported by stats().
+ *
+ * Usage:
+ * \code
+ * const auto predicted = IconSequencePredictor::instance()->observe("firefox", QSize(48, 48), 0);
+ * \endcode
+ */
+class IconSequencePredictor : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct IconRequest {
+        QString iconName;
+        QSize size;
+        int state = 0;
+    };
+
+    struct Stats {
+        int triggerCount = 0;                 ///< Triggers in the model
+        qint64 sequencesObserved = 0;         ///< Sequences learned from
+        qint64 predictionsIssued = 0;         ///< Sequences that got a prediction
+        qint64 predictedIcons = 0;            ///< Icons predicted in total
+        qint64 predictedHits = 0;             ///< Predicted icons that were requested
+        qint64 requestsInPredictedSequences = 0;
+
+        double accuracy() const
+        {
+            return predictedIcons > 0 ? double(predictedHits) / predictedIcons : 0.0;
+        }
+        double coverage() const
+        {
+            return requestsInPredictedSequences > 0
+                ? double(predictedHits) / requestsInPredictedSequences : 0.0;
+        }
+    };
+
+    // Pause that ends a sequence
+    static constexpr int SequenceGapMs = 400;
+    // Requests learned per sequence, and icons predicted at once
+    static constexpr int MaxSequenceLength = 256;
+    // Triggers kept in the model, the least recently seen are dropped
+    static constexpr int MaxTriggers = 256;
+    // Share of a trigger's sequences an icon must appear in to be predicted
+    static constexpr double MinConfidence = 0.5;
+    // Sequences a trigger must have started before it predicts
+    static constexpr int MinObservations = 2;
+
+    /*!
+     * \brief Get singleton instance
+     */
+    static IconSequencePredictor *instance();
+
+    /*!
+     * \brief Feed one request of the stream
+     * \return Icons to preload if this request starts a known sequence,
+     *         otherwise an empty list
+     *
+     * Thread-safe, called by FastIconProvider::requestImageResponse() on
+     * the QML pixmap reader thread for every request including cache hits.
+     * Sequences are learned lazily when the next one starts.
+     */
+    QList<IconRequest> observe(const QString &iconName, const QSize &size, int state);
+
+    /*!
+     * \brief Icons the first sequence of previous runs contained
+     *
+     * Counts as the prediction for the first sequence of this run.
+     */
+    QList<IconRequest> predictStartup();
+
+    Stats stats() const;
+    void resetStats();
+
+    /*!
+     * \brief Forget the learned model and delete the persisted file
+     */
+    void clearModel();
+
+    /*!
+     * \brief Write the model to disk now
+     */
+    void saveModel();
+
+    void setEnabled(bool enabled);
+    bool isEnabled() const;
+
+private:
+    explicit IconSequencePredictor(QObject *parent = nullptr);
+    ~IconSequencePredictor() override;
+
+    friend class tst_iconsequencepredictor;
+
+    IconSequencePredictor(const IconSequencePredictor &) = delete;
+    IconSequencePredictor &operator=(const IconSequencePredictor &) = delete;
+
+    struct Follower {
+        IconRequest request;
+        int count = 0;
+    };
+
+    struct Trigger {
+        int sequences = 0;
+        qint64 lastSeen = 0;
+        QHash<QString, Follower> followers;
+    };
+
+    static QString requestKey(const QString &iconName, const QSize &size, int state);
+
+    // All of these expect m_mutex to be held
+    void finishSequence();
+    void learn(const QString &triggerKey, const QList<IconRequest> &requests);
+    QList<IconRequest> predict(const QString &triggerKey);
+
+    /*!
+     * \brief Write a copy of the model from the global thread pool
+     */
+    void saveModelLater();
+    void writeModel(const QHash<QString, Trigger> &model);
+    void loadModel();
+
+    QString m_modelFilePath;
+    QHash<QString, Trigger> m_model;
+    Stats m_stats;
+    bool m_enabled = true;
+    int m_sequencesSinceSave = 0;
+
+    // The sequence being observed
+    QString m_triggerKey;
+    IconRequest m_triggerRequest;
+    QList<IconRequest> m_sequence;
+    QSet<QString> m_sequenceKeys;
+    QSet<QString> m_predicted;      ///< Predicted for this sequence, not requested yet
+    bool m_sequencePredicted = false;
+    bool m_startupSequence = true;
+    QElapsedTimer m_lastRequest;
+
+    mutable QMutex m_mutex;
+    QMutex m_saveMutex;              ///< One writer of the model file at a time
+
+    static IconSequencePredictor *s_instance;
+    static QMutex s_instanceMutex;
+};
+
+#endif // ICONSEQUENCEPREDICTOR_H
@@ -0,0 +1,52 @@
+/* BEGIN_COMMON_COPYRIGHT_HEADER
+ * (c)LGPL2+
+ *
+ * LXQt - a lightweight, Qt based, desktop toolset
+ * https://lxqt.org
+ *
+ * Copyright: 2025 LXQt team
+ * Authors:
+ *   LXQt team
+ *
+ * This program or library is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ *
+ * END_COMMON_COPYRIGHT_HEADER */
+
+#include "icontrace.h"
+
+#include <QThread>
+
+Q_LOGGING_CATEGORY(QtXdgIconTrace, "qtxdg.iconpipeline.trace", QtWarningMsg)
+
+qint64 IconTraceSpan::sinceFirstSpan()
+{
+    static const QElapsedTimer origin = [] {
+        QElapsedTimer timer;
+        timer.start();
+        return timer;
+    }();
+    return origin.nsecsElapsed();
+}
+
+void IconTraceSpan::finish()
+{
+    qCDebug(QtXdgIconTrace).nospace().noquote()
+        << "span=" << m_name
+        << " key=0x" << QString::number(m_key.toUInt64(), 16)
+        << " start=" << QString::number(m_start / 1000.0, 'f', 1) << "us"
+        << " dur=" << QString::number(m_timer.nsecsElapsed() / 1000.0, 'f', 1) << "us"
+        << " thread=" << QThread::currentThread();
+}
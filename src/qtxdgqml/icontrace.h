@@ -0,0 +1,101 @@
+/* BEGIN_COMMON_COPYRIGHT_HEADER
+ * (c)LGPL2+
+ *
+ * LXQt - a lightweight, Qt based, desktop toolset
+ * https://lxqt.org
+ *
+ * Copyright: 2025 LXQt team
+ * Authors:
+ *   LXQt team
+ *
+ * This program or library is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ *
+ * END_COMMON_COPYRIGHT_HEADER */
+
+#ifndef ICONTRACE_H
+#define ICONTRACE_H
+
+#include "iconcachekey.h"
+
+#include <QElapsedTimer>
+#include <QLoggingCategory>
+
+Q_DECLARE_LOGGING_CATEGORY(QtXdgIconTrace)
+
+/*!
+ * \brief Tracing span of one stage of the icon pipeline
+ *
+ * The stages of a FastIconProvider load, in order:
+ *
+ * - "l3.read": DiskIconCache reads the stored pixels (I/O stage)
+ * - "render": theme lookup and rasterizing on an L3 miss (CPU stage)
+ * - "l3.write": DiskIconCache stores a rendered icon (I/O stage, deferred)
+ * - "l2.publish": the image enters the L2 cache (loader thread)
+ * - "upload": CachedTextureFactory creates the texture (render thread)
+ *
+ * and, once on start, "l3.batch_read" for the entries FastIconProvider
+ * warms L2 with, logged with a null key.
+ *
+ * All of them pass the same implicitly shared QImage in
+ * CachedTextureFactory::UploadFormat along, nothing is converted or
+ * copied between the disk and the texture upload.
+ *
+ * Spans are written to the "qtxdg.iconpipeline.trace" logging category,
+ * off by default. Enable it with
+ * QT_LOGGING_RULES="qtxdg.iconpipeline.trace.debug=true"; every span is
+ * logged when it ends as
+ * \code
+ * span=render key=0x... start=1234.5us dur=812.0us
+ * \endcode
+ * with start relative to the first span of the process. When the category
+ * is disabled a span costs one flag check.
+ */
+class IconTraceSpan
+{
+public:
+    IconTraceSpan(const char *name, const IconCacheKey &key)
+        : m_name(name)
+        , m_key(key)
+        , m_enabled(QtXdgIconTrace().isDebugEnabled())
+    {
+        if (m_enabled) {
+            m_start = sinceFirstSpan();
+            m_timer.start();
+        }
+    }
+
+    ~IconTraceSpan()
+    {
+        if (m_enabled) {
+            finish();
+        }
+    }
+
+    IconTraceSpan(const IconTraceSpan &) = delete;
+    IconTraceSpan &operator=(const IconTraceSpan &) = delete;
+
+private:
+    static qint64 sinceFirstSpan();
+    void finish();
+
+    const char *m_name;
+    IconCacheKey m_key;
+    bool m_enabled;
+    qint64 m_start = 0;
+    QElapsedTimer m_timer;
+};
+
+#endif // ICONTRACE_H
@@ -33,12 +33,72 @@
 #include <QJsonObject>
 #include <QJsonArray>
 #include <QMutexLocker>
+#include <QCoreApplication>
+#include <QTimer>
 #include <QDebug>
 #include <algorithm>
+#include <array>
 
 // Auto-save threshold: save stats after every N accesses
 static const int AUTO_SAVE_THRESHOLD = 50;
 
+/*!
+ * \brief Single producer, single consumer ring of usage events
+ *
+ * The owning thread pushes, the drain thread (under m_drainMutex) consumes.
+ * head and tail only grow, their difference is the fill level.
+ */
+struct IconUsageTracker::EventBuffer
+{
+    static constexpr quint32 Capacity = 512;
+
+    struct Event {
+        QString iconName;
+        int size = 0;
+        int state = 0;
+        qint64 msecsSinceEpoch = 0;
+    };
+
+    bool push(Event &&event)
+    {
+        const quint32 head = m_head.loadRelaxed();
+        if (head - m_tail.loadAcquire() >= Capacity) {
+            return false;
+        }
+        m_events[head % Capacity] = std::move(event);
+        m_head.storeRelease(head + 1);
+        return true;
+    }
+
+    template<typename Function>
+    int consume(Function &&function)
+    {
+        quint32 tail = m_tail.loadRelaxed();
+        const quint32 head = m_head.loadAcquire();
+        const int count = head - tail;
+        for (; tail != head; ++tail) {
+            Event &event = m_events[tail % Capacity];
+            function(event);
+            // Release the string here, not on the producer's next lap
+            event.iconName = QString();
+        }
+        m_tail.storeRelease(tail);
+        return count;
+    }
+
+    bool isEmpty() const
+    {
+        return m_head.loadAcquire() == m_tail.loadAcquire();
+    }
+
+private:
+    std::array<Event, Capacity> m_events;
+    QAtomicInteger<quint32> m_head{0};
+    QAtomicInteger<quint32> m_tail{0};
+};
+
+thread_local std::shared_ptr<IconUsageTracker::EventBuffer> IconUsageTracker::s_threadBuffer;
+
 // Static members
 IconUsageTracker *IconUsageTracker::s_instance = nullptr;
 QMutex IconUsageTracker::s_instanceMutex;
@@ -56,12 +116,32 @@ IconUsageTracker* IconUsageTracker::instance()
 
 IconUsageTracker::IconUsageTracker(QObject *parent)
     : QObject(parent)
-    , m_enabled(true)
+    , m_enabled(1)
     , m_dirty(false)
 {
     initializeStatsFile();
     loadStats();
 
+    // Drain on a low priority thread of our own, the first caller of
+    // instance() may be a loader thread without an event loop
+    QTimer *drainTimer = new QTimer;
+    drainTimer->setInterval(DrainIntervalMs);
+    drainTimer->moveToThread(&m_drainThread);
+    connect(drainTimer, &QTimer::timeout, drainTimer, [this]() { drainAndAutoSave(); });
+    connect(&m_drainThread, &QThread::started, drainTimer, qOverload<>(&QTimer::start));
+    connect(&m_drainThread, &QThread::finished, drainTimer, &QObject::deleteLater);
+    m_drainThread.setObjectName(QStringLiteral("IconUsageTracker"));
+    m_drainThread.start(QThread::LowestPriority);
+
+    // The singleton is never deleted, persist what was recorded on exit
+    if (QCoreApplication *app = QCoreApplication::instance()) {
+        connect(app, &QCoreApplication::aboutToQuit, this, [this]() {
+            m_drainThread.quit();
+            m_drainThread.wait();
+            saveStats();
+        }, Qt::DirectConnection);
+    }
+
     qDebug() << "IconUsageTracker initialized:"
              << "stats_file=" << m_statsFilePath
              << "tracked_icons=" << m_usageStats.size();
@@ -69,9 +149,9 @@ IconUsageTracker::IconUsageTracker(QObject *parent)
 
 IconUsageTracker::~IconUsageTracker()
 {
-    if (m_dirty) {
-        saveStats();
-    }
+    m_drainThread.quit();
+    m_drainThread.wait();
+    saveStats();
 }
 
 void IconUsageTracker::initializeStatsFile()
@@ -90,7 +170,7 @@ void IconUsageTracker::initializeStatsFile()
     if (!dir.exists(cacheDir)) {
         if (!dir.mkpath(cacheDir)) {
             qWarning() << "IconUsageTracker: Failed to create stats directory:" << cacheDir;
-            m_enabled = false;
+            m_enabled.storeRelaxed(0);
         }
     }
 }
@@ -104,43 +184,110 @@ QString IconUsageTracker::generateKey(const QString &iconName, int size, int sta
         .arg(state);
 }
 
+IconUsageTracker::EventBuffer *IconUsageTracker::threadBuffer()
+{
+    if (!s_threadBuffer) {
+        s_threadBuffer = std::make_shared<EventBuffer>();
+
+        QMutexLocker locker(&m_buffersMutex);
+        m_buffers.append(s_threadBuffer);
+    }
+    return s_threadBuffer.get();
+}
+
 void IconUsageTracker::recordAccess(const QString &iconName, int size, int state)
 {
-    if (!m_enabled || iconName.isEmpty()) {
+    if (!m_enabled.loadRelaxed() || iconName.isEmpty()) {
         return;
     }
 
+    EventBuffer::Event event;
+    event.iconName = iconName;
+    event.size = size;
+    event.state = state;
+    event.msecsSinceEpoch = QDateTime::currentMSecsSinceEpoch();
+
+    // Stats are best effort, never wait for the drain thread
+    if (!threadBuffer()->push(std::move(event))) {
+        m_droppedEvents.fetchAndAddRelaxed(1);
+    }
+}
+
+int IconUsageTracker::drainEvents()
+{
+    QMutexLocker drainLocker(&m_drainMutex);
+
+    QList<std::shared_ptr<EventBuffer>> buffers;
+    {
+        QMutexLocker locker(&m_buffersMutex);
+        // Buffers of finished threads are only referenced by the list
+        m_buffers.removeIf([](const std::shared_ptr<EventBuffer> &buffer) {
+            return buffer.use_count() == 1 && buffer->isEmpty();
+        });
+        buffers = m_buffers;
+    }
+
     QMutexLocker locker(&m_mutex);
 
-    QString key = generateKey(iconName, size, state);
-    QDateTime now = QDateTime::currentDateTime();
+    int applied = 0;
+    for (const std::shared_ptr<EventBuffer> &buffer : std::as_const(buffers)) {
+        applied += buffer->consume([this](const EventBuffer::Event &event) {
+            const QString key = generateKey(event.iconName, event.size, event.state);
+            const QDateTime when = QDateTime::fromMSecsSinceEpoch(event.msecsSinceEpoch);
+
+            auto it = m_usageStats.find(key);
+            if (it != m_usageStats.end()) {
+                // Existing entry - update
+                it->accessCount++;
+                it->lastAccessed = when;
+            } else {
+                // New entry - create
+                UsageEntry entry;
+                entry.iconName = event.iconName;
+                entry.size = event.size;
+                entry.accessCount = 1;
+                entry.lastAccessed = when;
+                entry.firstAccessed = when;
+                m_usageStats[key] = entry;
+            }
+        });
+    }
 
-    auto it = m_usageStats.find(key);
-    if (it != m_usageStats.end()) {
-        // Existing entry - update
-        it->accessCount++;
-        it->lastAccessed = now;
-    } else {
-        // New entry - create
-        UsageEntry entry;
-        entry.iconName = iconName;
-        entry.size = size;
-        entry.accessCount = 1;
-        entry.lastAccessed = now;
-        entry.firstAccessed = now;
-        m_usageStats[key] = entry;
+    if (applied > 0) {
+        m_dirty = true;
+        m_unsavedAccesses += applied;
     }
+    return applied;
+}
 
-    m_dirty = true;
+void IconUsageTracker::drainAndAutoSave()
+{
+    drainEvents();
 
     // Auto-save every N accesses to avoid losing data
-    static int accessCounter = 0;
-    if (++accessCounter >= AUTO_SAVE_THRESHOLD) {
+    bool save = false;
+    {
+        QMutexLocker locker(&m_drainMutex);
+        if (m_unsavedAccesses >= AUTO_SAVE_THRESHOLD) {
+            m_unsavedAccesses = 0;
+            save = true;
+        }
+    }
+    if (save) {
         saveStats();
-        accessCounter = 0;
     }
 }
 
+void IconUsageTracker::flush()
+{
+    drainEvents();
+}
+
+qint64 IconUsageTracker::droppedEventCount() const
+{
+    return m_droppedEvents.loadRelaxed();
+}
+
 QStringList IconUsageTracker::getTopUsed(int count) const
 {
     QMutexLocker locker(&m_mutex);
@@ -217,12 +364,15 @@ qint64 IconUsageTracker::getTotalAccessCount() const
 
 void IconUsageTracker::clearStats()
 {
-    QMutexLocker locker(&m_mutex);
-
     qDebug() << "IconUsageTracker: Clearing stats...";
 
-    m_usageStats.clear();
-    m_dirty = true;
+    // Queued accesses belong to the stats being cleared
+    drainEvents();
+    {
+        QMutexLocker locker(&m_mutex);
+        m_usageStats.clear();
+        m_dirty = true;
+    }
     saveStats();
 
     qDebug() << "IconUsageTracker: Stats cleared";
@@ -230,15 +380,13 @@ void IconUsageTracker::clearStats()
 
 void IconUsageTracker::setEnabled(bool enabled)
 {
-    QMutexLocker locker(&m_mutex);
-    m_enabled = enabled;
+    m_enabled.storeRelaxed(enabled ? 1 : 0);
     qDebug() << "IconUsageTracker" << (enabled ? "enabled" : "disabled");
 }
 
 bool IconUsageTracker::isEnabled() const
 {
-    QMutexLocker locker(&m_mutex);
-    return m_enabled;
+    return m_enabled.loadRelaxed() != 0;
 }
 
 void IconUsageTracker::loadStats()
@@ -294,12 +442,28 @@ void IconUsageTracker::loadStats()
 
 void IconUsageTracker::saveStats()
 {
-    if (!m_dirty) {
-        return;  // No changes to save
+    drainEvents();
+
+    QMutexLocker saveLocker(&m_saveMutex);
+
+    // Serialize a copy, recording and queries go on meanwhile
+    QHash<QString, UsageEntry> stats;
+    {
+        QMutexLocker locker(&m_mutex);
+        if (!m_dirty) {
+            return;  // No changes to save
+        }
+        stats = m_usageStats;
+        m_dirty = false;
     }
 
+    writeStats(stats);
+}
+
+void IconUsageTracker::writeStats(const QHash<QString, UsageEntry> &stats)
+{
     QJsonArray entries;
-    for (auto it = m_usageStats.begin(); it != m_usageStats.end(); ++it) {
+    for (auto it = stats.begin(); it != stats.end(); ++it) {
         const UsageEntry &entry = it.value();
 
         QJsonObject entryObj;
@@ -322,13 +486,13 @@ void IconUsageTracker::saveStats()
     QFile file(m_statsFilePath);
     if (!file.open(QIODevice::WriteOnly)) {
         qWarning() << "IconUsageTracker: Failed to save stats to" << m_statsFilePath;
+        QMutexLocker locker(&m_mutex);
+        m_dirty = true;
         return;
     }
 
     file.write(doc.toJson());
     file.close();
 
-    m_dirty = false;
-
-    qDebug() << "IconUsageTracker: Saved" << m_usageStats.size() << "usage entries to disk";
+    qDebug() << "IconUsageTracker: Saved" << stats.size() << "usage entries to disk";
 }
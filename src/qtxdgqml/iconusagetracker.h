@@ -34,6 +34,10 @@
 #include <QDateTime>
 #include <QMutex>
 #include <QStringList>
+#include <QAtomicInt>
+#include <QThread>
+
+#include <memory>
 
 /*!
  * \brief Tracks icon usage statistics for smart preloading
@@ -51,6 +55,12 @@
  * - Persistent statistics (JSON format)
  * - Thread-safe operations
  *
+ * recordAccess() is called from the icon loader threads and never blocks:
+ * every thread appends to its own lock-free event buffer and a low
+ * priority background thread drains the buffers into the statistics every
+ * DrainIntervalMs and writes the stats file. Queries therefore lag
+ * recording by up to one drain interval.
+ *
  * Usage:
  * \code
  * // Record icon access
@@ -95,7 +105,9 @@ public:
      * \param size Requested size (e.g., 32)
      * \param state Icon state (0=Normal, 1=Disabled, 2=Active, etc.)
      *
-     * Thread-safe. Updates access count and last access time.
+     * Thread-safe and lock-free. The access is queued in the calling
+     * thread's event buffer and applied by the drain thread, events are
+     * dropped if the buffer is full.
      */
     void recordAccess(const QString &iconName, int size = 32, int state = 0);
 
@@ -154,10 +166,23 @@ public:
     /*!
      * \brief Save statistics to disk
      *
-     * Normally called automatically, but can be called manually for explicit persistence.
+     * Normally called automatically by the drain thread, but can be called
+     * manually for explicit persistence. Applies pending events first.
      */
     void saveStats();
 
+    /*!
+     * \brief Apply all queued accesses to the statistics now
+     */
+    void flush();
+
+    /*!
+     * \brief Number of accesses dropped because an event buffer was full
+     */
+    qint64 droppedEventCount() const;
+
+    static constexpr int DrainIntervalMs = 1000;
+
 private:
     explicit IconUsageTracker(QObject *parent = nullptr);
     ~IconUsageTracker();
@@ -185,6 +210,28 @@ private:
      */
     void loadStats();
 
+    /*!
+     * \brief Move queued events into m_usageStats, returns the number applied
+     */
+    int drainEvents();
+
+    /*!
+     * \brief Periodic work of the drain thread
+     */
+    void drainAndAutoSave();
+
+    /*!
+     * \brief Serialize \a stats to the stats file, called without m_mutex held
+     */
+    void writeStats(const QHash<QString, UsageEntry> &stats);
+
+    struct EventBuffer;
+
+    /*!
+     * \brief The calling thread's event buffer, registered on first use
+     */
+    EventBuffer *threadBuffer();
+
     // Static singleton members
     static IconUsageTracker *s_instance;
     static QMutex s_instanceMutex;
@@ -192,9 +239,22 @@ private:
     // Instance data
     QString m_statsFilePath;                    ///< Path to JSON stats file
     QHash<QString, UsageEntry> m_usageStats;    ///< Usage statistics map
-    mutable QMutex m_mutex;                     ///< Thread safety mutex
-    bool m_enabled;                             ///< Whether tracking is enabled
+    mutable QMutex m_mutex;                     ///< Guards m_usageStats and m_dirty
+    QAtomicInt m_enabled;                       ///< Whether tracking is enabled
     bool m_dirty;                               ///< Whether stats need saving
+
+    // Keeps the buffer alive while its thread runs, m_buffers keeps it
+    // alive until it has been drained
+    static thread_local std::shared_ptr<EventBuffer> s_threadBuffer;
+
+    // Per-thread event buffers, appended to once per thread
+    QList<std::shared_ptr<EventBuffer>> m_buffers;
+    QMutex m_buffersMutex;
+    QMutex m_drainMutex;                        ///< One consumer at a time
+    QMutex m_saveMutex;                         ///< One writer of the stats file at a time
+    int m_unsavedAccesses = 0;                  ///< Guarded by m_drainMutex
+    QAtomicInteger<qint64> m_droppedEvents{0};
+    QThread m_drainThread;
 };
 
 #endif // ICONUSAGETRACKER_H
@@ -0,0 +1,1716 @@
+/* BEGIN_COMMON_COPYRIGHT_HEADER
+ * (c)LGPL2+
+ *
+ * LXQt - a lightweight, Qt based, desktop toolset
+ * https://lxqt.org
+ *
+ * Copyright: 2025 LXQt team
+ * Authors:
+ *   LXQt team
+ *
+ * This program or library is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ *
+ * END_COMMON_COPYRIGHT_HEADER */
+
+#include "packediconstore.h"
+#include "cachedtexturefactory.h"
+
+#include <QAtomicInteger>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QDebug>
+
+#ifdef QTXDG_HAVE_LZ4
+#include <lz4.h>
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char INDEX_MAGIC[4] = { 'Q', 'X', 'I', 'I' };
+constexpr quint32 INDEX_VERSION = 3;
+constexpr quint32 INITIAL_SLOT_COUNT = 4096;
+
+// Grow the table beyond this share of used (live or deleted) slots
+constexpr double MAX_LOAD_FACTOR = 0.7;
+
+// "QXR3", records of older layouts (without a source) fail validation
+constexpr quint32 RECORD_MAGIC = 0x51585233;
+constexpr quint32 RECORD_ALIGNMENT = 16;
+
+// Icons are small, anything beyond this is a corrupt record
+constexpr quint32 MAX_DIMENSION = 4096;
+
+// Longer source directories are not recorded
+constexpr quint32 MAX_SOURCE_SIZE = 4096;
+
+enum JournalOp : quint16 {
+    JournalPut = 0x5032,        // "P2"
+    JournalRemove = 0x5232,     // "R2"
+    JournalTouch = 0x5432,      // "T2", access time of one record
+    JournalNamespace = 0x4e32,  // "N2", namespace activated
+    JournalGeneration = 0x4732  // "G2", generation in the id field
+};
+
+enum SlotState : quint32 {
+    SlotEmpty = 0,
+    SlotLive = 1,
+    SlotDeleted = 2
+};
+
+enum SlotFlag : quint32 {
+    SlotReferenced = 0x1    // Hit since the clock hand last passed
+};
+
+// The namespace tag lives in the upper half of IndexSlot::flags
+constexpr int NAMESPACE_SHIFT = 16;
+
+// Unique across stores, DiskIconCache may replace its store while writes
+// reserved in the old one are in flight
+QAtomicInteger<quint64> lastEpoch(0);
+
+quint32 secondsSinceEpoch()
+{
+    return quint32(QDateTime::currentSecsSinceEpoch());
+}
+
+// CRC over a journal record, its checksum field (bytes 4 - 7) counted as zero
+quint32 journalChecksum(const char *record, qsizetype size)
+{
+    QByteArray copy(record, size);
+    memset(copy.data() + 4, 0, 4);
+    return qChecksum(copy);
+}
+
+quint32 alignedLength(quint32 length)
+{
+    return (length + RECORD_ALIGNMENT - 1) & ~(RECORD_ALIGNMENT - 1);
+}
+
+} // namespace
+
+struct PackedIconStore::IndexHeader {
+    char magic[4];
+    quint32 version;
+    quint32 slotCount;      // Power of two
+    quint32 liveCount;
+    quint32 deletedCount;
+    quint32 reserved0;
+    quint64 liveBytes;
+    quint64 deadBytes;
+    quint16 namespaces[PackedIconStore::MaxNamespaces];   // Retained, most recent first
+    quint32 generation;
+    quint8 reserved[12];
+};
+
+struct PackedIconStore::IndexSlot {
+    quint64 id;
+    quint32 segment;
+    quint32 offset;
+    quint32 length;
+    quint32 lastAccessed;
+    quint32 state;
+    quint32 flags;          // SlotFlag bits, namespace tag above NAMESPACE_SHIFT
+};
+
+struct PackedIconStore::RecordHeader {
+    quint32 magic;
+    quint32 codec;
+    quint64 id;
+    quint32 width;
+    quint32 height;
+    quint32 payloadSize;    // Bytes following the header, rows are width * 4 bytes
+    quint32 dprThousandths;
+    quint32 sourceSize;     // Bytes of the source directory following the payload
+    quint32 reserved;
+    qint64 sourceModified;
+};
+
+struct PackedIconStore::JournalRecord {
+    quint16 op;
+    quint16 ns;             // Namespace tag of a put or activation
+    quint32 checksum;       // Over the record with this field zeroed
+    quint64 id;
+    quint32 segment;
+    quint32 offset;
+    quint32 length;
+    quint32 lastAccessed;
+};
+
+struct PackedIconStore::SegmentMapping {
+    QFile file;
+    uchar *data = nullptr;
+    qint64 size = 0;
+
+    ~SegmentMapping()
+    {
+        if (data) {
+            file.unmap(data);
+        }
+    }
+};
+
+static void releaseSegmentMapping(void *info)
+{
+    delete static_cast<std::shared_ptr<void> *>(info);
+}
+
+/*!
+ * Serializes changes to a shared store across processes. The outermost
+ * lock applies the records other processes appended meanwhile and writes
+ * our buffered ones before unlocking. A no-op for private stores, they
+ * hold the lock from open() to close().
+ */
+class PackedIconStore::WriteLock
+{
+public:
+    explicit WriteLock(PackedIconStore *store, bool catchUp = true)
+        : m_store(store)
+    {
+        if (!m_store->m_shared || m_store->m_lockDepth++ > 0) {
+            return;
+        }
+        while (::flock(m_store->m_lockFile.handle(), LOCK_EX) != 0 && errno == EINTR) {
+        }
+        if (catchUp) {
+            m_store->catchUp();
+        }
+    }
+
+    ~WriteLock()
+    {
+        if (!m_store->m_shared || --m_store->m_lockDepth > 0) {
+            return;
+        }
+        m_store->writeJournal();
+        ::flock(m_store->m_lockFile.handle(), LOCK_UN);
+    }
+
+    WriteLock(const WriteLock &) = delete;
+    WriteLock &operator=(const WriteLock &) = delete;
+
+private:
+    PackedIconStore *m_store;
+};
+
+PackedIconStore::PackedIconStore(const QString &directory, bool shared)
+    : m_directory(directory)
+    , m_shared(shared)
+{
+    static_assert(sizeof(IndexHeader) == 64, "IndexHeader must not be padded");
+    static_assert(sizeof(IndexSlot) == 32, "IndexSlot must not be padded");
+    static_assert(sizeof(RecordHeader) == 48, "RecordHeader must not be padded");
+    static_assert(sizeof(JournalRecord) == 32, "JournalRecord must not be padded");
+}
+
+PackedIconStore::~PackedIconStore()
+{
+    close();
+}
+
+QString PackedIconStore::indexPath() const
+{
+    return m_directory + QLatin1String("/index.bin");
+}
+
+QString PackedIconStore::journalPath() const
+{
+    return m_directory + QLatin1String("/index.journal");
+}
+
+QString PackedIconStore::segmentPath(quint32 segment) const
+{
+    return m_directory + QStringLiteral("/data-%1.seg").arg(segment, 8, 16, QLatin1Char('0'));
+}
+
+bool PackedIconStore::open()
+{
+    if (!m_lockFile.isOpen()) {
+        m_lockFile.setFileName(m_directory + QLatin1String("/lock"));
+        if (!m_lockFile.open(QIODevice::ReadWrite)) {
+            qWarning() << "PackedIconStore: failed to open lock file" << m_lockFile.fileName();
+            release();
+            return false;
+        }
+    }
+
+    // A private store is never locked per change, it must be the only one
+    // using the directory. Another instance of the application keeps the
+    // lock until it closes the store, this one runs without.
+    if (!m_shared) {
+        int locked;
+        while ((locked = ::flock(m_lockFile.handle(), LOCK_EX | LOCK_NB)) != 0 && errno == EINTR) {
+        }
+        if (locked != 0) {
+            qWarning() << "PackedIconStore: store in use by another process" << m_directory;
+            release();
+            m_lockFile.close();
+            return false;
+        }
+    }
+
+    // Other processes must not append while the journal is replayed
+    WriteLock lock(this, false);
+    return load();
+}
+
+bool PackedIconStore::load()
+{
+    release();
+
+    scanSegments();
+
+    // A missing snapshot is fine, the journal alone rebuilds the table
+    if (!loadIndex()) {
+        setIndex(emptyIndex(INITIAL_SLOT_COUNT));
+    }
+
+    replayJournal();
+    validateSlots();
+
+    // Shared stores also read what other processes append
+    m_journalFile.setFileName(journalPath());
+    if (!m_journalFile.open((m_shared ? QIODevice::ReadWrite : QIODevice::WriteOnly) | QIODevice::Append)) {
+        qWarning() << "PackedIconStore: failed to open journal" << journalPath();
+        release();
+        return false;
+    }
+    m_journalOffset = m_journalFile.size();
+
+    m_activeSegment = m_segments.isEmpty() ? 0 : m_segments.lastKey();
+
+    checkpointIfNeeded();
+    return true;
+}
+
+void PackedIconStore::close()
+{
+    // The journal of a shared store is checkpointed once it is long, not
+    // whenever a process exits and makes all others reload
+    if (isOpen()) {
+        if (m_shared) {
+            flush();
+        } else {
+            checkpoint();
+        }
+    }
+    release();
+
+    // Unlocks a private store for the next process
+    m_lockFile.close();
+}
+
+void PackedIconStore::release()
+{
+    // Reservations made before this point are ignored by commit()
+    m_epoch = lastEpoch.fetchAndAddRelaxed(1) + 1;
+    m_activeFile.reset();
+    m_segments.clear();
+    m_journalFile.close();
+    m_journalBuffer.clear();
+    m_journalRecords = 0;
+    m_journalOffset = 0;
+    m_clockHand = 0;
+    m_reclaimCursor = 0;
+    m_reclaimPending = false;
+    m_compacting = false;
+    m_index.clear();
+    m_indexData = nullptr;
+    m_header = nullptr;
+}
+
+void PackedIconStore::setIndex(const QByteArray &index)
+{
+    m_index = index;
+    m_indexData = reinterpret_cast<uchar *>(m_index.data());
+    m_header = reinterpret_cast<IndexHeader *>(m_indexData);
+}
+
+QByteArray PackedIconStore::emptyIndex(quint32 slotCount)
+{
+    QByteArray index(sizeof(IndexHeader) + qsizetype(slotCount) * sizeof(IndexSlot), '\0');
+    IndexHeader *header = reinterpret_cast<IndexHeader *>(index.data());
+    memcpy(header->magic, INDEX_MAGIC, sizeof(header->magic));
+    header->version = INDEX_VERSION;
+    header->slotCount = slotCount;
+    return index;
+}
+
+bool PackedIconStore::loadIndex()
+{
+    QFile file(indexPath());
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    // One read, the snapshot is the in-memory table as is
+    const QByteArray index = file.readAll();
+    if (index.size() < qsizetype(sizeof(IndexHeader))) {
+        qWarning() << "PackedIconStore: truncated snapshot, rebuilding from the journal";
+        return false;
+    }
+
+    const IndexHeader *header = reinterpret_cast<const IndexHeader *>(index.constData());
+    const quint32 slotCount = header->slotCount;
+    if (memcmp(header->magic, INDEX_MAGIC, sizeof(header->magic)) != 0
+        || header->version != INDEX_VERSION
+        || slotCount == 0 || (slotCount & (slotCount - 1)) != 0
+        || index.size() != qsizetype(sizeof(IndexHeader)) + qsizetype(slotCount) * qsizetype(sizeof(IndexSlot))) {
+        qWarning() << "PackedIconStore: unusable snapshot, rebuilding from the journal";
+        return false;
+    }
+
+    setIndex(index);
+    return true;
+}
+
+void PackedIconStore::scanSegments()
+{
+    // One stat per segment, records are never looked at here
+    const QStringList segmentFiles = QDir(m_directory).entryList(
+        QStringList() << QStringLiteral("data-*.seg"), QDir::Files, QDir::Name);
+    for (const QString &fileName : segmentFiles) {
+        bool ok = false;
+        const quint32 number = fileName.mid(5, 8).toUInt(&ok, 16);
+        if (ok) {
+            Segment &segment = m_segments[number];
+            segment.size = QFileInfo(m_directory + u'/' + fileName).size();
+            segment.committed = segment.size;
+        }
+    }
+}
+
+void PackedIconStore::replayJournal()
+{
+    QFile file(journalPath());
+    if (!file.open(QIODevice::ReadWrite)) {
+        return;
+    }
+
+    const QByteArray data = file.readAll();
+    int replayed = 0;
+    const qsizetype valid = applyJournal(data, false, &replayed);
+
+    if (valid != data.size()) {
+        qWarning() << "PackedIconStore: dropping" << (data.size() - valid) << "bytes of torn journal";
+        file.resize(valid);
+    }
+
+    m_journalRecords = replayed;
+    if (replayed > 0) {
+        qDebug() << "PackedIconStore: replayed" << replayed << "journal records";
+    }
+}
+
+qsizetype PackedIconStore::applyJournal(const QByteArray &data, bool noteSegments, int *applied)
+{
+    qsizetype valid = 0;
+    int count = 0;
+
+    while (valid + qsizetype(sizeof(JournalRecord)) <= data.size()) {
+        const char *raw = data.constData() + valid;
+        JournalRecord record;
+        memcpy(&record, raw, sizeof(record));
+
+        // A torn tail from a crash (or a record still being appended) ends it
+        if (record.checksum != journalChecksum(raw, sizeof(record))) {
+            break;
+        }
+
+        // Records are absolute, replaying one twice is harmless
+        bool known = true;
+        switch (record.op) {
+        case JournalPut:
+            if (noteSegments) {
+                // Another process wrote the bytes before journaling them
+                const qint64 end = qint64(record.offset) + record.length;
+                Segment &segment = m_segments[record.segment];
+                segment.size = qMax(segment.size, end);
+                segment.committed = qMax(segment.committed, end);
+            }
+            applyPut(record.id, record.segment, record.offset, record.length, record.lastAccessed, record.ns);
+            break;
+        case JournalRemove:
+            applyRemove(record.id);
+            break;
+        case JournalTouch:
+            applyTouch(record.id, record.segment, record.offset, record.lastAccessed);
+            break;
+        case JournalNamespace:
+            applyNamespace(record.ns);
+            break;
+        case JournalGeneration:
+            m_header->generation = quint32(record.id);
+            break;
+        default:
+            known = false;
+            break;
+        }
+        if (!known) {
+            break;
+        }
+
+        valid += sizeof(JournalRecord);
+        count++;
+    }
+
+    *applied = count;
+    return valid;
+}
+
+bool PackedIconStore::catchUp()
+{
+    if (!m_shared || !isOpen()) {
+        return false;
+    }
+
+    if (journalReplaced()) {
+        // Checkpointed or cleared by another process, its snapshot covers
+        // the old journal. Loading drops torn tails, that needs the lock.
+        if (m_lockDepth == 0) {
+            WriteLock lock(this);
+            return true;
+        }
+        qDebug() << "PackedIconStore: journal replaced by another process, reloading";
+        return load();
+    }
+    return readJournalTail();
+}
+
+bool PackedIconStore::journalReplaced() const
+{
+    struct stat opened;
+    struct stat current;
+    if (::fstat(m_journalFile.handle(), &opened) != 0
+        || ::stat(QFile::encodeName(journalPath()).constData(), &current) != 0) {
+        return true;
+    }
+    return opened.st_ino != current.st_ino || opened.st_dev != current.st_dev;
+}
+
+bool PackedIconStore::readJournalTail()
+{
+    const qint64 size = m_journalFile.size();
+    if (size <= m_journalOffset) {
+        return false;
+    }
+
+    QByteArray data(size - m_journalOffset, Qt::Uninitialized);
+    const ssize_t bytesRead = ::pread(m_journalFile.handle(), data.data(), size_t(data.size()),
+                                      off_t(m_journalOffset));
+    if (bytesRead <= 0) {
+        return false;
+    }
+    data.resize(bytesRead);
+
+    int applied = 0;
+    const qsizetype valid = applyJournal(data, true, &applied);
+    m_journalOffset += valid;
+    m_journalRecords += applied;
+
+    // With the lock nobody is appending, an invalid tail is left by a
+    // writer that died. Without it the tail may still be being written.
+    if (valid != data.size() && m_lockDepth > 0) {
+        qWarning() << "PackedIconStore: dropping" << (data.size() - valid) << "bytes of torn journal";
+        m_journalFile.resize(m_journalOffset);
+    }
+    return applied > 0;
+}
+
+void PackedIconStore::validateSlots()
+{
+    for (Segment &segment : m_segments) {
+        segment.liveBytes = 0;
+    }
+
+    m_header->liveCount = 0;
+    m_header->deletedCount = 0;
+    m_header->liveBytes = 0;
+
+    // Drop slots whose record went missing, recount everything else
+    IndexSlot *table = slots();
+    for (quint32 i = 0; i < m_header->slotCount; ++i) {
+        IndexSlot &slot = table[i];
+        if (slot.state == SlotDeleted) {
+            m_header->deletedCount++;
+            continue;
+        }
+        if (slot.state != SlotLive) {
+            continue;
+        }
+
+        // Too short for a record header, imageAt() would read past it
+        const auto segment = m_segments.find(slot.segment);
+        if (segment == m_segments.end() || slot.length < sizeof(RecordHeader)
+            || qint64(slot.offset) + slot.length > segment->size) {
+            slot.state = SlotDeleted;
+            m_header->deletedCount++;
+            continue;
+        }
+
+        segment->liveBytes += slot.length;
+        m_header->liveCount++;
+        m_header->liveBytes += slot.length;
+
+        if (!isNamespaceRetained(quint16(slot.flags >> NAMESPACE_SHIFT))) {
+            m_reclaimPending = true;
+        }
+    }
+
+    // Bytes of segments not accounted for by live records are dead
+    qint64 total = 0;
+    for (const Segment &segment : std::as_const(m_segments)) {
+        total += segment.size;
+    }
+    m_header->deadBytes = quint64(qMax<qint64>(0, total - qint64(m_header->liveBytes)));
+}
+
+void PackedIconStore::flush()
+{
+    // Shared stores append under the lock, behind the records of others
+    WriteLock lock(this);
+    writeJournal();
+}
+
+void PackedIconStore::writeJournal()
+{
+    if (m_journalBuffer.isEmpty() || !m_journalFile.isOpen()) {
+        return;
+    }
+
+    const qint64 written = m_journalFile.write(m_journalBuffer);
+    if (written != m_journalBuffer.size()) {
+        qWarning() << "PackedIconStore: failed to write journal" << journalPath();
+    }
+    m_journalFile.flush();
+    m_journalOffset += qMax<qint64>(0, written);
+    m_journalBuffer.clear();
+}
+
+bool PackedIconStore::checkpoint()
+{
+    if (!isOpen()) {
+        return false;
+    }
+
+    WriteLock lock(this);
+    if (!isOpen()) {
+        return false;
+    }
+
+    // Without a checkpoint the journal still covers everything
+    writeJournal();
+
+    QSaveFile file(indexPath());
+    if (!file.open(QIODevice::WriteOnly)
+        || file.write(m_index) != m_index.size()
+        || !file.commit()) {
+        qWarning() << "PackedIconStore: failed to write snapshot" << indexPath();
+        return false;
+    }
+
+    // A crash before this point replays records already in the snapshot
+    if (m_shared) {
+        // Other processes keep the old journal open, a new file tells them
+        // to reload the snapshot
+        QSaveFile journal(journalPath());
+        if (!journal.open(QIODevice::WriteOnly) || !journal.commit()) {
+            qWarning() << "PackedIconStore: failed to replace journal" << journalPath();
+            return false;
+        }
+        m_journalFile.close();
+        if (!m_journalFile.open(QIODevice::ReadWrite | QIODevice::Append)) {
+            qWarning() << "PackedIconStore: failed to open journal" << journalPath();
+        }
+    } else {
+        m_journalFile.resize(0);
+    }
+    m_journalOffset = 0;
+    m_journalRecords = 0;
+    return true;
+}
+
+void PackedIconStore::checkpointIfNeeded()
+{
+    if (m_journalRecords >= CheckpointRecords) {
+        checkpoint();
+    }
+}
+
+void PackedIconStore::journal(quint64 id, const IndexSlot *slot)
+{
+    JournalRecord record;
+    memset(&record, 0, sizeof(record));
+    record.id = id;
+    if (slot && slot->state == SlotLive) {
+        record.op = JournalPut;
+        record.ns = quint16(slot->flags >> NAMESPACE_SHIFT);
+        record.segment = slot->segment;
+        record.offset = slot->offset;
+        record.length = slot->length;
+        record.lastAccessed = slot->lastAccessed;
+    } else {
+        record.op = JournalRemove;
+    }
+    appendJournal(&record);
+}
+
+void PackedIconStore::journalTouch(const IndexSlot *slot)
+{
+    // Unlike a put it can't resurrect a record replaced by another process
+    JournalRecord record;
+    memset(&record, 0, sizeof(record));
+    record.op = JournalTouch;
+    record.id = slot->id;
+    record.segment = slot->segment;
+    record.offset = slot->offset;
+    record.lastAccessed = slot->lastAccessed;
+    appendJournal(&record);
+}
+
+void PackedIconStore::journalNamespace(quint16 tag)
+{
+    JournalRecord record;
+    memset(&record, 0, sizeof(record));
+    record.op = JournalNamespace;
+    record.ns = tag;
+    appendJournal(&record);
+}
+
+void PackedIconStore::journalGeneration(quint32 generation)
+{
+    JournalRecord record;
+    memset(&record, 0, sizeof(record));
+    record.op = JournalGeneration;
+    record.id = generation;
+    appendJournal(&record);
+}
+
+void PackedIconStore::appendJournal(JournalRecord *record)
+{
+    record->checksum = journalChecksum(reinterpret_cast<const char *>(record), sizeof(*record));
+
+    m_journalBuffer.append(reinterpret_cast<const char *>(record), sizeof(*record));
+    m_journalRecords++;
+
+    if (m_journalBuffer.size() >= JournalFlushBytes) {
+        flush();
+    }
+}
+
+PackedIconStore::IndexSlot *PackedIconStore::slots() const
+{
+    return reinterpret_cast<IndexSlot *>(m_indexData + sizeof(IndexHeader));
+}
+
+PackedIconStore::IndexSlot *PackedIconStore::findSlot(quint64 id) const
+{
+    const quint32 mask = m_header->slotCount - 1;
+    IndexSlot *table = slots();
+    for (quint32 i = id & mask, probes = 0; probes <= mask; i = (i + 1) & mask, ++probes) {
+        IndexSlot &slot = table[i];
+        if (slot.state == SlotEmpty) {
+            return nullptr;
+        }
+        if (slot.state == SlotLive && slot.id == id) {
+            return &slot;
+        }
+    }
+    return nullptr;
+}
+
+PackedIconStore::IndexSlot *PackedIconStore::insertSlot(quint64 id)
+{
+    const quint32 used = m_header->liveCount + m_header->deletedCount;
+    if (used + 1 > m_header->slotCount * MAX_LOAD_FACTOR && !growIndex()) {
+        return nullptr;
+    }
+
+    const quint32 mask = m_header->slotCount - 1;
+    IndexSlot *table = slots();
+    IndexSlot *reusable = nullptr;
+    for (quint32 i = id & mask, probes = 0; probes <= mask; i = (i + 1) & mask, ++probes) {
+        IndexSlot &slot = table[i];
+        if (slot.state == SlotLive && slot.id == id) {
+            return &slot;
+        }
+        if (slot.state == SlotDeleted && !reusable) {
+            reusable = &slot;
+        } else if (slot.state == SlotEmpty) {
+            return reusable ? reusable : &slot;
+        }
+    }
+    return reusable;
+}
+
+bool PackedIconStore::growIndex()
+{
+    // Twice the size unless most used slots are tombstones
+    const quint32 slotCount = m_header->liveCount * 2 < m_header->slotCount
+        ? m_header->slotCount : m_header->slotCount * 2;
+
+    QByteArray index = emptyIndex(slotCount);
+    IndexHeader *header = reinterpret_cast<IndexHeader *>(index.data());
+    IndexSlot *newSlots = reinterpret_cast<IndexSlot *>(index.data() + sizeof(IndexHeader));
+    const quint32 mask = slotCount - 1;
+
+    const IndexSlot *table = slots();
+    for (quint32 i = 0; i < m_header->slotCount; ++i) {
+        if (table[i].state != SlotLive) {
+            continue;
+        }
+        quint32 j = table[i].id & mask;
+        while (newSlots[j].state != SlotEmpty) {
+            j = (j + 1) & mask;
+        }
+        newSlots[j] = table[i];
+    }
+    header->liveCount = m_header->liveCount;
+    header->liveBytes = m_header->liveBytes;
+    header->deadBytes = m_header->deadBytes;
+    memcpy(header->namespaces, m_header->namespaces, sizeof(header->namespaces));
+    header->generation = m_header->generation;
+
+    // The snapshot picks up the new size with the next checkpoint
+    setIndex(index);
+    m_clockHand = 0;
+    m_reclaimCursor = 0;
+    m_compactCursor = 0;
+
+    qDebug() << "PackedIconStore: index grown to" << slotCount << "slots";
+    return true;
+}
+
+void PackedIconStore::markDead(IndexSlot *slot)
+{
+    const auto segment = m_segments.find(slot->segment);
+    if (segment != m_segments.end()) {
+        segment->liveBytes -= slot->length;
+    }
+    m_header->liveBytes -= slot->length;
+    m_header->deadBytes += slot->length;
+}
+
+bool PackedIconStore::applyPut(quint64 id, quint32 segment, quint32 offset, quint32 length,
+                               quint32 lastAccessed, quint16 ns)
+{
+    IndexSlot *slot = insertSlot(id);
+    if (!slot) {
+        return false;
+    }
+
+    if (slot->state == SlotLive) {
+        if (slot->segment == segment && slot->offset == offset) {
+            // Same record, only the access time changed
+            slot->lastAccessed = lastAccessed;
+            return true;
+        }
+        markDead(slot);
+    } else {
+        if (slot->state == SlotDeleted) {
+            m_header->deletedCount--;
+        }
+        m_header->liveCount++;
+    }
+
+    slot->id = id;
+    slot->segment = segment;
+    slot->offset = offset;
+    slot->length = length;
+    slot->lastAccessed = lastAccessed;
+    slot->state = SlotLive;
+    slot->flags = SlotReferenced | (quint32(ns) << NAMESPACE_SHIFT);
+
+    const auto it = m_segments.find(segment);
+    if (it != m_segments.end()) {
+        it->liveBytes += length;
+    }
+    m_header->liveBytes += length;
+    return true;
+}
+
+bool PackedIconStore::applyRemove(quint64 id)
+{
+    IndexSlot *slot = findSlot(id);
+    if (!slot) {
+        return false;
+    }
+
+    removeSlot(slot);
+    return true;
+}
+
+void PackedIconStore::applyTouch(quint64 id, quint32 segment, quint32 offset, quint32 lastAccessed)
+{
+    IndexSlot *slot = findSlot(id);
+    if (slot && slot->segment == segment && slot->offset == offset) {
+        slot->lastAccessed = qMax(slot->lastAccessed, lastAccessed);
+    }
+}
+
+void PackedIconStore::removeSlot(IndexSlot *slot)
+{
+    markDead(slot);
+    slot->state = SlotDeleted;
+    slot->flags = 0;
+    m_header->liveCount--;
+    m_header->deletedCount++;
+}
+
+std::shared_ptr<PackedIconStore::SegmentMapping> PackedIconStore::mappingFor(quint32 segment, qint64 end)
+{
+    const auto it = m_segments.find(segment);
+    if (it == m_segments.end() || end > it->committed) {
+        return nullptr;
+    }
+
+    // The active segment grows, map it again once a record lies beyond the
+    // mapping. Only committed bytes are mapped, reserved ones may lie past EOF.
+    if (!it->mapping || it->mapping->size < end) {
+        auto mapping = std::make_shared<SegmentMapping>();
+        mapping->file.setFileName(segmentPath(segment));
+        if (!mapping->file.open(QIODevice::ReadOnly)) {
+            return nullptr;
+        }
+        mapping->size = it->committed;
+        mapping->data = mapping->file.map(0, mapping->size);
+        if (!mapping->data) {
+            return nullptr;
+        }
+        it->mapping = mapping;
+    }
+    return it->mapping;
+}
+
+bool PackedIconStore::locate(quint64 id, Location *location, bool touch)
+{
+    if (!isOpen()) {
+        return false;
+    }
+
+    IndexSlot *slot = findSlot(id);
+    // Maybe stored by another process since we last looked
+    if (!slot && m_shared && catchUp()) {
+        slot = findSlot(id);
+    }
+    if (!slot) {
+        return false;
+    }
+
+    location->mapping = mappingFor(slot->segment, qint64(slot->offset) + slot->length);
+    if (!location->mapping) {
+        if (removeIfUnchanged(id, slot->segment, slot->offset)) {
+            qWarning() << "PackedIconStore: dropping unreadable record" << Qt::hex << id;
+        }
+        return false;
+    }
+    location->id = id;
+    location->segment = slot->segment;
+    location->offset = slot->offset;
+    location->length = slot->length;
+    location->epoch = m_epoch;
+
+    if (touch) {
+        slot->flags |= SlotReferenced;
+
+        // Coarse access times keep hits from flooding the journal
+        const quint32 now = secondsSinceEpoch();
+        if (now - slot->lastAccessed >= TouchGranularitySeconds) {
+            slot->lastAccessed = now;
+            journalTouch(slot);
+        }
+    }
+    return true;
+}
+
+bool PackedIconStore::isCodecAvailable(Codec codec)
+{
+    switch (codec) {
+    case CodecRaw:
+        return true;
+    case CodecLz4:
+#ifdef QTXDG_HAVE_LZ4
+        return true;
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+QImage PackedIconStore::imageAt(const Location &location)
+{
+    if (!location.mapping) {
+        return QImage();
+    }
+
+    // The first access to the record pages faults them in, outside any lock
+    const RecordHeader *header = reinterpret_cast<const RecordHeader *>(
+        location.mapping->data + location.offset);
+    if (header->magic != RECORD_MAGIC || header->id != location.id
+        || header->width == 0 || header->width > MAX_DIMENSION
+        || header->height == 0 || header->height > MAX_DIMENSION
+        || sizeof(RecordHeader) + quint64(header->payloadSize) + header->sourceSize > location.length) {
+        return QImage();
+    }
+
+    const uchar *payload = reinterpret_cast<const uchar *>(header + 1);
+    const quint32 bytesPerLine = header->width * 4;
+    QImage image;
+
+    switch (header->codec) {
+    case CodecRaw:
+        if (header->payloadSize != quint64(bytesPerLine) * header->height) {
+            return QImage();
+        }
+        // Read-only image over the mapping, it keeps the mapping alive
+        image = QImage(payload, header->width, header->height, bytesPerLine,
+                       CachedTextureFactory::UploadFormat,
+                       releaseSegmentMapping, new std::shared_ptr<void>(location.mapping));
+        break;
+#ifdef QTXDG_HAVE_LZ4
+    case CodecLz4: {
+        image = QImage(header->width, header->height, CachedTextureFactory::UploadFormat);
+        if (image.isNull() || image.bytesPerLine() != qsizetype(bytesPerLine)) {
+            return QImage();
+        }
+        const int decoded = LZ4_decompress_safe(reinterpret_cast<const char *>(payload),
+                                                reinterpret_cast<char *>(image.bits()),
+                                                int(header->payloadSize), int(image.sizeInBytes()));
+        if (decoded != image.sizeInBytes()) {
+            return QImage();
+        }
+        break;
+    }
+#endif
+    default:
+        // Written by a build with a codec this one lacks
+        return QImage();
+    }
+
+    image.setDevicePixelRatio(header->dprThousandths / 1000.0);
+    return image;
+}
+
+PackedIconStore::Source PackedIconStore::sourceAt(const Location &location)
+{
+    Source source;
+    if (!location.mapping) {
+        return source;
+    }
+
+    const RecordHeader *header = reinterpret_cast<const RecordHeader *>(
+        location.mapping->data + location.offset);
+    const quint64 end = sizeof(RecordHeader) + quint64(header->payloadSize) + header->sourceSize;
+    if (header->magic != RECORD_MAGIC || header->sourceSize == 0 || end > location.length) {
+        return source;
+    }
+
+    // Points into the mapping, no copy
+    source.directory = QByteArray::fromRawData(
+        reinterpret_cast<const char *>(header + 1) + header->payloadSize, header->sourceSize);
+    source.modified = header->sourceModified;
+    return source;
+}
+
+qint64 PackedIconStore::prefetch(QList<Location> *locations)
+{
+    std::sort(locations->begin(), locations->end(), [](const Location &a, const Location &b) {
+        return a.segment != b.segment ? a.segment < b.segment : a.offset < b.offset;
+    });
+
+    qint64 requested = 0;
+    const auto adviseRun = [&requested](const Location &first, quint64 end) {
+        if (!first.mapping) {
+            return;
+        }
+        const int fd = first.mapping->file.handle();
+        const quint64 length = end - first.offset;
+        if (fd != -1 && ::posix_fadvise(fd, first.offset, length, POSIX_FADV_WILLNEED) == 0) {
+            requested += length;
+        }
+    };
+
+    // Neighbouring records become one request, the kernel reads them in one go
+    qsizetype runStart = 0;
+    quint64 runEnd = 0;
+    for (qsizetype i = 0; i < locations->size(); ++i) {
+        const Location &location = locations->at(i);
+        const Location &first = locations->at(runStart);
+        if (i > runStart
+            && (location.segment != first.segment
+                || location.offset > runEnd + PrefetchGapBytes)) {
+            adviseRun(first, runEnd);
+            runStart = i;
+        }
+        if (i == runStart) {
+            runEnd = location.offset;
+        }
+        runEnd = qMax(runEnd, quint64(location.offset) + location.length);
+    }
+    if (!locations->isEmpty()) {
+        adviseRun(locations->at(runStart), runEnd);
+    }
+    return requested;
+}
+
+bool PackedIconStore::discard(const Location &location)
+{
+    return isOpen() && location.epoch == m_epoch
+        && removeIfUnchanged(location.id, location.segment, location.offset);
+}
+
+bool PackedIconStore::removeIfUnchanged(quint64 id, quint32 segment, quint32 offset)
+{
+    WriteLock lock(this);
+
+    // Leave the entry alone if it was replaced in the meantime
+    IndexSlot *slot = isOpen() ? findSlot(id) : nullptr;
+    if (!slot || slot->segment != segment || slot->offset != offset) {
+        return false;
+    }
+
+    removeSlot(slot);
+    journal(id, nullptr);
+    return true;
+}
+
+QImage PackedIconStore::find(quint64 id, bool touch)
+{
+    Location location;
+    if (!locate(id, &location, touch)) {
+        return QImage();
+    }
+
+    QImage image = imageAt(location);
+    if (image.isNull() && discard(location)) {
+        qWarning() << "PackedIconStore: dropping corrupt record" << Qt::hex << id;
+    }
+    return image;
+}
+
+bool PackedIconStore::prepare(quint64 id, const QImage &sourceImage, PendingWrite *write, Codec codec,
+                              const Source &source)
+{
+    if (sourceImage.isNull()) {
+        return false;
+    }
+
+    const QImage image = CachedTextureFactory::toUploadFormat(sourceImage);
+    if (quint32(image.width()) > MAX_DIMENSION || quint32(image.height()) > MAX_DIMENSION) {
+        return false;
+    }
+
+    RecordHeader header;
+    header.magic = RECORD_MAGIC;
+    header.codec = CodecRaw;
+    header.id = id;
+    header.width = image.width();
+    header.height = image.height();
+    header.dprThousandths = qRound(image.devicePixelRatio() * 1000);
+    header.sourceSize = quint32(source.directory.size()) <= MAX_SOURCE_SIZE ? quint32(source.directory.size()) : 0;
+    header.reserved = 0;
+    header.sourceModified = header.sourceSize > 0 ? source.modified : 0;
+
+    const quint32 bytesPerLine = header.width * 4;
+    const quint32 rawSize = bytesPerLine * header.height;
+    header.payloadSize = rawSize;
+
+    // Room for a raw payload, compressed ones only ever use less
+    write->record = QByteArray(sizeof(RecordHeader) + rawSize + header.sourceSize, Qt::Uninitialized);
+    char *payload = write->record.data() + sizeof(RecordHeader);
+
+#ifdef QTXDG_HAVE_LZ4
+    if (codec == CodecLz4) {
+        // Rows of the upload format are tightly packed for 32 bpp
+        const int compressed = image.bytesPerLine() == qsizetype(bytesPerLine)
+            ? LZ4_compress_default(reinterpret_cast<const char *>(image.constBits()),
+                                   payload, int(rawSize), int(rawSize))
+            : 0;
+        // Incompressible icons are stored raw, they are served without a copy
+        if (compressed > 0 && quint32(compressed) < rawSize) {
+            header.codec = CodecLz4;
+            header.payloadSize = quint32(compressed);
+        }
+    }
+#else
+    Q_UNUSED(codec)
+#endif
+
+    if (header.codec == CodecRaw) {
+        for (quint32 y = 0; y < header.height; ++y) {
+            memcpy(payload + y * bytesPerLine, image.constScanLine(y), bytesPerLine);
+        }
+    }
+    memcpy(write->record.data(), &header, sizeof(header));
+    memcpy(payload + header.payloadSize, source.directory.constData(), header.sourceSize);
+
+    const quint32 length = alignedLength(sizeof(RecordHeader) + header.payloadSize + header.sourceSize);
+    const qsizetype used = sizeof(RecordHeader) + header.payloadSize + header.sourceSize;
+    write->record.resize(length);
+    memset(write->record.data() + used, 0, length - used);
+    write->id = id;
+    return true;
+}
+
+bool PackedIconStore::reserve(PendingWrite *write)
+{
+    if (!isOpen()) {
+        return false;
+    }
+
+    WriteLock lock(this);
+    if (!isOpen()) {
+        return false;
+    }
+
+    const qint64 length = write->record.size();
+    auto active = m_segments.find(m_activeSegment);
+    for (;;) {
+        if (active == m_segments.end()) {
+            m_activeFile.reset();
+            active = m_segments.insert(m_activeSegment, Segment());
+        }
+
+        if (!m_activeFile) {
+            auto file = std::make_shared<QFile>(segmentPath(m_activeSegment));
+            if (!file->open(QIODevice::ReadWrite)) {
+                qWarning() << "PackedIconStore: failed to open segment" << file->fileName();
+                return false;
+            }
+            m_activeFile = file;
+        }
+
+        // The file ends behind the reservations of all processes
+        if (m_shared) {
+            active->size = qMax(active->size, m_activeFile->size());
+        }
+        if (active->size == 0 || active->size + length <= SegmentSize) {
+            break;
+        }
+
+        // Seal the current segment, start the next one
+        ++m_activeSegment;
+        m_activeFile.reset();
+        active = m_segments.find(m_activeSegment);
+    }
+
+    // Grow the file while holding the lock, that reserves the range for
+    // other processes too
+    if (m_shared && !m_activeFile->resize(active->size + length)) {
+        qWarning() << "PackedIconStore: failed to grow segment" << m_activeFile->fileName();
+        return false;
+    }
+
+    write->segment = m_activeSegment;
+    write->offset = quint32(active->size);
+    write->epoch = m_epoch;
+    write->file = m_activeFile;
+
+    active->size += length;
+    active->pendingWrites++;
+    return true;
+}
+
+bool PackedIconStore::writeRecord(const PendingWrite &write)
+{
+    // Positioned writes, concurrent writers to disjoint ranges of one file
+    const char *data = write.record.constData();
+    qint64 remaining = write.record.size();
+    qint64 offset = write.offset;
+    while (remaining > 0) {
+        const ssize_t written = ::pwrite(write.file->handle(), data, size_t(remaining), off_t(offset));
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            qWarning() << "PackedIconStore: failed to write to" << write.file->fileName()
+                       << strerror(errno);
+            return false;
+        }
+        data += written;
+        remaining -= written;
+        offset += written;
+    }
+    return true;
+}
+
+bool PackedIconStore::commit(const PendingWrite &write, bool written)
+{
+    if (!isOpen()) {
+        return false;
+    }
+
+    // A cleared or reloaded store doesn't know the reservation anymore
+    WriteLock lock(this);
+    if (!isOpen() || write.epoch != m_epoch) {
+        return false;
+    }
+    const auto segment = m_segments.find(write.segment);
+    if (segment == m_segments.end()) {
+        return false;
+    }
+
+    const quint32 length = quint32(write.record.size());
+    segment->pendingWrites--;
+    if (!written) {
+        // The reserved range stays behind as dead bytes
+        m_header->deadBytes += length;
+        return false;
+    }
+
+    // Only now the record becomes visible to readers
+    segment->committed = qMax(segment->committed, qint64(write.offset) + length);
+    // Written for a namespace that was dropped meanwhile
+    if (!isNamespaceRetained(write.ns)
+        || !applyPut(write.id, write.segment, write.offset, length, secondsSinceEpoch(), write.ns)) {
+        m_header->deadBytes += length;
+        return false;
+    }
+
+    journal(write.id, findSlot(write.id));
+    checkpointIfNeeded();
+    return true;
+}
+
+bool PackedIconStore::insert(quint64 id, const QImage &image, Codec codec)
+{
+    PendingWrite write;
+    if (!isOpen() || !prepare(id, image, &write, codec)) {
+        return false;
+    }
+
+    // One lock hold, another process can't reload the store in between
+    WriteLock lock(this);
+    write.ns = activeNamespace();
+    if (!reserve(&write)) {
+        return false;
+    }
+    return commit(write, writeRecord(write));
+}
+
+bool PackedIconStore::remove(quint64 id)
+{
+    if (!isOpen()) {
+        return false;
+    }
+
+    WriteLock lock(this);
+    if (!isOpen() || !applyRemove(id)) {
+        return false;
+    }
+
+    journal(id, nullptr);
+    checkpointIfNeeded();
+    return true;
+}
+
+qint64 PackedIconStore::evict(qint64 bytesToFree, int *evictedCount)
+{
+    if (!isOpen()) {
+        return 0;
+    }
+
+    WriteLock lock(this);
+    if (!isOpen()) {
+        return 0;
+    }
+
+    // Second chance clock over the slot table: a referenced entry loses its
+    // bit and survives one more sweep, an unreferenced one is evicted. Every
+    // slot is passed at most twice, so eviction is amortized O(1).
+    const quint32 mask = m_header->slotCount - 1;
+    IndexSlot *table = slots();
+    qint64 freed = 0;
+    int evicted = 0;
+
+    while (freed < bytesToFree && m_header->liveCount > 0) {
+        IndexSlot &slot = table[m_clockHand];
+        m_clockHand = (m_clockHand + 1) & mask;
+
+        if (slot.state != SlotLive) {
+            continue;
+        }
+        if (slot.flags & SlotReferenced) {
+            slot.flags &= ~SlotReferenced;
+            continue;
+        }
+
+        freed += slot.length;
+        evicted++;
+        removeSlot(&slot);
+        journal(slot.id, nullptr);
+    }
+
+    if (evictedCount) {
+        *evictedCount = evicted;
+    }
+    checkpointIfNeeded();
+    return freed;
+}
+
+quint16 PackedIconStore::activeNamespace() const
+{
+    return isOpen() ? m_header->namespaces[0] : 0;
+}
+
+QList<quint16> PackedIconStore::retainedNamespaces() const
+{
+    QList<quint16> result;
+    if (isOpen()) {
+        for (quint16 tag : m_header->namespaces) {
+            result.append(tag);
+        }
+    }
+    return result;
+}
+
+bool PackedIconStore::isNamespaceRetained(quint16 tag) const
+{
+    for (quint16 retained : m_header->namespaces) {
+        if (retained == tag) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void PackedIconStore::activateNamespace(quint16 tag)
+{
+    if (!isOpen()) {
+        return;
+    }
+
+    WriteLock lock(this);
+    if (!isOpen() || m_header->namespaces[0] == tag) {
+        return;
+    }
+
+    applyNamespace(tag);
+    journalNamespace(tag);
+}
+
+void PackedIconStore::applyNamespace(quint16 tag)
+{
+    // Move to the front, the least recent one falls off unless it is reactivated
+    quint16 *namespaces = m_header->namespaces;
+    const quint16 dropped = namespaces[MaxNamespaces - 1];
+    int from = MaxNamespaces - 1;
+    for (int i = 0; i < MaxNamespaces; ++i) {
+        if (namespaces[i] == tag) {
+            from = i;
+            break;
+        }
+    }
+    for (int i = from; i > 0; --i) {
+        namespaces[i] = namespaces[i - 1];
+    }
+    namespaces[0] = tag;
+
+    // Entries of the dropped namespace are removed by reclaimStep()
+    if (from == MaxNamespaces - 1 && dropped != tag && !isNamespaceRetained(dropped)) {
+        m_reclaimPending = true;
+        m_reclaimCursor = 0;
+    }
+}
+
+quint32 PackedIconStore::generation() const
+{
+    return isOpen() ? m_header->generation : 0;
+}
+
+void PackedIconStore::setGeneration(quint32 generation)
+{
+    if (!isOpen()) {
+        return;
+    }
+
+    WriteLock lock(this);
+    if (isOpen() && m_header->generation != generation) {
+        m_header->generation = generation;
+        journalGeneration(generation);
+    }
+}
+
+bool PackedIconStore::reclaimStep(int maxSlots)
+{
+    if (!isOpen() || !m_reclaimPending) {
+        return false;
+    }
+
+    WriteLock lock(this);
+    if (!isOpen() || !m_reclaimPending) {
+        return false;
+    }
+
+    IndexSlot *table = slots();
+    const quint32 end = quint32(qMin<qint64>(m_header->slotCount, qint64(m_reclaimCursor) + maxSlots));
+    int reclaimed = 0;
+    for (; m_reclaimCursor < end; ++m_reclaimCursor) {
+        IndexSlot &slot = table[m_reclaimCursor];
+        if (slot.state == SlotLive && !isNamespaceRetained(quint16(slot.flags >> NAMESPACE_SHIFT))) {
+            removeSlot(&slot);
+            journal(slot.id, nullptr);
+            reclaimed++;
+        }
+    }
+
+    if (reclaimed > 0) {
+        qDebug() << "PackedIconStore: reclaimed" << reclaimed << "entries of dropped namespaces";
+    }
+
+    if (m_reclaimCursor >= m_header->slotCount) {
+        m_reclaimPending = false;
+    }
+    checkpointIfNeeded();
+    return m_reclaimPending;
+}
+
+void PackedIconStore::clear()
+{
+    // Other processes reload once they see the journal replaced
+    WriteLock lock(this, false);
+    release();
+
+    // Images served from the old segments keep their mappings
+    const QStringList segmentFiles = QDir(m_directory).entryList(
+        QStringList() << QStringLiteral("data-*.seg"), QDir::Files);
+    for (const QString &fileName : segmentFiles) {
+        QFile::remove(m_directory + u'/' + fileName);
+    }
+    QFile::remove(journalPath());
+    QFile::remove(indexPath());
+
+    open();
+}
+
+int PackedIconStore::count() const
+{
+    return isOpen() ? int(m_header->liveCount) : 0;
+}
+
+qint64 PackedIconStore::liveBytes() const
+{
+    return isOpen() ? qint64(m_header->liveBytes) : 0;
+}
+
+qint64 PackedIconStore::deadBytes() const
+{
+    return isOpen() ? qint64(m_header->deadBytes) : 0;
+}
+
+int PackedIconStore::segmentCount() const
+{
+    return m_segments.size();
+}
+
+QList<PackedIconStore::EntryInfo> PackedIconStore::entries() const
+{
+    QList<EntryInfo> result;
+    if (!isOpen()) {
+        return result;
+    }
+
+    result.reserve(m_header->liveCount);
+    const IndexSlot *table = slots();
+    for (quint32 i = 0; i < m_header->slotCount; ++i) {
+        if (table[i].state == SlotLive) {
+            result.append(EntryInfo{table[i].id, table[i].length, table[i].lastAccessed});
+        }
+    }
+    return result;
+}
+
+bool PackedIconStore::isSealed(quint32 segment) const
+{
+    // Another process of a shared store may still append to the newest one
+    return segment != m_activeSegment && segment != m_segments.lastKey();
+}
+
+bool PackedIconStore::needsCompaction() const
+{
+    for (auto it = m_segments.cbegin(); it != m_segments.cend(); ++it) {
+        if (isSealed(it.key()) && it->size > 0 && it->pendingWrites == 0
+            && double(it->size - it->liveBytes) / it->size >= CompactionThreshold) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool PackedIconStore::prepareCompaction(CompactionBatch *batch)
+{
+    batch->moves.clear();
+    batch->from.clear();
+    if (!isOpen()) {
+        return false;
+    }
+
+    WriteLock lock(this);
+    if (!isOpen()) {
+        return false;
+    }
+
+    // Continue the segment being compacted, or start on the sealed one
+    // with the largest share of dead bytes
+    if (!m_compacting || !m_segments.contains(m_compactSegment)) {
+        quint32 victim = 0;
+        double worst = CompactionThreshold;
+        bool found = false;
+        for (auto it = m_segments.cbegin(); it != m_segments.cend(); ++it) {
+            if (!isSealed(it.key()) || it->size == 0 || it->pendingWrites > 0) {
+                continue;
+            }
+            const double dead = double(it->size - it->liveBytes) / it->size;
+            if (dead >= worst) {
+                worst = dead;
+                victim = it.key();
+                found = true;
+            }
+        }
+        if (!found) {
+            m_compacting = false;
+            return false;
+        }
+        m_compacting = true;
+        m_compactSegment = victim;
+        m_compactCursor = 0;
+    }
+
+    batch->segment = m_compactSegment;
+    batch->epoch = m_epoch;
+    batch->mapping = mappingFor(m_compactSegment, m_segments.value(m_compactSegment).size);
+
+    IndexSlot *table = slots();
+    qint64 bytes = 0;
+    while (m_compactCursor < m_header->slotCount
+           && batch->moves.size() < CompactionBatchRecords && bytes < CompactionBatchBytes) {
+        IndexSlot &slot = table[m_compactCursor++];
+        if (slot.state != SlotLive || slot.segment != m_compactSegment) {
+            continue;
+        }
+
+        // The bytes are copied straight from the mapping the batch holds
+        PendingWrite write;
+        write.id = slot.id;
+        write.ns = quint16(slot.flags >> NAMESPACE_SHIFT);
+        if (batch->mapping) {
+            write.record = QByteArray::fromRawData(
+                reinterpret_cast<const char *>(batch->mapping->data + slot.offset), slot.length);
+        }
+        if (!batch->mapping || !reserve(&write)) {
+            // Can't move it, drop it, it is only a cache
+            const quint64 id = slot.id;
+            removeSlot(&slot);
+            journal(id, nullptr);
+            continue;
+        }
+
+        batch->moves.append(write);
+        batch->from.append(slot.offset);
+        bytes += slot.length;
+    }
+    return true;
+}
+
+bool PackedIconStore::commitCompaction(const CompactionBatch &batch, const QList<bool> &written)
+{
+    if (!isOpen()) {
+        return false;
+    }
+
+    // A reloaded or cleared store has forgotten the batch and its reservations
+    WriteLock lock(this);
+    if (!isOpen() || batch.epoch != m_epoch || !m_compacting || batch.segment != m_compactSegment) {
+        return false;
+    }
+
+    for (qsizetype i = 0; i < batch.moves.size(); ++i) {
+        const PendingWrite &write = batch.moves.at(i);
+        const auto segment = m_segments.find(write.segment);
+        if (segment == m_segments.end()) {
+            continue;
+        }
+
+        const quint32 length = quint32(write.record.size());
+        segment->pendingWrites--;
+        if (!written.value(i)) {
+            m_header->deadBytes += length;
+            continue;
+        }
+        segment->committed = qMax(segment->committed, qint64(write.offset) + length);
+
+        // Replaced or removed while the bytes were copied, the copy is dead
+        IndexSlot *slot = findSlot(write.id);
+        if (!slot || slot->segment != batch.segment || slot->offset != batch.from.at(i)) {
+            m_header->deadBytes += length;
+            continue;
+        }
+
+        slot->segment = write.segment;
+        slot->offset = write.offset;
+        segment->liveBytes += slot->length;
+        journal(slot->id, slot);
+    }
+
+    if (m_compactCursor < m_header->slotCount) {
+        checkpointIfNeeded();
+        return true;
+    }
+
+    // Every live record is moved. The moves must be durable before the
+    // old copies disappear, the victim stays if they aren't.
+    m_compacting = false;
+    if (!checkpoint()) {
+        return false;
+    }
+
+    const quint32 victim = batch.segment;
+    const qint64 reclaimed = m_segments[victim].size - m_segments[victim].liveBytes;
+    m_header->deadBytes -= quint64(qMax<qint64>(0, reclaimed));
+    m_segments.remove(victim);
+    QFile::remove(segmentPath(victim));
+
+    qDebug() << "PackedIconStore: compacted segment" << victim
+             << "reclaimed=" << (reclaimed / 1024) << "KB";
+
+    return needsCompaction();
+}
+
+bool PackedIconStore::compactStep()
+{
+    CompactionBatch batch;
+    if (!prepareCompaction(&batch)) {
+        return false;
+    }
+
+    QList<bool> written;
+    written.reserve(batch.moves.size());
+    for (const PendingWrite &write : std::as_const(batch.moves)) {
+        written.append(writeRecord(write));
+    }
+    return commitCompaction(batch, written);
+}
@@ -0,0 +1,496 @@
+/* BEGIN_COMMON_COPYRIGHT_HEADER
+ * (c)LGPL2+
+ *
+ * LXQt - a lightweight, Qt based, desktop toolset
+ * https://lxqt.org
+ *
+ * Copyright: 2025 LXQt team
+ * Authors:
+ *   LXQt team
+ *
+ * This program or library is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ *
+ * END_COMMON_COPYRIGHT_HEADER */
+
+#ifndef PACKEDICONSTORE_H
+#define PACKEDICONSTORE_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QImage>
+#include <QList>
+#include <QMap>
+#include <QString>
+
+#include <memory>
+
+/*!
+ * \brief Packed on-disk storage of DiskIconCache
+ *
+ * Icons are appended to data segments ("data-<n>.seg", at most
+ * SegmentSize each) as a 48 byte record header (codec, size, device pixel
+ * ratio, source) followed by CachedTextureFactory::UploadFormat pixels, raw
+ * or LZ4 compressed, and the directory the icon was rendered from, padded
+ * to 16 bytes. A fixed layout open addressing hash table maps persistent
+ * ids to records.
+ *
+ * The table is persisted as a snapshot ("index.bin", read with a single
+ * read() on open) plus an append-only journal ("index.journal") of 32 byte
+ * checksummed records (puts, removes, access times, namespace changes).
+ * Updates only append to the journal, checkpoint() writes a new snapshot
+ * atomically and truncates the journal. On open the journal is replayed
+ * up to the first torn record, so a crash loses at most the unflushed
+ * tail. Entries are validated against the segment sizes only, records are
+ * never read or stat'ed on open.
+ *
+ * find() of a raw record returns a read-only QImage pointing into the
+ * mmap'd segment, a hit costs no read(), decode or copy. LZ4 records are
+ * decompressed into a new image, trading that copy for less disk space.
+ * The image keeps its mapping alive, so segments can be replaced and
+ * deleted while images are still in use.
+ *
+ * Every entry belongs to a namespace, a 16 bit tag chosen by the owner
+ * (DiskIconCache derives it from the theme generation and palette). The
+ * store retains the MaxNamespaces most recently activated ones, entries of
+ * older namespaces are removed in the background by reclaimStep().
+ *
+ * Replaced and removed records stay in their segment as dead bytes until
+ * compaction moves the live records of the emptiest sealed segment to the
+ * active one, in batches written without the lock, and deletes it.
+ *
+ * A shared store (see the constructor) is used by several processes at
+ * once. Changes take an flock() on the "lock" file of the directory, first
+ * apply what other processes journaled meanwhile, then append their own
+ * records, so the journal is one serialized history of all of them. Space
+ * is reserved by growing the segment file, record bytes are still written
+ * without the lock. A lookup that misses reads the journal tail first, an
+ * icon stored by one process is a hit for all. A checkpoint replaces the
+ * journal file, other processes notice and reload the snapshot. A private
+ * store holds that lock while it is open instead, it has no catching up to
+ * do; a second process opening the same directory gets no store.
+ *
+ * Not thread-safe, DiskIconCache serializes access. Reading and writing
+ * record bytes doesn't need the store though: locate() and imageAt(),
+ * prepare(), reserve(), writeRecord() and commit() split lookups and
+ * inserts into short index operations and lock-free file I/O. A record
+ * only becomes visible with commit(), after its bytes are written.
+ */
+class PackedIconStore
+{
+public:
+    struct SegmentMapping;
+
+    /*!
+     * \brief Record payload encodings, stored in the record header
+     */
+    enum Codec : quint32 {
+        CodecRaw = 0,   ///< Pixels as is, served straight from the mapping
+        CodecLz4 = 1    ///< LZ4 block, only if the build found liblz4
+    };
+
+    /*!
+     * \brief Where a record lives, from locate()
+     */
+    struct Location {
+        quint64 id = 0;
+        quint32 segment = 0;
+        quint32 offset = 0;
+        quint32 length = 0;
+        quint64 epoch = 0;
+        std::shared_ptr<SegmentMapping> mapping;
+    };
+
+    /*!
+     * \brief An insert split into its steps, see reserve()
+     */
+    struct PendingWrite {
+        quint64 id = 0;
+        QByteArray record;
+        quint32 segment = 0;
+        quint32 offset = 0;
+        quint64 epoch = 0;
+        quint16 ns = 0;    ///< Namespace the record is written for
+        std::shared_ptr<QFile> file;
+    };
+
+    /*!
+     * \brief Records of the compacted segment being moved, see prepareCompaction()
+     */
+    struct CompactionBatch {
+        quint32 segment = 0;    ///< Being compacted
+        quint64 epoch = 0;
+        std::shared_ptr<SegmentMapping> mapping;   ///< Of the segment, the moves read from it
+        QList<PendingWrite> moves;
+        QList<quint32> from;    ///< Offset of each move in the segment
+    };
+
+    /*!
+     * \brief What a record was rendered from, for the owner to validate hits
+     */
+    struct Source {
+        QByteArray directory;   ///< Of the source file, local 8 bit encoding
+        qint64 modified = 0;    ///< Directory mtime when rendered, ms since the epoch
+    };
+
+    struct EntryInfo {
+        quint64 id = 0;
+        quint32 length = 0;        ///< Record bytes on disk
+        quint32 lastAccessed = 0;  ///< Seconds since the epoch
+    };
+
+    // Segments are sealed once the next record doesn't fit
+    static constexpr qint64 SegmentSize = 32 * 1024 * 1024;
+
+    // Sealed segments with at least this share of dead bytes are compacted
+    static constexpr double CompactionThreshold = 0.5;
+
+    // Records and bytes moved by one compaction batch at most
+    static constexpr int CompactionBatchRecords = 64;
+    static constexpr qint64 CompactionBatchBytes = 1024 * 1024;
+
+    // Namespaces kept before their entries are reclaimed
+    static constexpr int MaxNamespaces = 4;
+
+    // Journal records are buffered up to this size before they are written
+    static constexpr int JournalFlushBytes = 4096;
+
+    // A new snapshot is written once the journal holds this many records
+    static constexpr int CheckpointRecords = 16384;
+
+    // Access times are journaled at most this often per entry
+    static constexpr quint32 TouchGranularitySeconds = 60;
+
+    // prefetch() reads over gaps up to this size instead of splitting the run
+    static constexpr quint32 PrefetchGapBytes = 64 * 1024;
+
+    /*!
+     * \brief Store in \a directory, \a shared if other processes use it concurrently
+     */
+    explicit PackedIconStore(const QString &directory, bool shared = false);
+    ~PackedIconStore();
+
+    PackedIconStore(const PackedIconStore &) = delete;
+    PackedIconStore &operator=(const PackedIconStore &) = delete;
+
+    /*!
+     * \brief Load the snapshot, replay the journal and find the segments,
+     *        creating an empty store if there is none or it is unusable
+     *
+     * A private store locks its directory until close(), open() fails if
+     * another store (of this or another process) has it open.
+     */
+    bool open();
+    bool isOpen() const { return m_indexData != nullptr; }
+    bool isShared() const { return m_shared; }
+
+    /*!
+     * \brief Checkpoint (shared stores: flush) and release all files
+     */
+    void close();
+
+    /*!
+     * \brief Write buffered journal records
+     */
+    void flush();
+
+    /*!
+     * \brief Replace the snapshot with the current table and empty the journal
+     *
+     * Other processes of a shared store reload the snapshot afterwards.
+     */
+    bool checkpoint();
+
+    /*!
+     * \brief Image stored for \a id, served from the mapping
+     * \param touch Update the entry's access time
+     */
+    QImage find(quint64 id, bool touch = true);
+
+    /*!
+     * \brief Find the record of \a id and pin its segment mapping
+     */
+    bool locate(quint64 id, Location *location, bool touch = true);
+
+    /*!
+     * \brief Image of a located record, null if the record is corrupt
+     *
+     * Touches only the mapping, no store access, safe without a lock.
+     */
+    static QImage imageAt(const Location &location);
+
+    /*!
+     * \brief Source recorded with a located record, empty if none
+     *
+     * The directory points into the mapping, it is valid as long as
+     * \a location. No store access, safe without a lock.
+     */
+    static Source sourceAt(const Location &location);
+
+    /*!
+     * \brief Ask the kernel to read the records of \a locations ahead
+     *
+     * Sorts \a locations by segment and offset, so reading them in list
+     * order afterwards is sequential, and issues one posix_fadvise()
+     * WILLNEED per run of records at most PrefetchGapBytes apart. Returns
+     * immediately, the reads happen in the background. No store access,
+     * safe without a lock.
+     * \return Bytes asked for, gaps between merged records included
+     */
+    static qint64 prefetch(QList<Location> *locations);
+
+    /*!
+     * \brief Remove the located entry unless it was replaced since
+     */
+    bool discard(const Location &location);
+
+    /*!
+     * \brief Store \a image (in UploadFormat) for \a id, replacing an older record
+     */
+    bool insert(quint64 id, const QImage &image, Codec codec = CodecRaw);
+
+    /*!
+     * \brief Whether records can be written and read with \a codec
+     */
+    static bool isCodecAvailable(Codec codec);
+
+    /*!
+     * \brief Encode the record of \a image, no store access
+     *
+     * Falls back to CodecRaw if \a codec is unavailable or doesn't shrink
+     * the pixels. \a source is stored with the record.
+     */
+    static bool prepare(quint64 id, const QImage &image, PendingWrite *write,
+                        Codec codec = CodecRaw, const Source &source = Source());
+
+    /*!
+     * \brief Reserve space for a prepared record in the active segment
+     */
+    bool reserve(PendingWrite *write);
+
+    /*!
+     * \brief Write a reserved record, no store access
+     */
+    static bool writeRecord(const PendingWrite &write);
+
+    /*!
+     * \brief Publish a reserved record in the index
+     * \param written Result of writeRecord(), a failed write turns into dead bytes
+     */
+    bool commit(const PendingWrite &write, bool written);
+    bool remove(quint64 id);
+
+    /*!
+     * \brief Evict entries not hit recently until \a bytesToFree are freed
+     *
+     * A clock sweep over the index approximating LRU, amortized O(1) per
+     * evicted entry. Evicted records become dead bytes.
+     * \return Bytes freed
+     */
+    qint64 evict(qint64 bytesToFree, int *evictedCount = nullptr);
+
+    /*!
+     * \brief Remove all records and segment files
+     */
+    void clear();
+
+    // Running totals, O(1)
+    int count() const;
+    qint64 liveBytes() const;
+    qint64 deadBytes() const;
+    int segmentCount() const;
+    QList<EntryInfo> entries() const;
+
+    /*!
+     * \brief Make \a tag the namespace of insert()
+     *
+     * O(1), journaled, so it applies to all processes of a shared store.
+     * If this pushes a namespace out of the retained ones, its entries are
+     * left for reclaimStep().
+     */
+    void activateNamespace(quint16 tag);
+    quint16 activeNamespace() const;
+    QList<quint16> retainedNamespaces() const;
+
+    /*!
+     * \brief Counter persisted with the index for the owner's use
+     */
+    quint32 generation() const;
+    void setGeneration(quint32 generation);
+
+    bool needsReclaim() const { return m_reclaimPending; }
+
+    /*!
+     * \brief Remove entries of dropped namespaces from the next \a maxSlots slots
+     * \return true if more slots remain to be looked at
+     */
+    bool reclaimStep(int maxSlots = 4096);
+
+    bool needsCompaction() const;
+
+    /*!
+     * \brief Reserve space for the next live records of the compacted segment
+     *
+     * Picks the segment on the first call. Moves at most
+     * CompactionBatchRecords records or CompactionBatchBytes per batch.
+     * Records that can't be moved are dropped. Write the moves with
+     * writeRecord(), no store access, then commitCompaction().
+     * \return false if no segment needs compaction
+     */
+    bool prepareCompaction(CompactionBatch *batch);
+
+    /*!
+     * \brief Point the index at the moved records
+     *
+     * Records replaced or removed since prepareCompaction() keep their
+     * new entry, the copy becomes dead bytes. After the last batch the
+     * store is checkpointed and only then the segment deleted.
+     * \param written Result of writeRecord() for every move
+     * \return true if more batches, of this or another segment, follow
+     */
+    bool commitCompaction(const CompactionBatch &batch, const QList<bool> &written);
+
+    /*!
+     * \brief Compact one batch, writing the moves in between
+     * \return true if more batches follow
+     */
+    bool compactStep();
+
+private:
+    friend class tst_packediconstore;
+
+    class WriteLock;
+    struct IndexHeader;
+    struct IndexSlot;
+    struct RecordHeader;
+    struct JournalRecord;
+
+    struct Segment {
+        qint64 size = 0;       ///< Bytes written or reserved
+        qint64 committed = 0;  ///< End of the last committed record
+        qint64 liveBytes = 0;  ///< Bytes of records the index points to
+        int pendingWrites = 0; ///< Reservations not yet committed
+        std::shared_ptr<SegmentMapping> mapping;
+    };
+
+    QString indexPath() const;
+    QString journalPath() const;
+    QString segmentPath(quint32 segment) const;
+
+    /*!
+     * \brief Drop all state without writing anything
+     */
+    void release();
+
+    /*!
+     * \brief open() without taking the lock
+     */
+    bool load();
+
+    void setIndex(const QByteArray &index);
+    static QByteArray emptyIndex(quint32 slotCount);
+    bool loadIndex();
+    void scanSegments();
+    void replayJournal();
+    void validateSlots();
+    bool growIndex();
+
+    /*!
+     * \brief Apply journal records other processes appended to a shared store
+     * \return true if anything changed
+     */
+    bool catchUp();
+    bool journalReplaced() const;
+    bool readJournalTail();
+
+    /*!
+     * \brief Apply the valid records at the start of \a data
+     * \param noteSegments Extend segments by the records of puts, they were
+     *        written by another process
+     * \return Bytes applied
+     */
+    qsizetype applyJournal(const QByteArray &data, bool noteSegments, int *applied);
+
+    /*!
+     * \brief Segment no process appends to anymore
+     */
+    bool isSealed(quint32 segment) const;
+
+    IndexSlot *slots() const;
+    IndexSlot *findSlot(quint64 id) const;
+    IndexSlot *insertSlot(quint64 id);
+    void markDead(IndexSlot *slot);
+
+    bool applyPut(quint64 id, quint32 segment, quint32 offset, quint32 length,
+                  quint32 lastAccessed, quint16 ns);
+    bool isNamespaceRetained(quint16 tag) const;
+    bool applyRemove(quint64 id);
+    void applyTouch(quint64 id, quint32 segment, quint32 offset, quint32 lastAccessed);
+    void applyNamespace(quint16 tag);
+    void removeSlot(IndexSlot *slot);
+
+    /*!
+     * \brief Remove \a id unless it was replaced since it was looked up
+     */
+    bool removeIfUnchanged(quint64 id, quint32 segment, quint32 offset);
+
+    /*!
+     * \brief Buffer a journal record, a remove if \a slot is not live
+     */
+    void journal(quint64 id, const IndexSlot *slot);
+    void journalTouch(const IndexSlot *slot);
+    void journalNamespace(quint16 tag);
+    void journalGeneration(quint32 generation);
+    void appendJournal(JournalRecord *record);
+
+    /*!
+     * \brief Write buffered journal records, a shared store's lock held
+     */
+    void writeJournal();
+    void checkpointIfNeeded();
+
+    /*!
+     * \brief Mapping of \a segment covering at least \a end bytes
+     */
+    std::shared_ptr<SegmentMapping> mappingFor(quint32 segment, qint64 end);
+
+    QString m_directory;
+    bool m_shared = false;
+    QFile m_lockFile;             // flock()ed by WriteLock, or while open if private
+    int m_lockDepth = 0;          // Nested WriteLocks
+    QByteArray m_index;           // Header and slots, as written to the snapshot
+    uchar *m_indexData = nullptr;
+    IndexHeader *m_header = nullptr;
+
+    QFile m_journalFile;
+    QByteArray m_journalBuffer;   // Records not yet written
+    int m_journalRecords = 0;     // Records since the last checkpoint
+    qint64 m_journalOffset = 0;   // Journal bytes applied or written
+
+    quint32 m_clockHand = 0;      // Next slot the eviction sweep looks at
+    quint32 m_reclaimCursor = 0;  // Next slot reclaimStep() looks at
+    bool m_reclaimPending = false;
+
+    bool m_compacting = false;     // A segment is half moved
+    quint32 m_compactSegment = 0;
+    quint32 m_compactCursor = 0;   // Next slot prepareCompaction() looks at
+
+    QMap<quint32, Segment> m_segments;
+    quint32 m_activeSegment = 0;
+    std::shared_ptr<QFile> m_activeFile;  // Shared with pending writes
+    quint64 m_epoch = 0;                 // Renewed whenever the store is released
+};
+
+#endif // PACKEDICONSTORE_H
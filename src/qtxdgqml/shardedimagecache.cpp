@@ -0,0 +1,122 @@
+/* BEGIN_COMMON_COPYRIGHT_HEADER
+ * (c)LGPL2+
+ *
+ * LXQt - a lightweight, Qt based, desktop toolset
+ * https://lxqt.org
+ *
+ * Copyright: 2025 LXQt team
+ * Authors:
+ *   LXQt team
+ *
+ * This program or library is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ *
+ * END_COMMON_COPYRIGHT_HEADER */
+
+#include "shardedimagecache.h"
+#include <QMutexLocker>
+
+ShardedImageCache::ShardedImageCache(qint64 maxCost)
+{
+    setMaxCost(maxCost);
+}
+
+ShardedImageCache::Shard &ShardedImageCache::shardFor(const IconCacheKey &key) const
+{
+    return m_shards[qHash(key) % ShardCount];
+}
+
+QImage ShardedImageCache::find(const IconCacheKey &key) const
+{
+    if (!key.isValid()) {
+        return QImage();
+    }
+
+    Shard &shard = shardFor(key);
+    QMutexLocker locker(&shard.mutex);
+    if (const QImage *cached = shard.cache.object(key)) {
+        return *cached;
+    }
+    return QImage();
+}
+
+bool ShardedImageCache::contains(const IconCacheKey &key) const
+{
+    Shard &shard = shardFor(key);
+    QMutexLocker locker(&shard.mutex);
+    return shard.cache.contains(key);
+}
+
+void ShardedImageCache::insert(const IconCacheKey &key, const QImage &image)
+{
+    if (!key.isValid()) {
+        return;
+    }
+
+    // Allocate outside the lock, QCache takes ownership
+    QImage *cached = new QImage(image);
+    const qint64 cost = image.sizeInBytes();
+
+    Shard &shard = shardFor(key);
+    QMutexLocker locker(&shard.mutex);
+    shard.cache.insert(key, cached, cost);
+}
+
+void ShardedImageCache::clear()
+{
+    for (Shard &shard : m_shards) {
+        QMutexLocker locker(&shard.mutex);
+        shard.cache.clear();
+    }
+}
+
+void ShardedImageCache::setMaxCost(qint64 maxCost)
+{
+    const qint64 shardCost = maxCost / ShardCount;
+    for (Shard &shard : m_shards) {
+        QMutexLocker locker(&shard.mutex);
+        shard.cache.setMaxCost(shardCost);
+    }
+}
+
+qint64 ShardedImageCache::maxCost() const
+{
+    qint64 total = 0;
+    for (const Shard &shard : m_shards) {
+        QMutexLocker locker(&shard.mutex);
+        total += shard.cache.maxCost();
+    }
+    return total;
+}
+
+int ShardedImageCache::count() const
+{
+    int total = 0;
+    for (const Shard &shard : m_shards) {
+        QMutexLocker locker(&shard.mutex);
+        total += shard.cache.count();
+    }
+    return total;
+}
+
+qint64 ShardedImageCache::totalCost() const
+{
+    qint64 total = 0;
+    for (const Shard &shard : m_shards) {
+        QMutexLocker locker(&shard.mutex);
+        total += shard.cache.totalCost();
+    }
+    return total;
+}
@@ -0,0 +1,92 @@
+/* BEGIN_COMMON_COPYRIGHT_HEADER
+ * (c)LGPL2+
+ *
+ * LXQt - a lightweight, Qt based, desktop toolset
+ * https://lxqt.org
+ *
+ * Copyright: 2025 LXQt team
+ * Authors:
+ *   LXQt team
+ *
+ * This program or library is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ *
+ * END_COMMON_COPYRIGHT_HEADER */
+
+#ifndef SHARDEDIMAGECACHE_H
+#define SHARDEDIMAGECACHE_H
+
+#include "iconcachekey.h"
+
+#include <QCache>
+#include <QImage>
+#include <QMutex>
+
+#include <array>
+
+/*!
+ * \brief Cost bounded QImage cache split into independently locked shards
+ *
+ * Keys are distributed over ShardCount shards by qHash(), each shard is a
+ * QCache with its own mutex and 1/ShardCount of the total cost budget. A
+ * lookup only contends with operations on the same shard, so the GUI
+ * thread reading hits and the loader threads inserting results rarely
+ * wait on each other.
+ *
+ * find() returns an implicitly shared copy of the cached QImage; no pixel
+ * data is copied and nothing is allocated on the heap for a hit. Invalid
+ * keys are never stored.
+ *
+ * All methods are thread-safe.
+ */
+class ShardedImageCache
+{
+public:
+    static constexpr int ShardCount = 16;
+
+    explicit ShardedImageCache(qint64 maxCost = 0);
+
+    /*!
+     * \brief Look up \a key, returns a null QImage on a miss
+     */
+    QImage find(const IconCacheKey &key) const;
+    bool contains(const IconCacheKey &key) const;
+
+    /*!
+     * \brief Insert \a image with its byte size as cost
+     *
+     * Images bigger than a shard's budget are not cached.
+     */
+    void insert(const IconCacheKey &key, const QImage &image);
+    void clear();
+
+    void setMaxCost(qint64 maxCost);
+    qint64 maxCost() const;
+
+    int count() const;
+    qint64 totalCost() const;
+
+private:
+    struct Shard {
+        mutable QMutex mutex;
+        QCache<IconCacheKey, QImage> cache;
+    };
+
+    Shard &shardFor(const IconCacheKey &key) const;
+
+    mutable std::array<Shard, ShardCount> m_shards;
+};
+
+#endif // SHARDEDIMAGECACHE_H
@@ -35,6 +35,7 @@
 
 #ifndef QT_NO_ICON
 #include "xdgiconloader_p.h"
+#include "xdgiconmetrics.h"
 
 #include <private/qguiapplication_p.h>
 #include <private/qicon_p.h>
@@ -49,6 +50,8 @@
 #include <QtCore/QDir>
 #include <QtCore/QSettings>
 #include <QtCore/QStringView>
+#include <QtCore/QBuffer>
+#include <QtCore/QMutex>
 #include <QtGui/QPainter>
 #include <QImageReader>
 #include <QXmlStreamReader>
@@ -562,8 +565,15 @@ QThemeIconInfo XdgIconLoader::unthemedFallback(const QString &iconName, const QS
 
 QThemeIconInfo XdgIconLoader::loadIcon(const QString &name) const
 {
-    const QString theme_name = QIconLoader::instance()->themeName();
+    return loadIcon(name, QIconLoader::instance()->themeName());
+}
+
+QThemeIconInfo XdgIconLoader::loadIcon(const QString &name, const QString &themeName) const
+{
+    XdgIconMetrics::ScopedTimer timer(XdgIconMetrics::Resolve);
+    const QString theme_name = themeName.isEmpty() ? QIconLoader::instance()->themeName() : themeName;
     if (!theme_name.isEmpty()) {
+        QMutexLocker locker(&m_mutex);
         QStringList visited;
         auto info = findIconHelper(theme_name, name, visited, true);
         if (info.entries.empty()) {
@@ -588,21 +598,23 @@ QThemeIconInfo XdgIconLoader::loadIcon(const QString &name) const
     return QThemeIconInfo();
 }
 
-
 // -------- Icon Loader Engine -------- //
 
 
-XdgIconLoaderEngine::XdgIconLoaderEngine(const QString& iconName)
-        : m_iconName(iconName), m_key(0)
+XdgIconLoaderEngine::XdgIconLoaderEngine(const QString& iconName, const QString &themeName)
+        : m_iconName(iconName), m_themeName(themeName)
 {
 }
 
 XdgIconLoaderEngine::~XdgIconLoaderEngine() = default;
 
+// Clones share the already resolved icon, nothing is looked up again
+// until the theme generation changes.
 XdgIconLoaderEngine::XdgIconLoaderEngine(const XdgIconLoaderEngine &other)
         : QIconEngine(other),
+        m_resolved(other.resolved()),
         m_iconName(other.m_iconName),
-        m_key(0)
+        m_themeName(other.m_themeName)
 {
 }
 
@@ -611,29 +623,137 @@ QIconEngine *XdgIconLoaderEngine::clone() const
     return new XdgIconLoaderEngine(*this);
 }
 
+QString XdgIconLoaderEngine::effectiveThemeName() const
+{
+    return m_themeName.isEmpty() ? QIconLoader::instance()->themeName() : m_themeName;
+}
+
+// Kind of a serialized entry, see read() and write()
+enum XdgEntryKind : quint8 {
+    PixmapEntryKind = 0,
+    ScalableEntryKind = 1,
+    ScalableFollowsColorEntryKind = 2
+};
+
+/*
+ * Stream layout: icon name, theme override, then the resolved state: the
+ * theme it was resolved against, the resolved icon name and the entries
+ * (kind, file name and directory info). The entry count is 0 if the icon
+ * was never resolved, such icons are resolved lazily as before.
+ */
 bool XdgIconLoaderEngine::read(QDataStream &in) {
-    in >> m_iconName;
+    QString resolvedTheme;
+    QString resolvedName;
+    quint32 count = 0;
+    in >> m_iconName >> m_themeName >> resolvedTheme >> resolvedName >> count;
+    {
+        QMutexLocker locker(&m_resolvedMutex);
+        m_resolved.reset();
+    }
+    if (in.status() != QDataStream::Ok)
+        return false;
+
+    QThemeIconInfo info;
+    info.iconName = resolvedName;
+    for (quint32 i = 0; i < count; ++i) {
+        quint8 kind;
+        QString filename;
+        QString path;
+        qint16 size, minSize, maxSize, threshold, scale;
+        quint8 type;
+        in >> kind >> filename >> path >> size >> minSize >> maxSize >> threshold >> scale >> type;
+        if (in.status() != QDataStream::Ok)
+            return false;
+
+        std::unique_ptr<QIconLoaderEngineEntry> entry;
+        if (kind == PixmapEntryKind)
+            entry.reset(new PixmapEntry);
+        else if (kind == ScalableFollowsColorEntryKind && XdgIconLoader::instance()->followColorScheme())
+            entry.reset(new ScalableFollowsColorEntry);
+        else
+            entry.reset(new ScalableEntry);
+        entry->filename = filename;
+        entry->dir = QIconDirInfo(path);
+        entry->dir.size = size;
+        entry->dir.minSize = minSize;
+        entry->dir.maxSize = maxSize;
+        entry->dir.threshold = threshold;
+        entry->dir.scale = scale;
+        entry->dir.type = static_cast<QIconDirInfo::Type>(type);
+        info.entries.push_back(std::move(entry));
+    }
+
+    // Only come back hot if resolved against the theme that is in effect now
+    if (count > 0 && resolvedTheme == effectiveThemeName()) {
+        auto resolved = QSharedPointer<XdgResolvedIcon>::create();
+        resolved->info = std::move(info);
+        resolved->themeKey = QIconLoader::instance()->themeKey();
+        QMutexLocker locker(&m_resolvedMutex);
+        m_resolved = resolved;
+    }
     return true;
 }
 
 bool XdgIconLoaderEngine::write(QDataStream &out) const
 {
-    out << m_iconName;
+    out << m_iconName << m_themeName;
+
+    // Carry the resolved paths along if they are still current
+    const QSharedPointer<XdgResolvedIcon> resolved = this->resolved();
+    const bool current = resolved && resolved->themeKey == QIconLoader::instance()->themeKey();
+    if (!current) {
+        out << QString() << QString() << quint32(0);
+        return true;
+    }
+
+    const QThemeIconInfo &info = resolved->info;
+    out << effectiveThemeName() << info.iconName << quint32(info.entries.size());
+    for (const auto &entry : info.entries) {
+        quint8 kind = ScalableEntryKind;
+        if (dynamic_cast<ScalableFollowsColorEntry *>(entry.get()))
+            kind = ScalableFollowsColorEntryKind;
+        else if (dynamic_cast<PixmapEntry *>(entry.get()))
+            kind = PixmapEntryKind;
+        const QIconDirInfo &dir = entry->dir;
+        out << kind << entry->filename << dir.path
+            << qint16(dir.size) << qint16(dir.minSize) << qint16(dir.maxSize)
+            << qint16(dir.threshold) << qint16(dir.scale) << quint8(dir.type);
+    }
     return true;
 }
 
 bool XdgIconLoaderEngine::hasIcon() const
 {
-    return !(m_info.entries.empty());
+    const QSharedPointer<XdgResolvedIcon> resolved = this->resolved();
+    return resolved && !resolved->info.entries.empty();
 }
 
-// Lazily load the icon
-void XdgIconLoaderEngine::ensureLoaded()
+QSharedPointer<XdgResolvedIcon> XdgIconLoaderEngine::resolved() const
 {
-    if (QIconLoader::instance()->themeKey() != m_key) {
-        m_info = XdgIconLoader::instance()->loadIcon(m_iconName);
-        m_key = QIconLoader::instance()->themeKey();
-    }
+    QMutexLocker locker(&m_resolvedMutex);
+    return m_resolved;
+}
+
+// Lazily load the icon, the returned reference stays valid even if another
+// thread swaps m_resolved meanwhile
+QSharedPointer<XdgResolvedIcon> XdgIconLoaderEngine::ensureLoaded()
+{
+    const uint themeKey = QIconLoader::instance()->themeKey();
+    QSharedPointer<XdgResolvedIcon> current = resolved();
+    if (current && current->themeKey == themeKey)
+        return current;
+
+    // Resolve without holding the lock, the lookup may hit the disk
+    auto loaded = QSharedPointer<XdgResolvedIcon>::create();
+    loaded->info = XdgIconLoader::instance()->loadIcon(m_iconName, m_themeName);
+    loaded->themeKey = themeKey;
+
+    QMutexLocker locker(&m_resolvedMutex);
+    // Keep what another thread resolved first, it may already be rendered
+    if (m_resolved && m_resolved->themeKey == themeKey)
+        return m_resolved;
+    m_resolved = loaded;
+    return loaded;
 }
 
 void XdgIconLoaderEngine::paint(QPainter *painter, const QRect &rect,
@@ -738,9 +858,9 @@ QSize XdgIconLoaderEngine::actualSize(const QSize &size, QIcon::Mode mode,
     Q_UNUSED(mode);
     Q_UNUSED(state);
 
-    ensureLoaded();
+    const QSharedPointer<XdgResolvedIcon> resolved = ensureLoaded();
 
-    QIconLoaderEngineEntry *entry = entryForSize(m_info, size);
+    QIconLoaderEngineEntry *entry = entryForSize(resolved->info, size);
     if (entry) {
         const QIconDirInfo &dir = entry->dir;
         if (dir.type == QIconDirInfo::Scalable
@@ -755,6 +875,7 @@ QSize XdgIconLoaderEngine::actualSize(const QSize &size, QIcon::Mode mode,
             PixmapEntry * pix_e;
             if (0 == dir_size && nullptr != (pix_e = dynamic_cast<PixmapEntry *>(entry)))
             {
+                QMutexLocker locker(&resolved->renderMutex);
                 QSize pix_size = pix_e->basePixmap.size();
                 dir_size = qMin(pix_size.width(), pix_size.height());
             }
@@ -765,6 +886,134 @@ QSize XdgIconLoaderEngine::actualSize(const QSize &size, QIcon::Mode mode,
     return {0, 0};
 }
 
+/*!
+    \class XdgIconImageStore
+    \internal
+    Process wide store of decoded pixmap icon files (PNG, XPM), keyed by the
+    file name and its modification time. Every PixmapEntry (of every engine
+    and every clone) referring to the same file shares one implicitly shared
+    pixmap instead of decoding and keeping its own full resolution copy.
+    Files are decoded straight from a read-only memory mapping, the decoded
+    image is handed to QPixmap in place, so no intermediate buffer is kept.
+    Entries nobody but the store references any more are dropped periodically.
+*/
+class XdgIconImageStore
+{
+public:
+    QPixmap pixmap(const QString &fileName);
+    int count();
+    qint64 bytes();
+
+private:
+    static QImage decode(const QString &fileName);
+    void prune();
+
+    struct Entry
+    {
+        QDateTime lastModified;
+        QPixmap pixmap;
+    };
+
+    QMutex m_mutex;
+    QHash<QString, Entry> m_entries;
+    int m_insertsSincePrune = 0;
+};
+Q_GLOBAL_STATIC(XdgIconImageStore, iconImageStore)
+
+// Number of insertions after which unreferenced entries are dropped
+static const int IMAGE_STORE_PRUNE_INTERVAL = 64;
+
+QImage XdgIconImageStore::decode(const QString &fileName)
+{
+    XdgIconMetrics::ScopedTimer timer(XdgIconMetrics::Decode);
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return QImage();
+
+    const QByteArray format = QFileInfo(fileName).suffix().toLower().toLatin1();
+    const qint64 size = file.size();
+    uchar *data = size > 0 ? file.map(0, size) : nullptr;
+    if (!data) {
+        // mapping is not possible on every file system, use buffered reads then
+        QImageReader reader(&file, format);
+        return reader.read();
+    }
+
+    QByteArray bytes = QByteArray::fromRawData(reinterpret_cast<const char *>(data), size);
+    QBuffer buffer(&bytes);
+    buffer.open(QIODevice::ReadOnly);
+    QImageReader reader(&buffer, format);
+    QImage image = reader.read();
+    buffer.close();
+    file.unmap(data);
+    return image;
+}
+
+QPixmap XdgIconImageStore::pixmap(const QString &fileName)
+{
+    const QDateTime lastModified = QFileInfo(fileName).lastModified();
+    {
+        QMutexLocker locker(&m_mutex);
+        const auto it = m_entries.constFind(fileName);
+        if (it != m_entries.cend() && it->lastModified == lastModified)
+            return it->pixmap;
+    }
+
+    // Decode outside of the lock, concurrent loaders may decode different files
+    QPixmap pm = QPixmap::fromImage(decode(fileName));
+    if (pm.isNull())
+        return pm;
+
+    QMutexLocker locker(&m_mutex);
+    if (++m_insertsSincePrune >= IMAGE_STORE_PRUNE_INTERVAL)
+        prune();
+
+    Entry &entry = m_entries[fileName];
+    // Another thread may have stored the very same file meanwhile, share that one
+    if (entry.lastModified != lastModified || entry.pixmap.isNull()) {
+        entry.lastModified = lastModified;
+        entry.pixmap = pm;
+    }
+    return entry.pixmap;
+}
+
+int XdgIconImageStore::count()
+{
+    QMutexLocker locker(&m_mutex);
+    return m_entries.size();
+}
+
+qint64 XdgIconImageStore::bytes()
+{
+    QMutexLocker locker(&m_mutex);
+    qint64 total = 0;
+    for (const Entry &entry : std::as_const(m_entries))
+        total += qint64(entry.pixmap.width()) * entry.pixmap.height() * entry.pixmap.depth() / 8;
+    return total;
+}
+
+void XdgIconImageStore::prune()
+{
+    m_insertsSincePrune = 0;
+    for (auto it = m_entries.begin(); it != m_entries.end(); ) {
+        // Only the store holds the pixmap, every entry using it is gone
+        if (it->pixmap.isDetached())
+            it = m_entries.erase(it);
+        else
+            ++it;
+    }
+}
+
+int XdgIconLoader::sharedImageCount() const
+{
+    return iconImageStore()->count();
+}
+
+qint64 XdgIconLoader::sharedImageBytes() const
+{
+    return iconImageStore()->bytes();
+}
+
 // XXX: duplicated from qiconloader.cpp, because this symbol isn't exported :(
 #if (QT_VERSION >= QT_VERSION_CHECK(6,8,0))
 QPixmap PixmapEntry::pixmap(const QSize &size, QIcon::Mode mode, QIcon::State state, qreal scale)
@@ -775,16 +1024,23 @@ QPixmap PixmapEntry::pixmap(const QSize &size, QIcon::Mode mode, QIcon::State st
     Q_UNUSED(state);
 
     // Ensure that basePixmap is lazily initialized before generating the
-    // key, otherwise the cache key is not unique
+    // key, otherwise the cache key is not unique. The pixmap is shared with
+    // all other entries of the same file through the image store.
     if (basePixmap.isNull())
-        basePixmap.load(filename);
+        basePixmap = iconImageStore()->pixmap(filename);
 
     // see QPixmapIconEngine::adjustSize
     QSize actualSize = basePixmap.size();
+#if (QT_VERSION >= QT_VERSION_CHECK(6,8,0))
+    // size is in device independent pixels, the limit is in device pixels
+    const QSize maxSize = size * scale;
+#else
+    const QSize maxSize = size;
+#endif
     // If the size of the best match we have (basePixmap) is larger than the
     // requested size, we downscale it to match.
-    if (!actualSize.isNull() && (actualSize.width() > size.width() || actualSize.height() > size.height()))
-        actualSize.scale(size, Qt::KeepAspectRatio);
+    if (!actualSize.isNull() && (actualSize.width() > maxSize.width() || actualSize.height() > maxSize.height()))
+        actualSize.scale(maxSize, Qt::KeepAspectRatio);
 
 #if (QT_VERSION >= QT_VERSION_CHECK(6,8,0))
     // see QIconPrivate::pixmapDevicePixelRatio
@@ -823,12 +1079,16 @@ QPixmap PixmapEntry::pixmap(const QSize &size, QIcon::Mode mode, QIcon::State st
     if (QPixmapCache::find(key, &cachedPixmap)) {
         return cachedPixmap;
     } else {
-        if (basePixmap.size() != actualSize)
+        if (basePixmap.size() != actualSize) {
+            XdgIconMetrics::ScopedTimer timer(XdgIconMetrics::Rasterize);
             cachedPixmap = basePixmap.scaled(actualSize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
-        else
+        } else {
             cachedPixmap = basePixmap;
-        if (QGuiApplication *guiApp = qobject_cast<QGuiApplication *>(qApp))
+        }
+        if (QGuiApplication *guiApp = qobject_cast<QGuiApplication *>(qApp)) {
+            XdgIconMetrics::ScopedTimer timer(XdgIconMetrics::ModeEffect);
             cachedPixmap = static_cast<QGuiApplicationPrivate*>(QObjectPrivate::get(guiApp))->applyQIconStyleHelper(mode, cachedPixmap);
+        }
 #if (QT_VERSION >= QT_VERSION_CHECK(6,8,0))
         cachedPixmap.setDevicePixelRatio(calculatedDpr);
 #endif
@@ -876,8 +1136,14 @@ QPixmap ScalableEntry::pixmap(const QSize &size, QIcon::Mode mode, QIcon::State
         pm.fill(Qt::transparent);
 
         QSvgRenderer renderer;
-        if (renderer.load(filename))
+        bool loaded;
         {
+            XdgIconMetrics::ScopedTimer timer(XdgIconMetrics::SvgParse);
+            loaded = renderer.load(filename);
+        }
+        if (loaded)
+        {
+            XdgIconMetrics::ScopedTimer timer(XdgIconMetrics::Rasterize);
             QPainter p;
             p.begin(&pm);
             renderer.render(&p, QRect(0, 0, icnSize, icnSize));
@@ -885,12 +1151,15 @@ QPixmap ScalableEntry::pixmap(const QSize &size, QIcon::Mode mode, QIcon::State
         }
 
         svgIcon = QIcon(pm);
+        {
+            XdgIconMetrics::ScopedTimer timer(XdgIconMetrics::ModeEffect);
 #if (QT_VERSION >= QT_VERSION_CHECK(6,8,0))
-        pm = svgIcon.pixmap(size, scale, mode, state);
+            pm = svgIcon.pixmap(size, scale, mode, state);
 #else
-        if (QIconEngine *engine = svgIcon.data_ptr() ? svgIcon.data_ptr()->engine : nullptr)
-            pm = engine->pixmap(size, mode, state);
+            if (QIconEngine *engine = svgIcon.data_ptr() ? svgIcon.data_ptr()->engine : nullptr)
+                pm = engine->pixmap(size, mode, state);
 #endif
+        }
         QPixmapCache::insert(key, pm);
     }
 
@@ -966,6 +1235,10 @@ QPixmap ScalableFollowsColorEntry::pixmap(const QSize &size, QIcon::Mode mode, Q
         QFile device{filename};
         if (device.open(QIODevice::ReadOnly))
         {
+            // The recoloring rewrite is part of getting the document ready
+            // to render, it is accounted to SvgParse together with load()
+            QElapsedTimer parseTimer;
+            parseTimer.start();
             QString styleSheet = STYLE.arg(txtCol, bgCol, hCol);
             QByteArray svgBuffer;
             QXmlStreamWriter writer(&svgBuffer);
@@ -999,6 +1272,8 @@ QPixmap ScalableFollowsColorEntry::pixmap(const QSize &size, QIcon::Mode mode, Q
             {
                 QSvgRenderer renderer;
                 renderer.load(svgBuffer);
+                XdgIconMetrics::record(XdgIconMetrics::SvgParse, parseTimer.nsecsElapsed());
+                XdgIconMetrics::ScopedTimer timer(XdgIconMetrics::Rasterize);
                 QPainter p;
                 p.begin(&pm);
                 renderer.render(&p, QRect(0, 0, icnSize, icnSize));
@@ -1010,12 +1285,15 @@ QPixmap ScalableFollowsColorEntry::pixmap(const QSize &size, QIcon::Mode mode, Q
         // for QIcon::pixmap() to handle states and modes,
         // especially the disabled mode.
         svgIcon = QIcon(pm);
+        {
+            XdgIconMetrics::ScopedTimer timer(XdgIconMetrics::ModeEffect);
 #if (QT_VERSION >= QT_VERSION_CHECK(6,8,0))
-        pm = svgIcon.pixmap(size, scale, mode, state);
+            pm = svgIcon.pixmap(size, scale, mode, state);
 #else
-        if (QIconEngine *engine = svgIcon.data_ptr() ? svgIcon.data_ptr()->engine : nullptr)
-            pm = engine->pixmap(size, mode, state);
+            if (QIconEngine *engine = svgIcon.data_ptr() ? svgIcon.data_ptr()->engine : nullptr)
+                pm = engine->pixmap(size, mode, state);
 #endif
+        }
         QPixmapCache::insert(key, pm);
     }
 
@@ -1030,45 +1308,61 @@ QPixmap XdgIconLoaderEngine::pixmap(const QSize &size, QIcon::Mode mode,
 
 QString XdgIconLoaderEngine::key() const
 {
-    return "XdgIconLoaderEngine"_L1;
+    // Must match the plugin key, QIcon's stream operator looks the engine up by it
+    return "DeckXdgIconLoaderEngine"_L1;
 }
 
 QString XdgIconLoaderEngine::iconName()
 {
-    ensureLoaded();
-    return m_info.iconName;
+    return ensureLoaded()->info.iconName;
 }
 
 bool XdgIconLoaderEngine::isNull()
 {
-    ensureLoaded();
-    return m_info.entries.empty();
+    return ensureLoaded()->info.entries.empty();
 }
 
 QPixmap XdgIconLoaderEngine::scaledPixmap(const QSize &size, QIcon::Mode mode, QIcon::State state, qreal scale)
 {
-    ensureLoaded();
+    const QSharedPointer<XdgResolvedIcon> resolved = ensureLoaded();
     const int integerScale = qCeil(scale);
+    // The entry fills its render state on first use, clones share it
+    QMutexLocker locker(&resolved->renderMutex);
 #if (QT_VERSION >= QT_VERSION_CHECK(6,8,0))
-    QIconLoaderEngineEntry *entry = entryForSize(m_info, size, integerScale);
+    QIconLoaderEngineEntry *entry = entryForSize(resolved->info, size, integerScale);
     return entry ? entry->pixmap(size, mode, state, scale) : QPixmap();
 #else
-    QIconLoaderEngineEntry *entry = entryForSize(m_info, size / integerScale, integerScale);
+    QIconLoaderEngineEntry *entry = entryForSize(resolved->info, size / integerScale, integerScale);
     return entry ? entry->pixmap(size, mode, state) : QPixmap();
 #endif
 }
 
+QString XdgIconLoaderEngine::fileName(const QSize &size, qreal scale)
+{
+    // Picks the entry the same way scaledPixmap() does
+    const QSharedPointer<XdgResolvedIcon> resolved = ensureLoaded();
+    const int integerScale = qCeil(scale);
+    QMutexLocker locker(&resolved->renderMutex);
+#if (QT_VERSION >= QT_VERSION_CHECK(6,8,0))
+    const QIconLoaderEngineEntry *entry = entryForSize(resolved->info, size, integerScale);
+#else
+    const QIconLoaderEngineEntry *entry = entryForSize(resolved->info, size / integerScale, integerScale);
+#endif
+    return entry ? entry->filename : QString();
+}
+
 QList<QSize> XdgIconLoaderEngine::availableSizes(QIcon::Mode mode, QIcon::State state)
 {
     Q_UNUSED(mode);
     Q_UNUSED(state);
-    ensureLoaded();
-    const int N = m_info.entries.size();
+    const QSharedPointer<XdgResolvedIcon> resolved = ensureLoaded();
+    const QThemeIconInfo &info = resolved->info;
+    const int N = info.entries.size();
     QList<QSize> sizes;
     sizes.reserve(N);
 
     // Gets all sizes from the DirectoryInfo entries
-    for (const auto &entry : m_info.entries) {
+    for (const auto &entry : info.entries) {
         if (entry->dir.type == QIconDirInfo::Fallback) {
             sizes.append(QIcon(entry->filename).availableSizes());
         } else {
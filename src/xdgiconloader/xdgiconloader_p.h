@@ -56,6 +56,8 @@
 #include <private/qiconloader_p.h>
 #include <QtCore/QHash>
 #include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QSharedPointer>
 
 //QT_BEGIN_NAMESPACE
 
@@ -71,11 +73,29 @@ struct ScalableFollowsColorEntry : public QIconLoaderEngineEntry
     QIcon svgIcon;
 };
 
+/*!
+ * Result of resolving an icon name against a theme. Once created the set of
+ * entries is never changed, an engine and all its clones share it (reference
+ * counted) for as long as the theme generation (QIconLoader::themeKey()) it
+ * was resolved in is current.
+ *
+ * The entries still fill their render state lazily on first use
+ * (PixmapEntry::basePixmap, the svgIcon of the scalable entries). Clones
+ * may be used on different threads, so entries are only rendered or
+ * inspected with renderMutex held.
+ */
+struct XdgResolvedIcon
+{
+    QThemeIconInfo info;
+    uint themeKey = 0;
+    QMutex renderMutex;
+};
+
 //class QIconLoaderEngine : public QIconEngine
 class XDGICONLOADER_EXPORT XdgIconLoaderEngine : public QIconEngine
 {
 public:
-    XdgIconLoaderEngine(const QString& iconName = QString());
+    XdgIconLoaderEngine(const QString& iconName = QString(), const QString &themeName = QString());
     ~XdgIconLoaderEngine() override;
 
     void paint(QPainter *painter, const QRect &rect, QIcon::Mode mode, QIcon::State state) override;
@@ -90,15 +110,27 @@ public:
     QPixmap scaledPixmap(const QSize &size, QIcon::Mode mode, QIcon::State state, qreal scale) override;
     QList<QSize> availableSizes(QIcon::Mode mode, QIcon::State state) override;
 
+    /*!
+     * File scaledPixmap() renders from at \a size and \a scale, or an empty
+     * string if the name doesn't resolve. Picked from the entries already
+     * resolved, nothing is looked up again.
+     */
+    QString fileName(const QSize &size, qreal scale);
+
 private:
     QString key() const override;
     bool hasIcon() const;
-    void ensureLoaded();
-    QIconLoaderEngineEntry *entryForSize(const QThemeIconInfo &info, const QSize &size, int scale = 1);
+    QSharedPointer<XdgResolvedIcon> resolved() const;
+    QSharedPointer<XdgResolvedIcon> ensureLoaded();
+    static QIconLoaderEngineEntry *entryForSize(const QThemeIconInfo &info, const QSize &size, int scale = 1);
     XdgIconLoaderEngine(const XdgIconLoaderEngine &other);
-    QThemeIconInfo m_info;
+    QString effectiveThemeName() const;
+    // Clones are used on different threads, m_resolved is swapped under m_resolvedMutex
+    mutable QMutex m_resolvedMutex;
+    QSharedPointer<XdgResolvedIcon> m_resolved;
     QString m_iconName;
-    uint m_key;
+    // Explicit theme to resolve against; empty means the current QIcon::themeName()
+    QString m_themeName;
 
     friend class XdgIconLoader;
 };
@@ -131,6 +163,13 @@ class XDGICONLOADER_EXPORT XdgIconLoader
 {
 public:
     QThemeIconInfo loadIcon(const QString &iconName) const;
+    /*!
+     * Resolves \a iconName against the explicitly named \a themeName instead
+     * of the current QIcon::themeName(). Parsed theme data is kept per theme,
+     * so resolving against a preview theme does not discard the state of the
+     * active one. An empty \a themeName behaves like loadIcon(iconName).
+     */
+    QThemeIconInfo loadIcon(const QString &iconName, const QString &themeName) const;
 
     /* TODO: deprecate & remove all QIconLoader wrappers */
     inline uint themeKey() const { return QIconLoader::instance()->themeKey(); }
@@ -150,7 +189,15 @@ public:
     inline bool followColorScheme() const { return m_followColorScheme; }
     void setFollowColorScheme(bool enable);
 
+    /*!
+     * Number of decoded pixmap icon files (and their pixel bytes) currently
+     * shared between all engines and clones referring to the same file.
+     */
+    int sharedImageCount() const;
+    qint64 sharedImageBytes() const;
+
     XdgIconTheme theme() { return themeList.value(QIconLoader::instance()->themeName()); }
+    XdgIconTheme theme(const QString &themeName) { return themeList.value(themeName); }
     static XdgIconLoader *instance();
 
 private:
@@ -160,6 +207,8 @@ private:
                                   bool dashFallback = false) const;
     QThemeIconInfo unthemedFallback(const QString &iconName, const QStringList &searchPaths) const;
     mutable QHash <QString, XdgIconTheme> themeList;
+    // Serializes lookups, icons are also resolved from worker threads
+    mutable QMutex m_mutex;
     bool m_followColorScheme = true;
 };
 
@@ -0,0 +1,149 @@
+/* BEGIN_COMMON_COPYRIGHT_HEADER
+ * (c)LGPL2+
+ *
+ * LXQt - a lightweight, Qt based, desktop toolset
+ * https://lxqt.org
+ *
+ * Copyright: 2025 LXQt team
+ * Authors:
+ *   LXQt team
+ *
+ * This program or library is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ *
+ * END_COMMON_COPYRIGHT_HEADER */
+
+// clazy:excludeall=non-pod-global-static
+
+#include "xdgiconmetrics.h"
+
+#include <QtCore/QAtomicInteger>
+
+#include <algorithm>
+
+namespace {
+struct StageHistogram
+{
+    QAtomicInteger<quint64> totalNanoseconds;
+    std::array<QAtomicInteger<quint64>, XdgIconMetrics::BucketCount> buckets;
+};
+}
+
+// Zero initialized at load time, no construction order issues
+static std::array<StageHistogram, XdgIconMetrics::StageCount> s_histograms;
+
+static int bucketForNanoseconds(qint64 nanoseconds)
+{
+    const quint64 micros = nanoseconds > 0 ? quint64(nanoseconds) / 1000 : 0;
+    if (micros == 0)
+        return 0;
+    // [2^(i-1), 2^i) µs lands in bucket i
+    const int bits = 64 - qCountLeadingZeroBits(micros);
+    return std::min(bits, XdgIconMetrics::BucketCount - 1);
+}
+
+void XdgIconMetrics::record(Stage stage, qint64 nanoseconds)
+{
+    if (stage < 0 || stage >= StageCount)
+        return;
+    StageHistogram &histogram = s_histograms[stage];
+    histogram.buckets[bucketForNanoseconds(nanoseconds)].fetchAndAddRelaxed(1);
+    histogram.totalNanoseconds.fetchAndAddRelaxed(quint64(std::max<qint64>(nanoseconds, 0)));
+}
+
+XdgIconMetrics::Snapshot XdgIconMetrics::snapshot(Stage stage)
+{
+    Snapshot result;
+    result.stage = stage;
+    if (stage < 0 || stage >= StageCount)
+        return result;
+
+    const StageHistogram &histogram = s_histograms[stage];
+    for (int i = 0; i < BucketCount; ++i) {
+        result.buckets[i] = histogram.buckets[i].loadRelaxed();
+        result.count += result.buckets[i];
+    }
+    result.totalNanoseconds = histogram.totalNanoseconds.loadRelaxed();
+    return result;
+}
+
+QList<XdgIconMetrics::Snapshot> XdgIconMetrics::snapshots()
+{
+    QList<Snapshot> result;
+    result.reserve(StageCount);
+    for (int stage = 0; stage < StageCount; ++stage)
+        result.append(snapshot(static_cast<Stage>(stage)));
+    return result;
+}
+
+void XdgIconMetrics::reset()
+{
+    for (StageHistogram &histogram : s_histograms) {
+        for (auto &bucket : histogram.buckets)
+            bucket.storeRelaxed(0);
+        histogram.totalNanoseconds.storeRelaxed(0);
+    }
+}
+
+QString XdgIconMetrics::stageName(Stage stage)
+{
+    switch (stage) {
+    case Resolve:
+        return QStringLiteral("resolve");
+    case Decode:
+        return QStringLiteral("decode");
+    case SvgParse:
+        return QStringLiteral("svgParse");
+    case Rasterize:
+        return QStringLiteral("rasterize");
+    case ModeEffect:
+        return QStringLiteral("modeEffect");
+    default:
+        return QString();
+    }
+}
+
+double XdgIconMetrics::bucketLowerBound(int bucket)
+{
+    if (bucket <= 0)
+        return 0.0;
+    return double(quint64(1) << (bucket - 1));
+}
+
+double XdgIconMetrics::Snapshot::percentile(double q) const
+{
+    if (count == 0)
+        return 0.0;
+
+    const double target = std::clamp(q, 0.0, 1.0) * double(count);
+    quint64 cumulative = 0;
+    for (int i = 0; i < BucketCount; ++i) {
+        if (buckets[i] == 0)
+            continue;
+        if (double(cumulative + buckets[i]) >= target) {
+            const double lower = bucketLowerBound(i);
+            const double upper = i == 0 ? 1.0 : lower * 2.0;
+            const double fraction = (target - double(cumulative)) / double(buckets[i]);
+            return lower + fraction * (upper - lower);
+        }
+        cumulative += buckets[i];
+    }
+    return bucketLowerBound(BucketCount - 1) * 2.0;
+}
+
+double XdgIconMetrics::Snapshot::meanMicroseconds() const
+{
+    return count > 0 ? double(totalNanoseconds) / double(count) / 1000.0 : 0.0;
+}
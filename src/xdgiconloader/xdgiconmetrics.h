@@ -0,0 +1,114 @@
+/* BEGIN_COMMON_COPYRIGHT_HEADER
+ * (c)LGPL2+
+ *
+ * LXQt - a lightweight, Qt based, desktop toolset
+ * https://lxqt.org
+ *
+ * Copyright: 2025 LXQt team
+ * Authors:
+ *   LXQt team
+ *
+ * This program or library is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ *
+ * END_COMMON_COPYRIGHT_HEADER */
+
+#ifndef XDGICONMETRICS_H
+#define XDGICONMETRICS_H
+
+#include <xdgiconloader_export.h>
+
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QList>
+#include <QtCore/QString>
+
+#include <array>
+
+/*!
+ * \brief Built-in latency histograms of the icon pipeline
+ *
+ * XdgIconLoader and XdgIconLoaderEngine record how long each stage of
+ * turning an icon name into pixels takes. Every stage has a histogram with
+ * fixed log2 scale buckets in microseconds: bucket 0 counts samples below
+ * 1 µs, bucket i (i > 0) counts samples in [2^(i-1), 2^i) µs and the last
+ * bucket everything above. Recording is a handful of relaxed atomic
+ * increments, no locks are taken.
+ *
+ * Usage:
+ * \code
+ * const XdgIconMetrics::Snapshot resolve = XdgIconMetrics::snapshot(XdgIconMetrics::Resolve);
+ * qDebug() << "resolve p95" << resolve.percentile(0.95) << "us";
+ * \endcode
+ */
+class XDGICONLOADER_EXPORT XdgIconMetrics
+{
+public:
+    enum Stage {
+        Resolve = 0,    ///< Theme lookup of an icon name (XdgIconLoader::loadIcon)
+        Decode,         ///< Decoding a PNG/XPM file
+        SvgParse,       ///< Loading (and recoloring) an SVG document
+        Rasterize,      ///< Rendering an SVG or scaling a pixmap to the requested size
+        ModeEffect,     ///< Applying the QIcon::Mode (disabled, selected, ...) effect
+        StageCount
+    };
+
+    static constexpr int BucketCount = 24;
+
+    struct Snapshot {
+        Stage stage = Resolve;
+        quint64 count = 0;
+        quint64 totalNanoseconds = 0;
+        std::array<quint64, BucketCount> buckets{};
+
+        /*!
+         * \brief Estimated latency in microseconds at quantile \a q (0.0 - 1.0)
+         *
+         * Interpolates linearly inside the bucket the quantile falls in.
+         */
+        double percentile(double q) const;
+        double meanMicroseconds() const;
+    };
+
+    static void record(Stage stage, qint64 nanoseconds);
+    static Snapshot snapshot(Stage stage);
+    static QList<Snapshot> snapshots();
+    static void reset();
+
+    static QString stageName(Stage stage);
+
+    /*!
+     * \brief Lower bound (inclusive) of \a bucket in microseconds
+     */
+    static double bucketLowerBound(int bucket);
+
+    /*!
+     * \brief Records the lifetime of the scope into \a stage
+     */
+    class ScopedTimer
+    {
+    public:
+        explicit ScopedTimer(Stage stage) : m_stage(stage) { m_timer.start(); }
+        ~ScopedTimer() { record(m_stage, m_timer.nsecsElapsed()); }
+
+        ScopedTimer(const ScopedTimer &) = delete;
+        ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+    private:
+        Stage m_stage;
+        QElapsedTimer m_timer;
+    };
+};
+
+#endif // XDGICONMETRICS_H
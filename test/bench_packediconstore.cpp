@@ -0,0 +1,426 @@
+/* BEGIN_COMMON_COPYRIGHT_HEADER
+ * (c)LGPL2+
+ *
+ * LXQt - a lightweight, Qt based, desktop toolset
+ * https://lxqt.org
+ *
+ * Copyright: 2025 LXQt team
+ * Authors:
+ *   LXQt team
+ *
+ * This program or library is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ *
+ * END_COMMON_COPYRIGHT_HEADER */
+
+#include <QObject>
+
+#include "packediconstore.h"
+
+#include <QBuffer>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QImage>
+#include <QMutex>
+#include <QRandomGenerator>
+#include <QTemporaryDir>
+#include <QTest>
+#include <QThread>
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+/*
+ * L3 store inserts with a full cache, every insert evicts.
+ *
+ * Compares the clock sweep of PackedIconStore::evict() against the
+ * previous eviction, which summed all entry sizes on every save and sorted
+ * all entries by access time whenever the cache was over budget. The old
+ * eviction is quadratic, it is run with a tenth of the entries.
+ *
+ * Loader threads hitting and filling the store, either holding the lock
+ * for the whole load or save, as DiskIconCache used to, or only around the
+ * index steps.
+ *
+ * Bytes on disk and decode time of one icon per entry codec, compared to
+ * the PNG files DiskIconCache wrote before.
+ *
+ * Stores sharing one directory, each wanting every icon and rendering the
+ * ones no other store has saved yet. Enough saves to checkpoint the
+ * journal, so the other stores reload meanwhile.
+ */
+
+static const int ENTRY_COUNT = 100000;
+static const int SORTED_ENTRY_COUNT = ENTRY_COUNT / 10;
+
+// Cache budget in entries, a fifth of what is inserted
+static const int BUDGET_DIVISOR = 5;
+
+static const int THREAD_COUNT = 8;
+static const int CONCURRENT_KEY_COUNT = 2048;
+static const int OPERATIONS_PER_THREAD = 20000;
+
+// One in this many operations is a save, the rest are loads
+static const int SAVE_RATIO = 5;
+
+static const int SHARED_STORE_COUNT = 4;
+static const int SHARED_KEY_COUNT = 20000;
+
+class bench_packediconstore : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+
+    void benchmarkInsertSortedEviction();
+    void benchmarkInsertClockEviction();
+
+    void benchmarkConcurrentSerialized();
+    void benchmarkConcurrentSplit();
+
+    void benchmarkDecode_data();
+    void benchmarkDecode();
+
+    void benchmarkSharedWriters();
+
+private:
+    qint64 recordBytes();
+    static QImage makeIcon(int size);
+
+    template<typename Load, typename Save>
+    void runLoaders(const char *name, Load load, Save save);
+
+    QImage m_image;
+    QImage m_iconImage;
+};
+
+void bench_packediconstore::initTestCase()
+{
+    m_image = QImage(8, 8, QImage::Format_ARGB32_Premultiplied);
+    m_image.fill(Qt::blue);
+
+    m_iconImage = QImage(32, 32, QImage::Format_ARGB32_Premultiplied);
+    m_iconImage.fill(Qt::red);
+}
+
+qint64 bench_packediconstore::recordBytes()
+{
+    QTemporaryDir dir;
+    PackedIconStore store(dir.path());
+    store.open();
+    store.insert(1, m_image);
+    return store.liveBytes();
+}
+
+void bench_packediconstore::benchmarkInsertSortedEviction()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    PackedIconStore store(dir.path());
+    QVERIFY(store.open());
+
+    const qint64 budget = recordBytes() * (SORTED_ENTRY_COUNT / BUDGET_DIVISOR);
+    int evicted = 0;
+
+    QElapsedTimer timer;
+    timer.start();
+    QBENCHMARK_ONCE {
+        for (int i = 0; i < SORTED_ENTRY_COUNT; ++i) {
+            store.insert(quint64(i) * 0x9E3779B97F4A7C15ull, m_image);
+
+            QList<PackedIconStore::EntryInfo> entries = store.entries();
+            qint64 size = 0;
+            for (const PackedIconStore::EntryInfo &entry : std::as_const(entries))
+                size += entry.length;
+            if (size <= budget)
+                continue;
+
+            std::sort(entries.begin(), entries.end(),
+                      [](const PackedIconStore::EntryInfo &a, const PackedIconStore::EntryInfo &b) {
+                return a.lastAccessed < b.lastAccessed;
+            });
+            qint64 freed = 0;
+            for (const PackedIconStore::EntryInfo &entry : std::as_const(entries)) {
+                if (freed >= size - budget)
+                    break;
+                store.remove(entry.id);
+                freed += entry.length;
+                evicted++;
+            }
+        }
+    }
+    const qint64 elapsed = timer.nsecsElapsed();
+
+    qDebug() << "sorted:" << SORTED_ENTRY_COUNT << "inserts," << evicted << "evictions,"
+             << qRound64(SORTED_ENTRY_COUNT * 1e9 / qMax<qint64>(elapsed, 1)) << "inserts/s";
+}
+
+void bench_packediconstore::benchmarkInsertClockEviction()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    PackedIconStore store(dir.path());
+    QVERIFY(store.open());
+
+    const qint64 budget = recordBytes() * (ENTRY_COUNT / BUDGET_DIVISOR);
+    int evicted = 0;
+
+    QElapsedTimer timer;
+    timer.start();
+    QBENCHMARK_ONCE {
+        for (int i = 0; i < ENTRY_COUNT; ++i) {
+            store.insert(quint64(i) * 0x9E3779B97F4A7C15ull, m_image);
+
+            // Hit every tenth entry again so the clock has something to spare
+            if (i % 10 == 0)
+                store.find(quint64(i / 2) * 0x9E3779B97F4A7C15ull);
+
+            if (store.liveBytes() > budget) {
+                int count = 0;
+                store.evict(store.liveBytes() - budget, &count);
+                evicted += count;
+            }
+        }
+    }
+    const qint64 elapsed = timer.nsecsElapsed();
+
+    QVERIFY(store.liveBytes() <= budget);
+    qDebug() << "clock:" << ENTRY_COUNT << "inserts," << evicted << "evictions,"
+             << qRound64(ENTRY_COUNT * 1e9 / qMax<qint64>(elapsed, 1)) << "inserts/s";
+}
+
+template<typename Load, typename Save>
+void bench_packediconstore::runLoaders(const char *name, Load load, Save save)
+{
+    QAtomicInteger<qint64> checksum = 0;
+    std::vector<std::unique_ptr<QThread>> threads;
+
+    QElapsedTimer timer;
+    timer.start();
+    QBENCHMARK_ONCE {
+        for (int t = 0; t < THREAD_COUNT; ++t) {
+            threads.emplace_back(QThread::create([&]() {
+                QRandomGenerator random(QRandomGenerator::global()->generate());
+                qint64 sum = 0;
+                for (int i = 0; i < OPERATIONS_PER_THREAD; ++i) {
+                    const quint64 id = random.bounded(CONCURRENT_KEY_COUNT) + 1;
+                    if (i % SAVE_RATIO == 0) {
+                        save(id, m_iconImage);
+                        continue;
+                    }
+                    // Read the pixels, a hit is only done once they are paged in
+                    const QImage image = load(id);
+                    if (!image.isNull())
+                        sum += image.constBits()[image.sizeInBytes() - 1];
+                }
+                checksum += sum;
+            }));
+            threads.back()->start();
+        }
+        for (auto &thread : threads)
+            thread->wait();
+    }
+    const qint64 elapsed = timer.nsecsElapsed();
+
+    const qint64 operations = qint64(THREAD_COUNT) * OPERATIONS_PER_THREAD;
+    qDebug() << name << THREAD_COUNT << "threads:"
+             << qRound64(operations * 1e9 / qMax<qint64>(elapsed, 1)) << "ops/s"
+             << "checksum" << checksum.loadRelaxed();
+}
+
+void bench_packediconstore::benchmarkConcurrentSerialized()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    PackedIconStore store(dir.path());
+    QVERIFY(store.open());
+    for (int i = 1; i <= CONCURRENT_KEY_COUNT; ++i)
+        store.insert(i, m_iconImage);
+
+    // The lock covers the whole load or save, including the file I/O
+    QMutex mutex;
+    runLoaders("serialized", [&](quint64 id) {
+        QMutexLocker locker(&mutex);
+        QImage image = store.find(id);
+        return image.isNull() ? image : image.copy();
+    }, [&](quint64 id, const QImage &image) {
+        QMutexLocker locker(&mutex);
+        store.insert(id, image);
+    });
+}
+
+void bench_packediconstore::benchmarkConcurrentSplit()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    PackedIconStore store(dir.path());
+    QVERIFY(store.open());
+    for (int i = 1; i <= CONCURRENT_KEY_COUNT; ++i)
+        store.insert(i, m_iconImage);
+
+    // The lock covers the index steps only, as in DiskIconCache
+    QMutex mutex;
+    runLoaders("split", [&](quint64 id) {
+        PackedIconStore::Location location;
+        {
+            QMutexLocker locker(&mutex);
+            if (!store.locate(id, &location))
+                return QImage();
+        }
+        return PackedIconStore::imageAt(location);
+    }, [&](quint64 id, const QImage &image) {
+        PackedIconStore::PendingWrite write;
+        if (!PackedIconStore::prepare(id, image, &write))
+            return;
+        {
+            QMutexLocker locker(&mutex);
+            if (!store.reserve(&write))
+                return;
+        }
+        const bool written = PackedIconStore::writeRecord(write);
+        QMutexLocker locker(&mutex);
+        store.commit(write, written);
+    });
+}
+
+QImage bench_packediconstore::makeIcon(int size)
+{
+    // A shaded disc on a transparent background, compresses like real icons
+    QImage image(size, size, QImage::Format_ARGB32_Premultiplied);
+    const double radius = size / 2.0;
+    for (int y = 0; y < size; ++y) {
+        QRgb *line = reinterpret_cast<QRgb *>(image.scanLine(y));
+        for (int x = 0; x < size; ++x) {
+            const double dx = x + 0.5 - radius;
+            const double dy = y + 0.5 - radius;
+            const double alpha = qBound(0.0, radius - 1 - std::sqrt(dx * dx + dy * dy), 1.0);
+            const int shade = 96 + (159 * y) / size;
+            line[x] = qPremultiply(qRgba(shade / 2, shade, 255 - shade / 3, qRound(alpha * 255)));
+        }
+    }
+    return image;
+}
+
+void bench_packediconstore::benchmarkDecode_data()
+{
+    QTest::addColumn<QString>("codec");
+    QTest::addColumn<int>("size");
+
+    for (int size : {32, 48, 64}) {
+        QTest::addRow("png-%d", size) << QStringLiteral("png") << size;
+        QTest::addRow("raw-%d", size) << QStringLiteral("raw") << size;
+        if (PackedIconStore::isCodecAvailable(PackedIconStore::CodecLz4))
+            QTest::addRow("lz4-%d", size) << QStringLiteral("lz4") << size;
+    }
+}
+
+void bench_packediconstore::benchmarkDecode()
+{
+    QFETCH(QString, codec);
+    QFETCH(int, size);
+
+    const QImage icon = makeIcon(size);
+    qint64 checksum = 0;
+
+    if (codec == QLatin1String("png")) {
+        QByteArray png;
+        QBuffer buffer(&png);
+        buffer.open(QIODevice::WriteOnly);
+        QVERIFY(icon.save(&buffer, "PNG"));
+        qDebug() << "png" << size << "px:" << png.size() << "bytes";
+
+        // Decode and convert, as loadFromDisk did
+        QBENCHMARK {
+            const QImage image = QImage::fromData(png, "PNG")
+                .convertToFormat(QImage::Format_ARGB32_Premultiplied);
+            checksum += image.constBits()[image.sizeInBytes() - 1];
+        }
+        return;
+    }
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    PackedIconStore store(dir.path());
+    QVERIFY(store.open());
+    QVERIFY(store.insert(1, icon, codec == QLatin1String("lz4")
+                         ? PackedIconStore::CodecLz4 : PackedIconStore::CodecRaw));
+    qDebug() << codec << size << "px:" << store.liveBytes() << "bytes";
+
+    QBENCHMARK {
+        const QImage image = store.find(1, false);
+        checksum += image.constBits()[image.sizeInBytes() - 1];
+    }
+    QVERIFY(checksum >= 0);
+}
+
+void bench_packediconstore::benchmarkSharedWriters()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    // One store per thread stands in for one process, flock() locks of
+    // separate opens of the lock file exclude each other in one process too
+    std::vector<std::unique_ptr<PackedIconStore>> stores;
+    for (int t = 0; t < SHARED_STORE_COUNT; ++t) {
+        stores.push_back(std::make_unique<PackedIconStore>(dir.path(), true));
+        QVERIFY(stores.back()->open());
+    }
+
+    QAtomicInteger<int> hits = 0;
+    std::vector<std::unique_ptr<QThread>> threads;
+
+    QElapsedTimer timer;
+    timer.start();
+    QBENCHMARK_ONCE {
+        for (int t = 0; t < SHARED_STORE_COUNT; ++t) {
+            threads.emplace_back(QThread::create([&, t]() {
+                PackedIconStore &store = *stores[t];
+                int found = 0;
+                for (int i = 0; i < SHARED_KEY_COUNT; ++i) {
+                    // All stores want all keys, starting at different ones
+                    const quint64 id = quint64((i + t * SHARED_KEY_COUNT / SHARED_STORE_COUNT)
+                                               % SHARED_KEY_COUNT) + 1;
+                    if (!store.find(id, false).isNull())
+                        found++;
+                    else
+                        store.insert(id, m_image);
+                }
+                hits += found;
+            }));
+            threads.back()->start();
+        }
+        for (auto &thread : threads)
+            thread->wait();
+    }
+    const qint64 elapsed = timer.nsecsElapsed();
+
+    for (auto &store : stores)
+        store->flush();
+
+    // A store opened afterwards sees what all of them saved
+    PackedIconStore reader(dir.path(), true);
+    QVERIFY(reader.open());
+    QCOMPARE(reader.count(), SHARED_KEY_COUNT);
+
+    const qint64 lookups = qint64(SHARED_STORE_COUNT) * SHARED_KEY_COUNT;
+    qDebug() << "shared:" << SHARED_STORE_COUNT << "stores," << hits.loadRelaxed() << "hits of"
+             << lookups << "lookups," << qRound64(lookups * 1e9 / qMax<qint64>(elapsed, 1)) << "ops/s";
+}
+
+QTEST_MAIN(bench_packediconstore)
+#include "bench_packediconstore.moc"
@@ -0,0 +1,179 @@
+/* BEGIN_COMMON_COPYRIGHT_HEADER
+ * (c)LGPL2+
+ *
+ * LXQt - a lightweight, Qt based, desktop toolset
+ * https://lxqt.org
+ *
+ * Copyright: 2025 LXQt team
+ * Authors:
+ *   LXQt team
+ *
+ * This program or library is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ *
+ * END_COMMON_COPYRIGHT_HEADER */
+
+#include <QObject>
+
+#include "shardedimagecache.h"
+
+#include <QAtomicInt>
+#include <QCache>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QImage>
+#include <QMutex>
+#include <QRandomGenerator>
+#include <QTest>
+#include <QThread>
+
+#include <memory>
+#include <vector>
+
+/*
+ * GUI thread L2 hit throughput while loader threads keep inserting.
+ *
+ * Compares ShardedImageCache against the previous single mutex QCache
+ * with string keys that handed out a heap allocated QImage copy per hit.
+ */
+
+static const int KEY_COUNT = 512;
+static const int WRITER_COUNT = 4;
+static const int LOOKUPS_PER_ROUND = 100000;
+
+class SingleMutexImageCache
+{
+public:
+    SingleMutexImageCache() { m_cache.setMaxCost(128 * 1024 * 1024); }
+
+    QImage *find(const QString &key)
+    {
+        QMutexLocker locker(&m_mutex);
+        QImage *cached = m_cache.object(key);
+        return cached ? new QImage(*cached) : nullptr;
+    }
+
+    void insert(const QString &key, const QImage &image)
+    {
+        QMutexLocker locker(&m_mutex);
+        m_cache.insert(key, new QImage(image), image.sizeInBytes());
+    }
+
+private:
+    QMutex m_mutex;
+    QCache<QString, QImage> m_cache;
+};
+
+class bench_shardedimagecache : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+
+    void benchmarkSingleMutexHits();
+    void benchmarkShardedHits();
+
+private:
+    template<typename Insert>
+    void startWriters(Insert insert);
+    void stopWriters();
+
+    QStringList m_keys;
+    QList<IconCacheKey> m_cacheKeys;
+    QImage m_image;
+    QAtomicInt m_stop{0};
+    std::vector<std::unique_ptr<QThread>> m_writers;
+};
+
+void bench_shardedimagecache::initTestCase()
+{
+    for (int i = 0; i < KEY_COUNT; ++i) {
+        m_keys << QStringLiteral("icon-%1@48x48s0").arg(i);
+        m_cacheKeys << IconCacheKey(QStringLiteral("icon-%1").arg(i), QSize(48, 48), 0);
+    }
+
+    m_image = QImage(48, 48, QImage::Format_ARGB32_Premultiplied);
+    m_image.fill(Qt::blue);
+}
+
+template<typename Insert>
+void bench_shardedimagecache::startWriters(Insert insert)
+{
+    m_stop.storeRelaxed(0);
+    for (int i = 0; i < WRITER_COUNT; ++i) {
+        m_writers.emplace_back(QThread::create([this, insert]() {
+            QRandomGenerator random(QRandomGenerator::global()->generate());
+            while (!m_stop.loadRelaxed())
+                insert(random.bounded(KEY_COUNT), m_image);
+        }));
+        m_writers.back()->start();
+    }
+}
+
+void bench_shardedimagecache::stopWriters()
+{
+    m_stop.storeRelaxed(1);
+    for (auto &writer : m_writers)
+        writer->wait();
+    m_writers.clear();
+}
+
+void bench_shardedimagecache::benchmarkSingleMutexHits()
+{
+    SingleMutexImageCache cache;
+    for (const QString &key : std::as_const(m_keys))
+        cache.insert(key, m_image);
+
+    startWriters([this, &cache](int index, const QImage &image) { cache.insert(m_keys.at(index), image); });
+
+    qint64 hits = 0;
+    QElapsedTimer timer;
+    timer.start();
+    QBENCHMARK {
+        for (int i = 0; i < LOOKUPS_PER_ROUND; ++i) {
+            std::unique_ptr<QImage> image(cache.find(m_keys.at(i % KEY_COUNT)));
+            hits += image ? 1 : 0;
+        }
+    }
+    const qint64 elapsed = timer.nsecsElapsed();
+
+    stopWriters();
+    qDebug() << "single mutex:" << qRound64(hits * 1e9 / qMax<qint64>(elapsed, 1)) << "hits/s";
+}
+
+void bench_shardedimagecache::benchmarkShardedHits()
+{
+    ShardedImageCache cache(128 * 1024 * 1024);
+    for (const IconCacheKey &key : std::as_const(m_cacheKeys))
+        cache.insert(key, m_image);
+
+    startWriters([this, &cache](int index, const QImage &image) { cache.insert(m_cacheKeys.at(index), image); });
+
+    qint64 hits = 0;
+    QElapsedTimer timer;
+    timer.start();
+    QBENCHMARK {
+        for (int i = 0; i < LOOKUPS_PER_ROUND; ++i)
+            hits += cache.find(m_cacheKeys.at(i % KEY_COUNT)).isNull() ? 0 : 1;
+    }
+    const qint64 elapsed = timer.nsecsElapsed();
+
+    stopWriters();
+    qDebug() << "sharded:" << qRound64(hits * 1e9 / qMax<qint64>(elapsed, 1)) << "hits/s";
+}
+
+QTEST_MAIN(bench_shardedimagecache)
+#include "bench_shardedimagecache.moc"
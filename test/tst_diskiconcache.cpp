@@ -0,0 +1,240 @@
+/* BEGIN_COMMON_COPYRIGHT_HEADER
+ * (c)LGPL2+
+ *
+ * LXQt - a lightweight, Qt based, desktop toolset
+ * https://lxqt.org
+ *
+ * Copyright: 2025 LXQt team
+ * Authors:
+ *   LXQt team
+ *
+ * This program or library is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ *
+ * END_COMMON_COPYRIGHT_HEADER */
+
+#include <QObject>
+
+#include "diskiconcache.h"
+#include "cachedtexturefactory.h"
+
+#include <QColor>
+#include <QDateTime>
+#include <QFile>
+#include <QImage>
+#include <QMutexLocker>
+#include <QSemaphore>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QTest>
+#include <QTimer>
+
+#include <utime.h>
+
+using namespace Qt::Literals::StringLiterals;
+
+class tst_diskiconcache : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+    void cleanup();
+    void testSourceModified();
+    void testSaveLaterCoalesced();
+    void testSaveLaterBounded();
+    void testSaveLaterFlushedOnExit();
+
+private:
+    static IconCacheKey key(int n);
+    static QColor color(int n);
+    static QImage image(int n, int side = 16);
+    static bool setModified(const QString &path, const QDateTime &modified);
+    void blockWriter();
+    void releaseWriter();
+
+    DiskIconCache *m_cache = nullptr;
+    QSemaphore m_writerBlocked;
+    bool m_writerHeld = false;
+};
+
+IconCacheKey tst_diskiconcache::key(int n)
+{
+    // An explicit theme, the test has no QGuiApplication to ask
+    return IconCacheKey(u"tst-diskiconcache-%1"_s.arg(n), QSize(16, 16), 0, 1.0, u"hicolor"_s);
+}
+
+QColor tst_diskiconcache::color(int n)
+{
+    return QColor(n * 20 % 256, 255 - n * 20 % 256, 128);
+}
+
+QImage tst_diskiconcache::image(int n, int side)
+{
+    QImage result(side, side, CachedTextureFactory::UploadFormat);
+    result.fill(color(n));
+    return result;
+}
+
+bool tst_diskiconcache::setModified(const QString &path, const QDateTime &modified)
+{
+    struct utimbuf times;
+    times.actime = modified.toSecsSinceEpoch();
+    times.modtime = modified.toSecsSinceEpoch();
+    return ::utime(QFile::encodeName(path).constData(), &times) == 0;
+}
+
+void tst_diskiconcache::blockWriter()
+{
+    // Keeps the idle timer from flushing the queue behind the test's back
+    QSemaphore *blocked = &m_writerBlocked;
+    QMetaObject::invokeMethod(m_cache->m_writer, [blocked]() { blocked->acquire(); },
+                              Qt::QueuedConnection);
+    m_writerHeld = true;
+}
+
+void tst_diskiconcache::releaseWriter()
+{
+    if (m_writerHeld) {
+        m_writerBlocked.release();
+        m_writerHeld = false;
+    }
+}
+
+void tst_diskiconcache::initTestCase()
+{
+    // Keep away from the user's cache
+    QStandardPaths::setTestModeEnabled(true);
+    qunsetenv("QTXDG_SHARED_ICON_CACHE");
+}
+
+void tst_diskiconcache::init()
+{
+    m_cache = new DiskIconCache;
+    QVERIFY(m_cache->isEnabled());
+    m_cache->clearCache();
+}
+
+void tst_diskiconcache::cleanup()
+{
+    releaseWriter();
+    delete m_cache;
+    m_cache = nullptr;
+}
+
+void tst_diskiconcache::testSourceModified()
+{
+    QTemporaryDir theme;
+    QTemporaryDir otherTheme;
+    QVERIFY(theme.isValid());
+    QVERIFY(otherTheme.isValid());
+
+    QVERIFY(m_cache->saveToDisk(key(1), image(1), theme.filePath(u"first.png"_s)));
+    QVERIFY(m_cache->saveToDisk(key(2), image(2), theme.filePath(u"second.png"_s)));
+    QVERIFY(m_cache->saveToDisk(key(3), image(3), otherTheme.filePath(u"third.png"_s)));
+
+    // One stat per directory, whatever number of icons it holds
+    QCOMPARE(m_cache->checkedDirectoryCount(), 2);
+    QCOMPARE(m_cache->loadFromDisk(key(1)).pixelColor(8, 8), color(1));
+    QCOMPARE(m_cache->checkedDirectoryCount(), 2);
+
+    // What a package upgrade renaming new files into the directory does
+    QVERIFY(setModified(theme.path(), QDateTime::currentDateTime().addSecs(-3600)));
+
+    // Stat'ed once per session, the change isn't seen yet
+    QVERIFY(!m_cache->loadFromDisk(key(1)).isNull());
+
+    // The next session stats again
+    {
+        QMutexLocker locker(&m_cache->m_sourceMutex);
+        m_cache->m_sourceDirectories.clear();
+    }
+    QVERIFY(m_cache->loadFromDisk(key(1)).isNull());
+    QVERIFY(m_cache->loadFromDisk(key(2)).isNull());
+    QCOMPARE(m_cache->loadFromDisk(key(3)).pixelColor(8, 8), color(3));
+    QCOMPARE(m_cache->staleEntryCount(), qint64(2));
+    QCOMPARE(m_cache->checkedDirectoryCount(), 2);
+
+    // Stale hits are dropped, not checked again
+    QCOMPARE(m_cache->getCacheCount(), 1);
+}
+
+void tst_diskiconcache::testSaveLaterCoalesced()
+{
+    blockWriter();
+    m_cache->saveLater(key(1), image(1));
+    m_cache->saveLater(key(1), image(2));
+    m_cache->saveLater(key(3), image(3));
+    QCOMPARE(m_cache->pendingSaveCount(), 2);
+
+    // Served from the queue before it is written, the newer image won
+    QCOMPARE(m_cache->loadFromDisk(key(1)).pixelColor(8, 8), color(2));
+    QCOMPARE(m_cache->getCacheCount(), 0);
+
+    m_cache->flushPendingSaves();
+    QCOMPARE(m_cache->pendingSaveCount(), 0);
+    QCOMPARE(m_cache->getCacheCount(), 2);
+    QCOMPARE(m_cache->loadFromDisk(key(1)).pixelColor(8, 8), color(2));
+    QCOMPARE(m_cache->loadFromDisk(key(3)).pixelColor(8, 8), color(3));
+    QCOMPARE(m_cache->droppedSaveCount(), qint64(0));
+}
+
+void tst_diskiconcache::testSaveLaterBounded()
+{
+    blockWriter();
+
+    // 1MB images, two more than the queue holds
+    const int side = 512;
+    const int fitting = int(DiskIconCache::MaxPendingSaveBytes / image(0, side).sizeInBytes());
+    QVERIFY(fitting + 2 < DiskIconCache::SaveBatchSize);
+    for (int n = 1; n <= fitting + 2; ++n) {
+        m_cache->saveLater(key(n), image(n, side));
+    }
+    QCOMPARE(m_cache->pendingSaveCount(), fitting);
+    QCOMPARE(m_cache->droppedSaveCount(), qint64(2));
+
+    // The oldest went first
+    QVERIFY(m_cache->loadFromDisk(key(1)).isNull());
+    QVERIFY(m_cache->loadFromDisk(key(2)).isNull());
+    QCOMPARE(m_cache->loadFromDisk(key(3)).pixelColor(8, 8), color(3));
+
+    m_cache->flushPendingSaves();
+    QCOMPARE(m_cache->pendingSaveCount(), 0);
+    QCOMPARE(m_cache->getCacheCount(), fitting);
+    QVERIFY(m_cache->loadFromDisk(key(1)).isNull());
+    QCOMPARE(m_cache->loadFromDisk(key(fitting + 2)).pixelColor(8, 8), color(fitting + 2));
+}
+
+void tst_diskiconcache::testSaveLaterFlushedOnExit()
+{
+    blockWriter();
+    for (int n = 1; n <= 3; ++n) {
+        m_cache->saveLater(key(n), image(n));
+    }
+    QCOMPARE(m_cache->pendingSaveCount(), 3);
+
+    // Nothing queued is lost on the way out
+    releaseWriter();
+    delete m_cache;
+    m_cache = new DiskIconCache;
+    QCOMPARE(m_cache->getCacheCount(), 3);
+    for (int n = 1; n <= 3; ++n) {
+        QCOMPARE(m_cache->loadFromDisk(key(n)).pixelColor(8, 8), color(n));
+    }
+}
+
+QTEST_GUILESS_MAIN(tst_diskiconcache)
+#include "tst_diskiconcache.moc"
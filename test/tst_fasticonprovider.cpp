@@ -0,0 +1,149 @@
+/* BEGIN_COMMON_COPYRIGHT_HEADER
+ * (c)LGPL2+
+ *
+ * LXQt - a lightweight, Qt based, desktop toolset
+ * https://lxqt.org
+ *
+ * Copyright: 2025 LXQt team
+ * Authors:
+ *   LXQt team
+ *
+ * This program or library is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ *
+ * END_COMMON_COPYRIGHT_HEADER */
+
+#include <QObject>
+
+#include "fasticonprovider.h"
+#include "diskiconcache.h"
+
+#include <QDir>
+#include <QFile>
+#include <QIcon>
+#include <QImage>
+#include <QQuickImageResponse>
+#include <QSignalSpy>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include <memory>
+
+using namespace Qt::Literals::StringLiterals;
+
+class tst_fasticonprovider : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void testPreloadYieldsToRequest();
+    void testPreloadSharesLoad();
+
+private:
+    static constexpr int IconCount = 64;
+
+    QTemporaryDir m_iconsDir;
+};
+
+void tst_fasticonprovider::initTestCase()
+{
+    // Keep the disk cache and usage statistics out of the user's cache
+    QStandardPaths::setTestModeEnabled(true);
+
+    QVERIFY(m_iconsDir.isValid());
+    const QString themeDir = m_iconsDir.path() + "/tst-theme"_L1;
+    QVERIFY(QDir().mkpath(themeDir + "/32x32/apps"_L1));
+
+    QFile index(themeDir + "/index.theme"_L1);
+    QVERIFY(index.open(QIODevice::WriteOnly));
+    index.write("[Icon Theme]\n"
+                "Name=Test\n"
+                "Directories=32x32/apps\n"
+                "\n"
+                "[32x32/apps]\n"
+                "Size=32\n"
+                "Type=Fixed\n");
+    index.close();
+
+    QImage image(32, 32, QImage::Format_ARGB32);
+    image.fill(Qt::red);
+    for (int i = 0; i < IconCount; ++i) {
+        QVERIFY(image.save(themeDir + "/32x32/apps/tst-preload-%1.png"_L1.arg(i)));
+    }
+    QVERIFY(image.save(themeDir + "/32x32/apps/tst-interactive.png"_L1));
+    QVERIFY(image.save(themeDir + "/32x32/apps/tst-shared.png"_L1));
+
+    // Nothing warm started from an earlier run
+    qputenv("QTXDG_ICON_WARM_START_KB", "0");
+
+    QIcon::setThemeSearchPaths(QStringList() << m_iconsDir.path());
+    QIcon::setThemeName(u"tst-theme"_s);
+}
+
+void tst_fasticonprovider::testPreloadYieldsToRequest()
+{
+    FastIconProvider provider;
+    provider.setAutoPreloadEnabled(false);
+
+    // One rasterizing thread: a preload chunk holding it while it waits
+    // for the request would never let the request run
+    provider.setMaxThreadCount(1);
+
+    QStringList iconNames;
+    for (int i = 0; i < IconCount; ++i) {
+        iconNames.append(u"tst-preload-%1"_s.arg(i));
+    }
+    QFuture<int> preload = provider.preloadIcons(iconNames, QSize(32, 32));
+    QVERIFY(preload.isValid());
+
+    std::unique_ptr<QQuickImageResponse> response(
+        provider.requestImageResponse(u"tst-interactive?size=32x32"_s, QSize()));
+    QSignalSpy finished(response.get(), &QQuickImageResponse::finished);
+
+    QTRY_COMPARE_WITH_TIMEOUT(finished.count(), 1, 10000);
+    QVERIFY(response->errorString().isEmpty());
+    std::unique_ptr<QQuickTextureFactory> factory(response->textureFactory());
+    QVERIFY(factory);
+    QVERIFY(!factory->image().isNull());
+
+    QTRY_VERIFY_WITH_TIMEOUT(preload.isFinished(), 10000);
+    QCOMPARE(preload.result(), IconCount);
+}
+
+void tst_fasticonprovider::testPreloadSharesLoad()
+{
+    DiskIconCache::instance()->clearCache();
+    FastIconProvider provider;
+    provider.setAutoPreloadEnabled(false);
+
+    std::unique_ptr<QQuickImageResponse> response(
+        provider.requestImageResponse(u"tst-shared?size=32x32"_s, QSize()));
+    QSignalSpy finished(response.get(), &QQuickImageResponse::finished);
+    QFuture<int> preload = provider.preloadIcons(QStringList() << u"tst-shared"_s, QSize(32, 32));
+    QVERIFY(preload.isValid());
+
+    QTRY_COMPARE_WITH_TIMEOUT(finished.count(), 1, 10000);
+    QVERIFY(response->errorString().isEmpty());
+    QTRY_VERIFY_WITH_TIMEOUT(preload.isFinished(), 10000);
+    QCOMPARE(preload.result(), 1);
+
+    // Whichever came first, the other one joined it or found it in L2
+    QCOMPARE(provider.cacheStats().loadCount, 1);
+}
+
+QTEST_MAIN(tst_fasticonprovider)
+#include "tst_fasticonprovider.moc"
@@ -0,0 +1,103 @@
+/* BEGIN_COMMON_COPYRIGHT_HEADER
+ * (c)LGPL2+
+ *
+ * LXQt - a lightweight, Qt based, desktop toolset
+ * https://lxqt.org
+ *
+ * Copyright: 2025 LXQt team
+ * Authors:
+ *   LXQt team
+ *
+ * This program or library is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ *
+ * END_COMMON_COPYRIGHT_HEADER */
+
+#include <QObject>
+
+#include "iconcachekey.h"
+
+#include <QHash>
+#include <QTest>
+
+using namespace Qt::Literals::StringLiterals;
+
+class tst_iconcachekey : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testFields();
+    void testEquality();
+    void testScale();
+    void testInvalid();
+    void testPersistentId();
+};
+
+void tst_iconcachekey::testFields()
+{
+    const IconCacheKey key(u"document-open"_s, QSize(48, 24), 3, 2.0, u"Papirus"_s);
+    QVERIFY(key.isValid());
+    QCOMPARE(key.iconName(), u"document-open"_s);
+    QCOMPARE(key.themeName(), u"Papirus"_s);
+    QCOMPARE(key.size(), QSize(48, 24));
+    QCOMPARE(key.state(), 3);
+    QCOMPARE(key.scale(), 2.0);
+}
+
+void tst_iconcachekey::testEquality()
+{
+    const IconCacheKey a(u"folder"_s, QSize(32, 32), 0, 1.0, u"breeze"_s);
+    const IconCacheKey b(u"folder"_s, QSize(32, 32), 0, 1.0, u"breeze"_s);
+    QCOMPARE(a, b);
+    QCOMPARE(qHash(a), qHash(b));
+
+    QVERIFY(a != IconCacheKey(u"folder"_s, QSize(32, 32), 1, 1.0, u"breeze"_s));
+    QVERIFY(a != IconCacheKey(u"folder"_s, QSize(32, 32), 0, 1.0, u"Papirus"_s));
+    QVERIFY(a != IconCacheKey(u"folder-open"_s, QSize(32, 32), 0, 1.0, u"breeze"_s));
+    QVERIFY(a != IconCacheKey(u"folder"_s, QSize(32, 24), 0, 1.0, u"breeze"_s));
+}
+
+void tst_iconcachekey::testScale()
+{
+    // Quarter steps, anything finer maps to the nearest step
+    QCOMPARE(IconCacheKey(u"folder"_s, QSize(16, 16), 0, 1.25, u"breeze"_s).scale(), 1.25);
+    QCOMPARE(IconCacheKey(u"folder"_s, QSize(16, 16), 0, 1.3, u"breeze"_s).scale(), 1.25);
+    QCOMPARE(IconCacheKey(u"folder"_s, QSize(16, 16), 0, 0.0, u"breeze"_s).scale(), 0.25);
+}
+
+void tst_iconcachekey::testInvalid()
+{
+    QVERIFY(!IconCacheKey().isValid());
+    QVERIFY(!IconCacheKey(QString(), QSize(16, 16), 0, 1.0, u"breeze"_s).isValid());
+    QVERIFY(!IconCacheKey(u"folder"_s, QSize(4096, 16), 0, 1.0, u"breeze"_s).isValid());
+    QVERIFY(!IconCacheKey(u"folder"_s, QSize(16, 16), 4, 1.0, u"breeze"_s).isValid());
+    QCOMPARE(IconCacheKey().persistentId(), quint64(0));
+}
+
+void tst_iconcachekey::testPersistentId()
+{
+    // Derived from the names, not from the interned ids
+    const IconCacheKey late(u"tst-late-name"_s, QSize(64, 64), 0, 1.0, u"tst-late-theme"_s);
+    const IconCacheKey other(u"tst-other-name"_s, QSize(64, 64), 0, 1.0, u"tst-late-theme"_s);
+
+    QVERIFY(late.persistentId() != 0);
+    QVERIFY(late.persistentId() != other.persistentId());
+    QCOMPARE(late.persistentId(),
+             IconCacheKey(u"tst-late-name"_s, QSize(64, 64), 0, 1.0, u"tst-late-theme"_s).persistentId());
+}
+
+QTEST_GUILESS_MAIN(tst_iconcachekey)
+#include "tst_iconcachekey.moc"
@@ -0,0 +1,198 @@
+/* BEGIN_COMMON_COPYRIGHT_HEADER
+ * (c)LGPL2+
+ *
+ * LXQt - a lightweight, Qt based, desktop toolset
+ * https://lxqt.org
+ *
+ * Copyright: 2025 LXQt team
+ * Authors:
+ *   LXQt team
+ *
+ * This program or library is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ *
+ * END_COMMON_COPYRIGHT_HEADER */
+
+#include <QObject>
+
+#include "iconsequencepredictor.h"
+
+#include <QFile>
+#include <QStandardPaths>
+#include <QStringList>
+#include <QTest>
+
+using namespace Qt::Literals::StringLiterals;
+
+using IconRequest = IconSequencePredictor::IconRequest;
+
+class tst_iconsequencepredictor : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+    void testMinObservations();
+    void testMinConfidence();
+    void testObserveSequences();
+    void testFollowerPruning();
+    void testModelRoundTrip();
+
+private:
+    static IconRequest request(const QString &iconName);
+    static QList<IconRequest> requests(const QStringList &iconNames);
+    static QStringList names(const QList<IconRequest> &requests);
+    static QString key(const QString &iconName);
+    static void endSequence();
+};
+
+IconRequest tst_iconsequencepredictor::request(const QString &iconName)
+{
+    return IconRequest{iconName, QSize(48, 48), 0};
+}
+
+QList<IconRequest> tst_iconsequencepredictor::requests(const QStringList &iconNames)
+{
+    QList<IconRequest> result;
+    for (const QString &iconName : iconNames) {
+        result.append(request(iconName));
+    }
+    return result;
+}
+
+QStringList tst_iconsequencepredictor::names(const QList<IconRequest> &requests)
+{
+    QStringList result;
+    for (const IconRequest &request : requests) {
+        result.append(request.iconName);
+    }
+    return result;
+}
+
+QString tst_iconsequencepredictor::key(const QString &iconName)
+{
+    return IconSequencePredictor::requestKey(iconName, QSize(48, 48), 0);
+}
+
+void tst_iconsequencepredictor::endSequence()
+{
+    QTest::qWait(IconSequencePredictor::SequenceGapMs + 50);
+}
+
+void tst_iconsequencepredictor::initTestCase()
+{
+    // Keep the model file out of the user's cache
+    QStandardPaths::setTestModeEnabled(true);
+}
+
+void tst_iconsequencepredictor::init()
+{
+    IconSequencePredictor predictor;
+    predictor.clearModel();
+}
+
+void tst_iconsequencepredictor::testMinObservations()
+{
+    IconSequencePredictor predictor;
+    predictor.learn(key(u"trigger"_s), requests({u"a"_s, u"b"_s}));
+    QVERIFY(predictor.predict(key(u"trigger"_s)).isEmpty());
+
+    predictor.learn(key(u"trigger"_s), requests({u"a"_s}));
+    QCOMPARE(names(predictor.predict(key(u"trigger"_s))), QStringList({u"a"_s, u"b"_s}));
+}
+
+void tst_iconsequencepredictor::testMinConfidence()
+{
+    IconSequencePredictor predictor;
+    predictor.learn(key(u"trigger"_s), requests({u"a"_s, u"b"_s}));
+    predictor.learn(key(u"trigger"_s), requests({u"a"_s, u"c"_s}));
+    predictor.learn(key(u"trigger"_s), requests({u"a"_s, u"d"_s}));
+
+    // Three sequences: an icon must have followed in two of them
+    QCOMPARE(names(predictor.predict(key(u"trigger"_s))), QStringList({u"a"_s}));
+
+    predictor.learn(key(u"trigger"_s), requests({u"b"_s}));
+    QCOMPARE(names(predictor.predict(key(u"trigger"_s))), QStringList({u"a"_s, u"b"_s}));
+}
+
+void tst_iconsequencepredictor::testObserveSequences()
+{
+    IconSequencePredictor predictor;
+    const QSize size(48, 48);
+
+    QVERIFY(predictor.observe(u"trigger"_s, size, 0).isEmpty());
+    QVERIFY(predictor.observe(u"a"_s, size, 0).isEmpty());
+    QVERIFY(predictor.observe(u"b"_s, size, 0).isEmpty());
+    endSequence();
+
+    // The first sequence is learned now, one observation is not enough
+    QVERIFY(predictor.observe(u"trigger"_s, size, 0).isEmpty());
+    QVERIFY(predictor.observe(u"a"_s, size, 0).isEmpty());
+    endSequence();
+
+    QCOMPARE(names(predictor.observe(u"trigger"_s, size, 0)), QStringList({u"a"_s, u"b"_s}));
+    predictor.observe(u"a"_s, size, 0);
+
+    const IconSequencePredictor::Stats stats = predictor.stats();
+    QCOMPARE(stats.sequencesObserved, qint64(2));
+    QCOMPARE(stats.predictionsIssued, qint64(1));
+    QCOMPARE(stats.predictedIcons, qint64(2));
+    QCOMPARE(stats.predictedHits, qint64(1));
+}
+
+void tst_iconsequencepredictor::testFollowerPruning()
+{
+    IconSequencePredictor predictor;
+    for (int i = 0; i < 3; ++i) {
+        predictor.learn(key(u"trigger"_s), requests({u"keep"_s}));
+    }
+
+    // One more than twice the limit, counting "keep"
+    QStringList noise;
+    for (int i = 0; i < 2 * IconSequencePredictor::MaxSequenceLength; ++i) {
+        noise.append(u"noise-%1"_s.arg(i));
+    }
+    predictor.learn(key(u"trigger"_s), requests(noise));
+
+    const IconSequencePredictor::Trigger trigger = predictor.m_model.value(key(u"trigger"_s));
+    QCOMPARE(trigger.followers.size(), qsizetype(IconSequencePredictor::MaxSequenceLength));
+    QVERIFY(trigger.followers.contains(key(u"keep"_s)));
+    QCOMPARE(trigger.followers.value(key(u"keep"_s)).count, 3);
+}
+
+void tst_iconsequencepredictor::testModelRoundTrip()
+{
+    QStringList expected;
+    {
+        IconSequencePredictor predictor;
+        predictor.learn(key(u"trigger"_s), requests({u"a"_s, u"b"_s}));
+        predictor.learn(key(u"trigger"_s), requests({u"a"_s}));
+        expected = names(predictor.predict(key(u"trigger"_s)));
+        predictor.saveModel();
+        QVERIFY(QFile::exists(predictor.m_modelFilePath));
+    }
+    QCOMPARE(expected, QStringList({u"a"_s, u"b"_s}));
+
+    IconSequencePredictor reloaded;
+    QCOMPARE(reloaded.m_model.size(), qsizetype(1));
+    const QList<IconRequest> predicted = reloaded.predict(key(u"trigger"_s));
+    QCOMPARE(names(predicted), expected);
+    QCOMPARE(predicted.first().size, QSize(48, 48));
+    QCOMPARE(predicted.first().state, 0);
+}
+
+QTEST_GUILESS_MAIN(tst_iconsequencepredictor)
+#include "tst_iconsequencepredictor.moc"
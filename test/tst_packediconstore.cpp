@@ -0,0 +1,546 @@
+/* BEGIN_COMMON_COPYRIGHT_HEADER
+ * (c)LGPL2+
+ *
+ * LXQt - a lightweight, Qt based, desktop toolset
+ * https://lxqt.org
+ *
+ * Copyright: 2025 LXQt team
+ * Authors:
+ *   LXQt team
+ *
+ * This program or library is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ *
+ * END_COMMON_COPYRIGHT_HEADER */
+
+#include <QObject>
+
+#include "packediconstore.h"
+#include "cachedtexturefactory.h"
+
+#include <QColor>
+#include <QFile>
+#include <QFileInfo>
+#include <QImage>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include <memory>
+
+using namespace Qt::Literals::StringLiterals;
+
+class tst_packediconstore : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init();
+    void testPrivateStoreLocked();
+    void testJournalReplay();
+    void testTornJournalTail_data();
+    void testTornJournalTail();
+    void testSnapshotAndJournal();
+    void testSnapshotOnly();
+    void testMissingSegment();
+    void testShortRecord();
+    void testCompaction();
+    void testCompactionBatchRace();
+    void testSharedCatchUp();
+    void testSharedCheckpointReload();
+    void testSharedTornTail();
+    void testNamespaceOrder();
+    void testNamespaceReclaim();
+    void testNamespaceDroppedCommit();
+    void testNamespaceReactivate();
+
+private:
+    static QImage image(quint64 id);
+    static bool hasImage(PackedIconStore *store, quint64 id);
+    static void crash(PackedIconStore *store);
+
+    QString journalPath() const { return m_dir->path() + "/index.journal"_L1; }
+    QString indexPath() const { return m_dir->path() + "/index.bin"_L1; }
+    QString segmentPath(quint32 segment) const
+    {
+        return m_dir->path() + u"/data-%1.seg"_s.arg(segment, 8, 16, QLatin1Char('0'));
+    }
+
+    std::unique_ptr<QTemporaryDir> m_dir;
+};
+
+QImage tst_packediconstore::image(quint64 id)
+{
+    QImage result(16, 16, CachedTextureFactory::UploadFormat);
+    result.fill(QColor(int(id % 256), 255 - int(id % 256), 128));
+    return result;
+}
+
+bool tst_packediconstore::hasImage(PackedIconStore *store, quint64 id)
+{
+    const QImage found = store->find(id, false);
+    return !found.isNull() && found.pixelColor(8, 8) == image(id).pixelColor(8, 8);
+}
+
+void tst_packediconstore::crash(PackedIconStore *store)
+{
+    // The journal is written, nothing else: no checkpoint on the way out
+    store->flush();
+    store->release();
+    store->m_lockFile.close();
+}
+
+void tst_packediconstore::init()
+{
+    m_dir = std::make_unique<QTemporaryDir>();
+    QVERIFY(m_dir->isValid());
+}
+
+void tst_packediconstore::testPrivateStoreLocked()
+{
+    PackedIconStore first(m_dir->path());
+    QVERIFY(first.open());
+
+    // A second instance of the application must not write the same files
+    PackedIconStore second(m_dir->path());
+    QVERIFY(!second.open());
+    QVERIFY(!second.isOpen());
+
+    first.close();
+    QVERIFY(second.open());
+}
+
+void tst_packediconstore::testJournalReplay()
+{
+    {
+        PackedIconStore store(m_dir->path());
+        QVERIFY(store.open());
+        for (quint64 id = 1; id <= 8; ++id) {
+            QVERIFY(store.insert(id, image(id)));
+        }
+        QVERIFY(store.remove(3));
+        crash(&store);
+    }
+    QVERIFY(!QFile::exists(indexPath()));
+
+    PackedIconStore store(m_dir->path());
+    QVERIFY(store.open());
+    QCOMPARE(store.count(), 7);
+    for (quint64 id = 1; id <= 8; ++id) {
+        QCOMPARE(hasImage(&store, id), id != 3);
+    }
+}
+
+void tst_packediconstore::testTornJournalTail_data()
+{
+    QTest::addColumn<QByteArray>("tail");
+
+    QTest::newRow("partial record") << QByteArray(20, 'x');
+    QTest::newRow("garbage record") << QByteArray(32, 'x');
+    QTest::newRow("garbage records") << QByteArray(100, '\0');
+}
+
+void tst_packediconstore::testTornJournalTail()
+{
+    QFETCH(QByteArray, tail);
+
+    {
+        PackedIconStore store(m_dir->path());
+        QVERIFY(store.open());
+        for (quint64 id = 1; id <= 4; ++id) {
+            QVERIFY(store.insert(id, image(id)));
+        }
+        crash(&store);
+    }
+
+    const qint64 valid = QFileInfo(journalPath()).size();
+    QVERIFY(valid > 0);
+    {
+        QFile journal(journalPath());
+        QVERIFY(journal.open(QIODevice::WriteOnly | QIODevice::Append));
+        QCOMPARE(journal.write(tail), tail.size());
+    }
+
+    PackedIconStore store(m_dir->path());
+    QVERIFY(store.open());
+    QCOMPARE(QFileInfo(journalPath()).size(), valid);
+    QCOMPARE(store.count(), 4);
+    for (quint64 id = 1; id <= 4; ++id) {
+        QVERIFY(hasImage(&store, id));
+    }
+
+    // Appends continue behind the valid records
+    QVERIFY(store.insert(5, image(5)));
+    crash(&store);
+    QVERIFY(store.open());
+    QCOMPARE(store.count(), 5);
+    QVERIFY(hasImage(&store, 5));
+}
+
+void tst_packediconstore::testSnapshotAndJournal()
+{
+    {
+        PackedIconStore store(m_dir->path());
+        QVERIFY(store.open());
+        for (quint64 id = 1; id <= 4; ++id) {
+            QVERIFY(store.insert(id, image(id)));
+        }
+        QVERIFY(store.checkpoint());
+        QCOMPARE(QFileInfo(journalPath()).size(), qint64(0));
+
+        QVERIFY(store.remove(1));
+        QVERIFY(store.insert(5, image(5)));
+        crash(&store);
+    }
+    QVERIFY(QFile::exists(indexPath()));
+
+    PackedIconStore store(m_dir->path());
+    QVERIFY(store.open());
+    QCOMPARE(store.count(), 4);
+    QVERIFY(!hasImage(&store, 1));
+    for (quint64 id = 2; id <= 5; ++id) {
+        QVERIFY(hasImage(&store, id));
+    }
+}
+
+void tst_packediconstore::testSnapshotOnly()
+{
+    {
+        PackedIconStore store(m_dir->path());
+        QVERIFY(store.open());
+        for (quint64 id = 1; id <= 4; ++id) {
+            QVERIFY(store.insert(id, image(id)));
+        }
+        store.close();
+    }
+    QCOMPARE(QFileInfo(journalPath()).size(), qint64(0));
+
+    PackedIconStore store(m_dir->path());
+    QVERIFY(store.open());
+    QCOMPARE(store.count(), 4);
+    for (quint64 id = 1; id <= 4; ++id) {
+        QVERIFY(hasImage(&store, id));
+    }
+}
+
+void tst_packediconstore::testMissingSegment()
+{
+    {
+        PackedIconStore store(m_dir->path());
+        QVERIFY(store.open());
+        for (quint64 id = 1; id <= 4; ++id) {
+            QVERIFY(store.insert(id, image(id)));
+        }
+        store.close();
+    }
+    QVERIFY(QFile::remove(segmentPath(0)));
+
+    PackedIconStore store(m_dir->path());
+    QVERIFY(store.open());
+    QCOMPARE(store.count(), 0);
+    QCOMPARE(store.liveBytes(), qint64(0));
+    QVERIFY(!hasImage(&store, 1));
+}
+
+void tst_packediconstore::testShortRecord()
+{
+    {
+        PackedIconStore store(m_dir->path());
+        QVERIFY(store.open());
+        QVERIFY(store.insert(1, image(1)));
+
+        // An entry too short to hold a record header, within the segment
+        QVERIFY(store.applyPut(2, 0, 0, 16, 0, store.activeNamespace()));
+        store.journal(2, store.findSlot(2));
+        crash(&store);
+    }
+
+    PackedIconStore store(m_dir->path());
+    QVERIFY(store.open());
+    QCOMPARE(store.count(), 1);
+    QVERIFY(hasImage(&store, 1));
+    QVERIFY(store.find(2).isNull());
+}
+
+void tst_packediconstore::testCompaction()
+{
+    PackedIconStore store(m_dir->path());
+    QVERIFY(store.open());
+    for (quint64 id = 1; id <= 8; ++id) {
+        QVERIFY(store.insert(id, image(id)));
+    }
+
+    // Seal segment 0 without writing SegmentSize bytes
+    store.m_activeSegment++;
+    store.m_activeFile.reset();
+    for (quint64 id = 9; id <= 10; ++id) {
+        QVERIFY(store.insert(id, image(id)));
+    }
+    QCOMPARE(store.segmentCount(), 2);
+
+    for (quint64 id = 1; id <= 5; ++id) {
+        QVERIFY(store.remove(id));
+    }
+    QVERIFY(store.needsCompaction());
+
+    while (store.compactStep()) {
+    }
+    QVERIFY(!store.needsCompaction());
+    QVERIFY(!QFile::exists(segmentPath(0)));
+    QCOMPARE(store.count(), 5);
+    for (quint64 id = 6; id <= 10; ++id) {
+        QVERIFY(hasImage(&store, id));
+    }
+
+    // The moves are durable
+    store.close();
+    QVERIFY(store.open());
+    QCOMPARE(store.count(), 5);
+    for (quint64 id = 1; id <= 10; ++id) {
+        QCOMPARE(hasImage(&store, id), id > 5);
+    }
+}
+
+void tst_packediconstore::testCompactionBatchRace()
+{
+    PackedIconStore store(m_dir->path());
+    QVERIFY(store.open());
+    for (quint64 id = 1; id <= 4; ++id) {
+        QVERIFY(store.insert(id, image(id)));
+    }
+    store.m_activeSegment++;
+    store.m_activeFile.reset();
+    QVERIFY(store.insert(5, image(5)));
+    for (quint64 id = 1; id <= 2; ++id) {
+        QVERIFY(store.remove(id));
+    }
+
+    PackedIconStore::CompactionBatch batch;
+    QVERIFY(store.prepareCompaction(&batch));
+    QCOMPARE(batch.moves.size(), qsizetype(2));
+
+    // Replaced while the batch is written without the lock
+    QImage replacement(16, 16, CachedTextureFactory::UploadFormat);
+    replacement.fill(Qt::blue);
+    QVERIFY(store.insert(3, replacement));
+
+    QList<bool> written;
+    for (const PackedIconStore::PendingWrite &write : std::as_const(batch.moves)) {
+        written.append(PackedIconStore::writeRecord(write));
+    }
+    QVERIFY(!store.commitCompaction(batch, written));
+
+    QVERIFY(!QFile::exists(segmentPath(0)));
+    QCOMPARE(store.count(), 3);
+    QCOMPARE(store.find(3, false).pixelColor(8, 8), QColor(Qt::blue));
+    QVERIFY(hasImage(&store, 4));
+    QVERIFY(hasImage(&store, 5));
+}
+
+void tst_packediconstore::testSharedCatchUp()
+{
+    PackedIconStore first(m_dir->path(), true);
+    PackedIconStore second(m_dir->path(), true);
+    QVERIFY(first.open());
+    QVERIFY(second.open());
+
+    // Stored by one process, a hit for the other without reopening
+    QVERIFY(first.insert(1, image(1)));
+    QVERIFY(hasImage(&second, 1));
+    QCOMPARE(second.count(), 1);
+
+    QVERIFY(second.insert(2, image(2)));
+    QVERIFY(hasImage(&first, 2));
+
+    // Both append behind each other, the records don't overlap
+    QVERIFY(hasImage(&first, 1));
+    QVERIFY(hasImage(&second, 2));
+}
+
+void tst_packediconstore::testSharedCheckpointReload()
+{
+    PackedIconStore first(m_dir->path(), true);
+    PackedIconStore second(m_dir->path(), true);
+    QVERIFY(first.open());
+    QVERIFY(second.open());
+    QVERIFY(first.insert(1, image(1)));
+    QVERIFY(hasImage(&second, 1));
+
+    // Reserved before the other process checkpoints
+    PackedIconStore::PendingWrite write;
+    QVERIFY(PackedIconStore::prepare(2, image(2), &write));
+    QVERIFY(second.reserve(&write));
+
+    QVERIFY(first.insert(3, image(3)));
+    QVERIFY(first.checkpoint());
+    QCOMPARE(QFileInfo(journalPath()).size(), qint64(0));
+
+    // The new journal file makes it reload, the reservation is forgotten
+    QVERIFY(PackedIconStore::writeRecord(write));
+    QVERIFY(!second.commit(write, true));
+    QVERIFY(!second.journalReplaced());
+    QCOMPARE(second.count(), 2);
+    QVERIFY(hasImage(&second, 3));
+    QVERIFY(second.find(2, false).isNull());
+    QVERIFY(first.find(2, false).isNull());
+}
+
+void tst_packediconstore::testSharedTornTail()
+{
+    PackedIconStore first(m_dir->path(), true);
+    PackedIconStore second(m_dir->path(), true);
+    QVERIFY(first.open());
+    QVERIFY(second.open());
+
+    QVERIFY(first.insert(1, image(1)));
+    const qint64 valid = QFileInfo(journalPath()).size();
+
+    // What a writer in the middle of an append leaves
+    {
+        QFile journal(journalPath());
+        QVERIFY(journal.open(QIODevice::WriteOnly | QIODevice::Append));
+        QCOMPARE(journal.write(QByteArray(20, 'x')), qint64(20));
+    }
+
+    // A lookup reads the tail without the lock, it must not cut it off
+    QVERIFY(hasImage(&second, 1));
+    QCOMPARE(QFileInfo(journalPath()).size(), valid + 20);
+
+    // Under the lock nobody appends, the tail was left by a dead writer
+    second.flush();
+    QCOMPARE(QFileInfo(journalPath()).size(), valid);
+
+    QVERIFY(first.insert(2, image(2)));
+    QVERIFY(hasImage(&second, 2));
+}
+
+void tst_packediconstore::testNamespaceOrder()
+{
+    PackedIconStore store(m_dir->path());
+    QVERIFY(store.open());
+    for (quint16 tag = 1; tag <= 3; ++tag) {
+        store.activateNamespace(tag);
+    }
+    QCOMPARE(store.retainedNamespaces(), QList<quint16>({3, 2, 1, 0}));
+    QCOMPARE(store.activeNamespace(), quint16(3));
+
+    // A retained one moves to the front, nothing falls off
+    store.activateNamespace(1);
+    QCOMPARE(store.retainedNamespaces(), QList<quint16>({1, 3, 2, 0}));
+    QVERIFY(!store.needsReclaim());
+
+    // A new one pushes out the least recent
+    store.activateNamespace(4);
+    QCOMPARE(store.retainedNamespaces(), QList<quint16>({4, 1, 3, 2}));
+    QVERIFY(store.needsReclaim());
+
+    // Journaled like every other change
+    crash(&store);
+    PackedIconStore reopened(m_dir->path());
+    QVERIFY(reopened.open());
+    QCOMPARE(reopened.retainedNamespaces(), QList<quint16>({4, 1, 3, 2}));
+}
+
+void tst_packediconstore::testNamespaceReclaim()
+{
+    PackedIconStore store(m_dir->path());
+    QVERIFY(store.open());
+
+    // One entry per namespace, one more namespace than are retained
+    for (quint16 tag = 1; tag <= PackedIconStore::MaxNamespaces + 1; ++tag) {
+        store.activateNamespace(tag);
+        QVERIFY(store.insert(tag, image(tag)));
+    }
+    QCOMPARE(store.retainedNamespaces(), QList<quint16>({5, 4, 3, 2}));
+    QVERIFY(store.needsReclaim());
+
+    // Dropped entries stay until reclaimStep() gets to them
+    QCOMPARE(store.count(), 5);
+    QVERIFY(hasImage(&store, 1));
+
+    int steps = 0;
+    while (store.reclaimStep(1)) {
+        steps++;
+    }
+    QVERIFY(steps > 0);
+    QVERIFY(!store.needsReclaim());
+
+    QCOMPARE(store.count(), 4);
+    QVERIFY(!hasImage(&store, 1));
+    for (quint64 id = 2; id <= 5; ++id) {
+        QVERIFY(hasImage(&store, id));
+    }
+
+    // The removals are journaled
+    crash(&store);
+    PackedIconStore reopened(m_dir->path());
+    QVERIFY(reopened.open());
+    QCOMPARE(reopened.count(), 4);
+    QVERIFY(!hasImage(&reopened, 1));
+}
+
+void tst_packediconstore::testNamespaceDroppedCommit()
+{
+    PackedIconStore store(m_dir->path());
+    QVERIFY(store.open());
+    store.activateNamespace(1);
+
+    PackedIconStore::PendingWrite write;
+    QVERIFY(PackedIconStore::prepare(1, image(1), &write));
+    write.ns = store.activeNamespace();
+    QVERIFY(store.reserve(&write));
+
+    // The namespace is dropped while the record is written without the lock
+    for (quint16 tag = 2; tag <= PackedIconStore::MaxNamespaces + 1; ++tag) {
+        store.activateNamespace(tag);
+    }
+    QVERIFY(!store.retainedNamespaces().contains(1));
+
+    const qint64 deadBefore = store.deadBytes();
+    QVERIFY(PackedIconStore::writeRecord(write));
+    QVERIFY(!store.commit(write, true));
+    QCOMPARE(store.count(), 0);
+    QVERIFY(!hasImage(&store, 1));
+    QCOMPARE(store.deadBytes(), deadBefore + write.record.size());
+}
+
+void tst_packediconstore::testNamespaceReactivate()
+{
+    PackedIconStore store(m_dir->path());
+    QVERIFY(store.open());
+    for (quint16 tag = 1; tag <= 3; ++tag) {
+        store.activateNamespace(tag);
+        QVERIFY(store.insert(tag, image(tag)));
+    }
+
+    // Switching back keeps the entries of 1, the fourth namespace drops 0
+    store.activateNamespace(1);
+    QCOMPARE(store.activeNamespace(), quint16(1));
+    store.activateNamespace(4);
+    QCOMPARE(store.retainedNamespaces(), QList<quint16>({4, 1, 3, 2}));
+    while (store.reclaimStep()) {
+    }
+    QCOMPARE(store.count(), 3);
+
+    // Back again, its entries are hits right away
+    store.activateNamespace(1);
+    QCOMPARE(store.retainedNamespaces(), QList<quint16>({1, 4, 3, 2}));
+    QVERIFY(!store.needsReclaim());
+    for (quint64 id = 1; id <= 3; ++id) {
+        QVERIFY(hasImage(&store, id));
+    }
+}
+
+QTEST_GUILESS_MAIN(tst_packediconstore)
+#include "tst_packediconstore.moc"
@@ -0,0 +1,290 @@
+/* BEGIN_COMMON_COPYRIGHT_HEADER
+ * (c)LGPL2+
+ *
+ * LXQt - a lightweight, Qt based, desktop toolset
+ * https://lxqt.org
+ *
+ * Copyright: 2025 LXQt team
+ * Authors:
+ *   LXQt team
+ *
+ * This program or library is free software; you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ *
+ * END_COMMON_COPYRIGHT_HEADER */
+
+#include <QObject>
+
+#include "xdgicon.h"
+#include "xdgicon_p.h"
+#include "xdgiconloader_p.h"
+#include "xdgiconmetrics.h"
+
+#include <QColor>
+#include <QDir>
+#include <QFile>
+#include <QIcon>
+#include <QImage>
+#include <QPixmap>
+#include <QSemaphore>
+#include <QTest>
+#include <QTemporaryDir>
+#include <QThread>
+#include <QThreadPool>
+
+#include <memory>
+
+using namespace Qt::Literals::StringLiterals;
+
+class tst_xdgicon : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+
+    void testFromNamedTheme();
+
+    void testEngineClone();
+    void testEngineStream();
+    void testEngineGeneration();
+    void testFileName();
+
+    void testRequestAsync();
+    void testRequestAsyncCoalesced();
+    void testRequestAsyncCancel();
+    void testRequestAsyncMissing();
+
+private:
+    void writeTheme(const QString &themeName, const QColor &color);
+
+    QTemporaryDir m_iconsDir;
+};
+
+void tst_xdgicon::writeTheme(const QString &themeName, const QColor &color)
+{
+    const QString themeDir = m_iconsDir.path() + u'/' + themeName;
+    QVERIFY(QDir().mkpath(themeDir + "/32x32/apps"_L1));
+
+    QFile index(themeDir + "/index.theme"_L1);
+    QVERIFY(index.open(QIODevice::WriteOnly));
+    index.write("[Icon Theme]\n"
+                "Name=Test\n"
+                "Directories=32x32/apps\n"
+                "\n"
+                "[32x32/apps]\n"
+                "Size=32\n"
+                "Type=Fixed\n");
+    index.close();
+
+    QImage image(32, 32, QImage::Format_ARGB32);
+    image.fill(color);
+    QVERIFY(image.save(themeDir + "/32x32/apps/tst-xdgicon.png"_L1));
+}
+
+void tst_xdgicon::initTestCase()
+{
+    QVERIFY(m_iconsDir.isValid());
+    writeTheme(u"tst-theme"_s, Qt::red);
+    writeTheme(u"tst-theme-other"_s, Qt::blue);
+
+    QIcon::setThemeSearchPaths(QStringList() << m_iconsDir.path());
+    QIcon::setThemeName(u"tst-theme"_s);
+}
+
+void tst_xdgicon::testFromNamedTheme()
+{
+    const QIcon named = XdgIcon::fromNamedTheme(u"tst-xdgicon"_s, u"tst-theme-other"_s);
+    QVERIFY(!named.isNull());
+    QCOMPARE(named.pixmap(QSize(32, 32)).toImage().pixelColor(16, 16), QColor(Qt::blue));
+
+    // The named theme is per icon, the active one stays in effect
+    QCOMPARE(QIcon::themeName(), u"tst-theme"_s);
+    const QIcon current = XdgIcon::fromTheme(u"tst-xdgicon"_s);
+    QVERIFY(!current.isNull());
+    QCOMPARE(current.pixmap(QSize(32, 32)).toImage().pixelColor(16, 16), QColor(Qt::red));
+}
+
+static QColor centerColor(QIconEngine *engine)
+{
+    return engine->scaledPixmap(QSize(32, 32), QIcon::Normal, QIcon::Off, 1.0)
+        .toImage().pixelColor(16, 16);
+}
+
+static quint64 resolveCount()
+{
+    return XdgIconMetrics::snapshot(XdgIconMetrics::Resolve).count;
+}
+
+void tst_xdgicon::testEngineClone()
+{
+    XdgIconLoaderEngine engine(u"tst-xdgicon"_s);
+    QVERIFY(!engine.isNull());
+
+    // Clones share the resolved icon, nothing is looked up again
+    const quint64 resolves = resolveCount();
+    std::unique_ptr<QIconEngine> clone(engine.clone());
+    QVERIFY(!clone->isNull());
+    QCOMPARE(clone->iconName(), u"tst-xdgicon"_s);
+    QCOMPARE(resolveCount(), resolves);
+
+    // ... and can be rendered on different threads at the same time
+    QColor threadColor;
+    QThread *thread = QThread::create([&clone, &threadColor] {
+        threadColor = centerColor(clone.get());
+    });
+    thread->start();
+    const QColor color = centerColor(&engine);
+    QVERIFY(thread->wait());
+    delete thread;
+
+    QCOMPARE(color, QColor(Qt::red));
+    QCOMPARE(threadColor, QColor(Qt::red));
+}
+
+void tst_xdgicon::testEngineStream()
+{
+    XdgIconLoaderEngine engine(u"tst-xdgicon"_s);
+    QVERIFY(!engine.isNull());
+
+    QByteArray data;
+    {
+        QDataStream out(&data, QIODevice::WriteOnly);
+        QVERIFY(engine.write(out));
+    }
+
+    // The resolved paths travel with the stream
+    const quint64 resolves = resolveCount();
+    XdgIconLoaderEngine restored;
+    QDataStream in(data);
+    QVERIFY(restored.read(in));
+    QVERIFY(!restored.isNull());
+    QCOMPARE(restored.iconName(), u"tst-xdgicon"_s);
+    QCOMPARE(centerColor(&restored), QColor(Qt::red));
+    QCOMPARE(resolveCount(), resolves);
+}
+
+void tst_xdgicon::testEngineGeneration()
+{
+    XdgIconLoaderEngine engine(u"tst-xdgicon"_s);
+    QVERIFY(!engine.isNull());
+    std::unique_ptr<QIconEngine> clone(engine.clone());
+
+    // A new theme generation makes every clone resolve again
+    XdgIconLoader::instance()->invalidateKey();
+    quint64 resolves = resolveCount();
+    QVERIFY(!clone->isNull());
+    QCOMPARE(resolveCount(), resolves + 1);
+
+    // A stale engine streams its name only, the reader resolves it
+    QByteArray data;
+    {
+        QDataStream out(&data, QIODevice::WriteOnly);
+        QVERIFY(engine.write(out));
+    }
+    resolves = resolveCount();
+    XdgIconLoaderEngine restored;
+    QDataStream in(data);
+    QVERIFY(restored.read(in));
+    QCOMPARE(resolveCount(), resolves);
+    QVERIFY(!restored.isNull());
+    QCOMPARE(resolveCount(), resolves + 1);
+    QCOMPARE(centerColor(&restored), QColor(Qt::red));
+}
+
+void tst_xdgicon::testFileName()
+{
+    const QIcon icon = XdgIcon::fromNamedTheme(u"tst-xdgicon"_s, u"tst-theme-other"_s);
+    QVERIFY(!icon.pixmap(QSize(32, 32)).isNull());
+
+    // Taken from the entries the render resolved
+    const quint64 resolves = resolveCount();
+    const QString fileName = XdgIcon::fileName(icon, QSize(32, 32), 1.0);
+    QCOMPARE(fileName, m_iconsDir.path() + "/tst-theme-other/32x32/apps/tst-xdgicon.png"_L1);
+    QCOMPARE(resolveCount(), resolves);
+
+    QVERIFY(XdgIcon::fileName(QIcon(), QSize(32, 32), 1.0).isEmpty());
+}
+
+void tst_xdgicon::testRequestAsync()
+{
+    QFuture<QImage> future = XdgIcon::requestAsync(u"tst-xdgicon"_s, QSize(32, 32));
+    future.waitForFinished();
+
+    QVERIFY(future.resultCount() == 1);
+    const QImage image = future.result();
+    QCOMPARE(image.size(), QSize(32, 32));
+    QCOMPARE(image.pixelColor(16, 16), QColor(Qt::red));
+}
+
+void tst_xdgicon::testRequestAsyncCoalesced()
+{
+    // Identical requests share one render but every caller gets a result
+    // Keep every render thread busy so no request can finish before the
+    // last one is queued
+    QThreadPool *pool = iconRequestPool();
+    const int threads = pool->maxThreadCount();
+    QSemaphore started;
+    QSemaphore blocked;
+    for (int i = 0; i < threads; ++i)
+        pool->start([&started, &blocked] { started.release(); blocked.acquire(); });
+    started.acquire(threads);
+
+    const quint64 resolvesBefore = XdgIconMetrics::snapshot(XdgIconMetrics::Resolve).count;
+    QList<QFuture<QImage>> futures;
+    for (int i = 0; i < 16; ++i)
+        futures << XdgIcon::requestAsync(u"tst-xdgicon"_s, QSize(32, 32), 2.0);
+    blocked.release(threads);
+
+    for (QFuture<QImage> &future : futures) {
+        future.waitForFinished();
+        QVERIFY(future.resultCount() == 1);
+        QVERIFY(!future.result().isNull());
+    }
+
+    // Every render resolves the name with a new engine once
+    QCOMPARE(XdgIconMetrics::snapshot(XdgIconMetrics::Resolve).count - resolvesBefore, quint64(1));
+}
+
+void tst_xdgicon::testRequestAsyncCancel()
+{
+    QFuture<QImage> cancelled = XdgIcon::requestAsync(u"tst-xdgicon"_s, QSize(32, 32), 1.0, QIcon::Disabled);
+    QFuture<QImage> kept = XdgIcon::requestAsync(u"tst-xdgicon"_s, QSize(32, 32), 1.0, QIcon::Disabled);
+    cancelled.cancel();
+
+    // Cancelling one caller must not take the shared render away from the other
+    kept.waitForFinished();
+    QVERIFY(!kept.isCanceled());
+    QVERIFY(kept.resultCount() == 1);
+
+    cancelled.waitForFinished();
+    QVERIFY(cancelled.isCanceled());
+}
+
+void tst_xdgicon::testRequestAsyncMissing()
+{
+    // No dashes, the dash fallback would otherwise find "tst-xdgicon"
+    QFuture<QImage> future = XdgIcon::requestAsync(u"tstxdgiconmissing"_s, QSize(32, 32));
+    future.waitForFinished();
+    QVERIFY(future.isFinished());
+    QCOMPARE(future.resultCount(), 0);
+
+    QFuture<QImage> empty = XdgIcon::requestAsync(QString(), QSize(32, 32));
+    QVERIFY(empty.isFinished());
+    QCOMPARE(empty.resultCount(), 0);
+}
+
+QTEST_MAIN(tst_xdgicon)
+#include "tst_xdgicon.moc"